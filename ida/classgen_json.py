@@ -133,6 +133,9 @@ class FieldInfo(TypedDict):
 class MemberFieldInfo(FieldInfo):
     kind: Literal["member"]
     bitfield_width: Optional[int]
+    bitfield_offset: Optional[int]
+    size: int
+    alignment: int
     type: ComplexTypeUnion
     type_name: str
     name: str
@@ -158,17 +161,61 @@ class RecordInfoKind(IntEnum):
     Union = 2
 
 
-class RecordInfo(TypedDict):
+class _RecordInfoOptional(TypedDict, total=False):
+    # Only present (and true) if some vtable components are unknown.
+    vtable_is_incomplete: bool
+
+
+class RecordInfo(_RecordInfoOptional):
     is_anonymous: bool
     kind: RecordInfoKind
     name: str
     size: int
     data_size: int
     alignment: int
+    source_file: str
     fields: List[FieldInfoUnion]
     vtable: Optional[List[VTableComponentInfoUnion]]
 
 
-class TypeDump(TypedDict):
+class LayoutInfo(TypedDict):
+    translation_unit: str
+    description: str
+
+
+class LayoutConflictInfo(TypedDict):
+    name: str
+    first: LayoutInfo
+    second: LayoutInfo
+
+
+class VariantInfo(TypedDict):
+    name: str
+    enums: List[EnumInfo]
+    records: List[RecordInfo]
+    missing_records: List[str]
+
+
+class _TranslationUnitStatusOptional(TypedDict, total=False):
+    variant: str
+
+
+class TranslationUnitStatusInfo(_TranslationUnitStatusOptional):
+    file: str
+    # "ok", "failed", "timed_out", "crashed" or "cancelled"
+    status: str
+    num_attempts: int
+    retry_args: List[str]
+    diagnostics: List[str]
+
+
+class _TypeDumpOptional(TypedDict, total=False):
+    layout_conflicts: List[LayoutConflictInfo]
+    errors: List[TranslationUnitStatusInfo]
+    variant_name: str
+    variants: List[VariantInfo]
+
+
+class TypeDump(_TypeDumpOptional):
     enums: List[EnumInfo]
     records: List[RecordInfo]
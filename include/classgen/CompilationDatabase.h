@@ -0,0 +1,45 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace clang::tooling {
+class CompilationDatabase;
+}
+
+namespace classgen {
+
+/// Loads a compile_commands.json file (`path` can be the file itself or the directory
+/// that contains it) without parsing all of it.
+///
+/// An index that maps source file paths to the location of their entries is stored next to
+/// the database (compile_commands.json.classgen-index) and rebuilt whenever the modification
+/// time or the size of the database changes. Only the entries of the files that are actually
+/// compiled are decoded, which makes small runs on huge databases much cheaper.
+///
+/// Unlike clang::tooling::JSONCompilationDatabase, source files are only matched by their
+/// absolute path (symlinks are not resolved).
+///
+/// On failure, nullptr is returned and `error` is set.
+std::unique_ptr<clang::tooling::CompilationDatabase>
+LoadIndexedCompilationDatabase(std::string_view path, std::string& error);
+
+/// Returns a compilation database that remembers the compile commands of every file it is
+/// asked about, so that they are only decoded once. `compilations` must outlive it.
+std::unique_ptr<clang::tooling::CompilationDatabase>
+MakeCachingCompilationDatabase(const clang::tooling::CompilationDatabase& compilations);
+
+/// Returns the source files reordered so that files that are compiled with equivalent flags
+/// (the same command line ignoring input, output and dependency files, in the same directory)
+/// are consecutive. Groups are ordered by first appearance and files keep their relative order.
+std::vector<std::string>
+GroupByCompileFlags(const clang::tooling::CompilationDatabase& compilations,
+                    std::span<const std::string> source_files);
+
+}  // namespace classgen
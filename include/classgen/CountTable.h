@@ -0,0 +1,37 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace classgen {
+
+/// A list of counts (e.g. field access counts or live instance counts) for types or members.
+///
+/// The text format is a simple CSV file. Each line has the form `name,count` or
+/// `name,member,count`. Empty lines and lines that start with # are ignored.
+/// Type names may contain commas (e.g. template arguments), so columns are split from the right.
+struct CountTable {
+  struct Entry {
+    /// Type name (e.g. a record name).
+    std::string name;
+    /// Member name. Empty if the table has no member column.
+    std::string member;
+    std::uint64_t count{};
+  };
+
+  explicit operator bool() const { return error.empty(); }
+
+  std::string error;
+  std::vector<Entry> entries;
+};
+
+/// Reads a count table from a file. If `has_member_column` is true, each line must have
+/// a member column; `Type::member,count` is also accepted as a shorthand for `Type,member,count`.
+/// On failure, the error field of the returned table is set.
+CountTable ReadCountTable(const std::string& path, bool has_member_column);
+
+}  // namespace classgen
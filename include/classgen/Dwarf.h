@@ -0,0 +1,27 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <span>
+#include <string>
+
+#include <classgen/Record.h>
+
+namespace classgen {
+
+/// Reads enums and records from the DWARF debug info of object files, executables or shared
+/// libraries. This is much cheaper than parsing sources, but DWARF does not describe everything
+/// that Clang knows about a type:
+///
+/// - Virtual bases are not listed (their offsets are only known at run time).
+/// - Only the primary vtable and the secondary vtables of non-virtual bases are reconstructed,
+///   from the vtable slots of virtual member functions. Thunks are inferred by matching
+///   function names and types. Vbase and vcall offsets are not known.
+/// - Data sizes are computed from the end of the last field.
+///
+/// Like ParseRecords, each type is only extracted once (the first definition wins).
+/// On failure, the error field of the returned result is set.
+ParseResult ParseRecordsFromDwarf(std::span<const std::string> paths);
+
+}  // namespace classgen
@@ -0,0 +1,26 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include <classgen/Record.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+/// Writes a parse result as a JSON type dump (the format that is produced by classgen-dump).
+void WriteJson(llvm::raw_ostream& os, const ParseResult& result);
+
+/// Reads a JSON type dump. On failure, the error field of the returned result is set.
+ParseResult ReadJson(std::string_view json);
+
+/// Reads a JSON type dump from a file. On failure, the error field of the returned result is set.
+ParseResult ReadJsonFile(const std::string& path);
+
+}  // namespace classgen
@@ -0,0 +1,163 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <classgen/Record.h>
+
+namespace classgen {
+
+/// Number of bits in a byte.
+constexpr std::size_t CharBit = 8;
+
+/// Records are not followed deeper than this (which can only happen with broken dumps).
+constexpr std::size_t MaxNestingDepth = 64;
+
+/// Returns the size of the smallest integer type (1, 2, 4, 8... bytes) that has `bits` bits.
+std::size_t GetSizeForBits(std::size_t bits);
+
+/// The innermost element type of a (possibly multi-dimensional) array type.
+struct ArrayElementType {
+  /// The type itself if it is not an array.
+  const ComplexType* type = nullptr;
+  /// Total number of elements (1 if the type is not an array).
+  std::uint64_t count = 1;
+};
+
+ArrayElementType GetArrayElementType(const ComplexType* type);
+
+/// Provides fast lookups of the records and enums of a parse result by name.
+/// The parse result must outlive the index.
+class TypeIndex {
+public:
+  explicit TypeIndex(const ParseResult& result);
+
+  const ParseResult& GetResult() const { return m_result; }
+
+  const Record* FindRecord(std::string_view name) const;
+  const Enum* FindEnum(std::string_view name) const;
+
+private:
+  const ParseResult& m_result;
+  std::unordered_map<std::string_view, const Record*> m_records;
+  std::unordered_map<std::string_view, const Enum*> m_enums;
+};
+
+/// Maps records to the records that derive from them, based on base class fields.
+/// Note that records list all of their virtual bases (including indirect ones) as fields,
+/// so a record is also considered to directly derive from its indirect virtual bases.
+class ClassHierarchy {
+public:
+  struct Derived {
+    const Record* record = nullptr;
+    /// The base class field in the derived record.
+    const Field* base_field = nullptr;
+  };
+
+  explicit ClassHierarchy(const TypeIndex& index);
+
+  /// Returns records that directly derive from the specified record.
+  const std::vector<Derived>& GetDerivedRecords(const Record& record) const;
+
+  /// Returns all records that derive from the specified record (directly or indirectly).
+  std::vector<const Record*> GetAllDerivedRecords(const Record& record) const;
+
+private:
+  std::unordered_map<const Record*, std::vector<Derived>> m_derived;
+};
+
+/// The range of bytes that a field occupies inside its containing record.
+struct FieldExtent {
+  /// Index into Record::fields.
+  std::size_t field_idx{};
+  std::size_t offset{};
+  /// Number of bytes. Fields that share storage (e.g. bitfields) are clamped so that
+  /// they do not extend past the start of the next field.
+  std::size_t size{};
+};
+
+/// Returns the extents of all fields of a record, in field order.
+std::vector<FieldExtent> GetFieldExtents(const TypeIndex& index, const Record& record);
+
+/// Returns the number of bytes in a record that are not covered by any field
+/// (internal padding and tail padding).
+std::size_t GetPaddingSize(const Record& record, const std::vector<FieldExtent>& extents);
+
+/// Returns whether a record is empty (no member variables, no vtable and only empty bases).
+/// Empty records still have a size of at least 1 byte unless they are optimised away (EBO,
+/// [[no_unique_address]]).
+bool IsEmptyRecord(const TypeIndex& index, const Record& record);
+
+/// Returns whether two records have the same layout (size, alignment, fields and vtable).
+bool HaveSameLayout(const Record& lhs, const Record& rhs);
+
+/// Returns whether two enums have the same underlying type and enumerators.
+bool HaveSameLayout(const Enum& lhs, const Enum& rhs);
+
+/// Returns a one-line, human-readable description of a record layout (size, alignment and
+/// field offsets), e.g. for reporting layout conflicts.
+std::string DescribeLayout(const Record& record);
+
+/// A record that is embedded by value inside another record (as a member, or as an array).
+struct EmbeddedRecord {
+  const Record* record = nullptr;
+  /// Number of elements (1 for non-array members).
+  std::uint64_t count = 0;
+};
+
+/// If the field is a member variable whose type is a record or an array of records,
+/// returns that record. Otherwise, the returned record is nullptr.
+EmbeddedRecord GetEmbeddedRecord(const TypeIndex& index, const Field& field);
+
+/// A leaf member of a record after embedded records and bases have been recursively expanded.
+struct ExpandedMember {
+  /// Access path, e.g. `m_body.m_motion.m_linear_velocity.x`. Members that come from a base
+  /// are qualified with the base name (`Base::m_x`) and vtable pointers are named `__vptr`.
+  std::string path;
+  /// Offset since the beginning of the expanded record.
+  std::size_t offset{};
+  /// A member variable that is not a record (arrays are not expanded), a vtable pointer,
+  /// or a base or record member that could not be (or was not asked to be) expanded.
+  const Field* field = nullptr;
+  /// Whether this member belongs to a virtual base of the expanded record.
+  bool in_virtual_base = false;
+};
+
+/// Flattens records into leaf members with absolute offsets (like `pahole --expand`).
+/// Each record is only expanded once: the expansion is reused for every record that embeds it.
+class LayoutExpander {
+public:
+  /// If expand_member_records is false, only base subobjects are expanded and record-typed
+  /// members are kept as leaves (with their own size and alignment).
+  explicit LayoutExpander(const TypeIndex& index, bool expand_member_records = true)
+      : m_index(index), m_expand_member_records(expand_member_records) {}
+
+  /// Returns the leaf members of a record, in offset order. The returned reference remains
+  /// valid for the lifetime of the expander.
+  const std::vector<ExpandedMember>& Expand(const Record& record);
+
+private:
+  void AddSubobject(std::vector<ExpandedMember>& members, const Record& record,
+                    std::size_t offset, std::string_view prefix, bool is_base,
+                    bool is_virtual_base);
+
+  const TypeIndex& m_index;
+  bool m_expand_member_records;
+  std::unordered_map<const Record*, std::vector<ExpandedMember>> m_expansions;
+  /// Records that are currently being expanded (to detect cycles in broken dumps).
+  std::unordered_set<const Record*> m_in_progress;
+};
+
+/// Returns the position of the last `::` in a qualified name that is not nested inside
+/// template arguments or parentheses, or std::string_view::npos if there is none.
+std::size_t FindLastScopeSeparator(std::string_view name);
+
+}  // namespace classgen
@@ -0,0 +1,33 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <classgen/Record.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct LayoutAssertOptions {
+  /// Names of the records to generate checks for. If empty, all records are checked.
+  std::vector<std::string> records;
+  /// Whether to check member offsets (in addition to sizes and alignments).
+  bool check_offsets = true;
+};
+
+/// Writes a C++ header that checks record layouts with static_assert (sizeof, alignof and
+/// offsetof), so that thousands of layouts can be verified by a single compiler invocation.
+/// Records that cannot be named (anonymous records, lambdas, records in anonymous namespaces)
+/// are skipped. The header must be included after the definitions of the checked records.
+/// Returns false without writing anything if a selected record does not exist or cannot be
+/// named; `error` then lists these records.
+bool WriteLayoutAsserts(llvm::raw_ostream& os, const ParseResult& result,
+                        const LayoutAssertOptions& options, std::string& error);
+
+}  // namespace classgen
@@ -3,7 +3,9 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstddef>
+#include <functional>
 #include <memory>
 #include <span>
 #include <string>
@@ -15,7 +17,8 @@
 
 namespace clang::tooling {
 class ClangTool;
-}
+class CompilationDatabase;
+}  // namespace clang::tooling
 
 namespace classgen {
 
@@ -87,12 +90,22 @@ struct VTableComponent {
 
 struct VTable {
   std::vector<VTableComponent> components;
+  /// Whether some components are unknown (e.g. because a base class is only declared in
+  /// the debug info that the vtable was reconstructed from). Unknown functions are shown as
+  /// "(unknown)" placeholders.
+  bool is_incomplete = false;
 };
 
 struct Field {
   struct MemberVariable {
     /// 0 if this is not a bitfield.
     unsigned int bitfield_width{};
+    /// [Bitfields] Offset in bits since the beginning of the byte at `offset`.
+    unsigned int bitfield_offset{};
+    /// sizeof() of the member type in bytes. For bitfields, this is the size of the declared type.
+    std::size_t size{};
+    /// Alignment of the member in bytes (taking alignas into account).
+    std::size_t alignment{};
     std::unique_ptr<ComplexType> type;
     std::string type_name;
     std::string name;
@@ -131,6 +144,8 @@ struct Record {
   std::size_t data_size{};
   /// Alignment in bytes.
   std::size_t alignment{};
+  /// Path to the file that contains the definition. Might be empty.
+  std::string source_file;
   /// Record fields (e.g. member variables).
   /// Note that base classes are also represented as fields.
   std::vector<Field> fields;
@@ -138,6 +153,65 @@ struct Record {
   std::unique_ptr<VTable> vtable;
 };
 
+/// Two translation units that see different layouts for the same type (an ODR violation,
+/// or inconsistent macros, packing pragmas or compiler flags).
+struct LayoutConflict {
+  struct Layout {
+    /// Main source file of the translation unit.
+    std::string translation_unit;
+    /// Human-readable description of the layout.
+    std::string description;
+  };
+
+  /// Fully qualified name of the type.
+  std::string name;
+  /// The layout that was kept in the parse result.
+  Layout first;
+  /// The conflicting layout.
+  Layout second;
+};
+
+/// Enums and records from an additional parse variant (e.g. another target) whose layouts
+/// differ from the main parse result.
+struct ParseVariantResult {
+  /// Name of the variant.
+  std::string name;
+  /// Enums that are different in this variant or that do not exist in the main result.
+  std::vector<Enum> enums;
+  /// Records that are different in this variant or that do not exist in the main result.
+  std::vector<Record> records;
+  /// Names of main result records that do not exist in this variant.
+  std::vector<std::string> missing_records;
+};
+
+/// Outcome of parsing a translation unit.
+struct TranslationUnitStatus {
+  enum class Kind {
+    Ok,
+    /// The translation unit could not be compiled. Types from failed translation units are
+    /// discarded because their layouts might be wrong.
+    Failed,
+    /// Parsing was aborted because it took too long.
+    TimedOut,
+    /// The process that parsed the translation unit crashed (e.g. because it ran out of memory).
+    Crashed,
+    /// The parse was cancelled before or while the translation unit was parsed.
+    Cancelled,
+  };
+
+  /// Main source file.
+  std::string file;
+  /// Name of the parse variant. Only set if several variants were parsed.
+  std::string variant;
+  Kind status = Kind::Ok;
+  /// Number of times the translation unit was parsed (more than 1 if it was retried).
+  unsigned int num_attempts = 1;
+  /// Extra compiler arguments of the retry that succeeded. Empty if the first attempt succeeded.
+  std::vector<std::string> retry_args;
+  /// Errors from the first failed attempt (`file:line:col: error: message`).
+  std::vector<std::string> diagnostics;
+};
+
 struct ParseResult {
   ParseResult() = default;
 
@@ -156,15 +230,109 @@ struct ParseResult {
   std::string error;
   std::vector<Enum> enums;
   std::vector<Record> records;
+  /// Only filled if ParseConfig::check_layout_conflicts is set.
+  std::vector<LayoutConflict> layout_conflicts;
+  /// Whether empty records were inlined into the records that contain them
+  /// (ParseConfig::inline_empty_structs). Empty bases and members are then missing.
+  bool inline_empty_structs = false;
+  /// Name of the variant that the main enums and records belong to.
+  /// Only set if several variants were parsed.
+  std::string variant_name;
+  /// Additional variants. Only layouts that differ from the main result are stored.
+  std::vector<ParseVariantResult> variants;
+  /// Per-translation unit status. Note that a failed translation unit does not cause the whole
+  /// parse to fail: the error field is only set if no translation unit could be parsed.
+  /// Only failed and retried translation units are stored in type dumps.
+  std::vector<TranslationUnitStatus> translation_units;
+};
+
+/// Allows a parse to be aborted from another thread (or a signal handler).
+class CancellationToken {
+public:
+  void Cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+  bool IsCancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<bool> m_cancelled = false;
+};
+
+struct ParseProgress {
+  enum class Event {
+    TranslationUnitStarted,
+    TranslationUnitFinished,
+  };
+
+  Event event;
+  /// Main source file of the translation unit.
+  std::string_view file;
+  /// Name of the parse variant. Only set if several variants are parsed.
+  std::string_view variant;
+  /// Outcome of the translation unit. Only meaningful for TranslationUnitFinished.
+  TranslationUnitStatus::Kind status = TranslationUnitStatus::Kind::Ok;
+  /// Number of records that have been extracted so far (for the current variant).
+  std::size_t num_records = 0;
 };
 
 struct ParseConfig {
   /// Whether empty structs should be inlined into any containing record.
   bool inline_empty_structs = false;
+  /// Whether records that are seen again in another translation unit should be checked
+  /// for layout conflicts. Only a cheap layout fingerprint is computed for repeat visits.
+  bool check_layout_conflicts = false;
+  /// Whether translation units that are compiled with the same flags and start with the same
+  /// #includes should share a precompiled preamble.
+  /// To make sharing more likely, translation units are then processed in groups of equivalent
+  /// flags instead of in the given order. This changes the order of records in the result and
+  /// which definition of a type is kept when translation units disagree.
+  bool share_preambles = true;
+  /// Extra compiler arguments to retry failed translation units with (e.g. a different
+  /// language standard). Retries are attempted in order until one succeeds.
+  /// Only used by the overloads that take a compilation database.
+  std::vector<std::vector<std::string>> retry_args;
+  /// If set, cancellation is checked between translation units and periodically while
+  /// a translation unit is parsed. The types of the translation unit that was being parsed
+  /// are discarded, the remaining translation units are skipped and the error field of
+  /// the result is set. Must outlive the parse.
+  const CancellationToken* cancellation_token = nullptr;
+  /// If set, called on the parsing thread whenever a translation unit is started or finished.
+  /// Not used by ParseRecordsFromCode.
+  std::function<void(const ParseProgress&)> progress_callback;
+};
+
+/// A set of extra compiler arguments to parse source files with (e.g. a target triple).
+struct ParseVariant {
+  std::string name;
+  std::vector<std::string> args;
+};
+
+/// A file that only exists in memory (e.g. a header that is included by in-memory code).
+struct VirtualFile {
+  /// Path that is used to refer to the file (e.g. in #include directives).
+  std::string path;
+  std::string contents;
 };
 
 ParseResult ParseRecords(clang::tooling::ClangTool& tool, const ParseConfig& config = {});
 ParseResult ParseRecords(std::string_view build_dir, std::span<const std::string> source_files,
                          const ParseConfig& config = {});
 
+/// Parses source files once for each variant. The compilation database and the file cache
+/// are shared between variants. The first variant provides the main enums and records;
+/// for other variants, only layouts that differ from the main result are kept.
+ParseResult ParseRecords(const clang::tooling::CompilationDatabase& compilations,
+                         std::span<const std::string> source_files,
+                         std::span<const ParseVariant> variants, const ParseConfig& config = {});
+
+/// Turns the result of parsing a variant into a ParseVariantResult that only keeps the types
+/// whose layouts differ from `main` (as done by ParseRecords).
+ParseVariantResult MakeVariantResult(std::string name, const ParseResult& main,
+                                     ParseResult&& variant);
+
+/// Parses a source file that only exists in memory. `args` are compiler arguments (without
+/// the input file name). Virtual files are visible to the compiler in addition to the real
+/// file system, which makes it possible to parse generated code without writing any file.
+ParseResult ParseRecordsFromCode(std::string_view code, std::span<const std::string> args,
+                                 std::span<const VirtualFile> virtual_files = {},
+                                 const ParseConfig& config = {});
+
 }  // namespace classgen
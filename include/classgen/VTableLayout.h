@@ -0,0 +1,49 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include <classgen/Record.h>
+
+namespace classgen {
+
+/// A primary or secondary virtual table inside a vtable group.
+/// [Itanium ABI] Each group starts with vcall and vbase offsets, followed by the offset to top,
+/// the RTTI pointer and function pointers.
+struct VTableGroup {
+  /// Index of the first component of the group (the first vcall/vbase offset, if any).
+  std::size_t begin{};
+  /// Index past the last component of the group.
+  std::size_t end{};
+  /// Offset to top. The negated offset is the offset of the subobject in the complete object.
+  std::int64_t offset_to_top{};
+  std::size_t num_vcall_offsets{};
+  std::size_t num_vbase_offsets{};
+  /// Function pointer components (including destructors), in slot order.
+  std::vector<const VTableComponent*> functions;
+};
+
+/// Splits a vtable into groups. The first group is the primary virtual table.
+std::vector<VTableGroup> GetVTableGroups(const VTable& vtable);
+
+/// Returns the function pointer of a component, or nullptr if the component is not a function
+/// pointer (or destructor pointer).
+const VTableComponent::FunctionPointer* GetFunctionPointer(const VTableComponent& component);
+
+/// Returns whether the component is a complete or deleting destructor pointer.
+bool IsDestructor(const VTableComponent& component);
+
+/// Returns a key that identifies the implementation of a virtual function, i.e. the function
+/// representation without annotations such as `[this adjustment: ...]`. Thunks and the function
+/// they adjust to have the same key.
+std::string_view GetImplementationKey(const VTableComponent::FunctionPointer& func);
+
+/// Returns whether a function pointer points to a pure virtual function.
+bool IsPureVirtual(const VTableComponent::FunctionPointer& func);
+
+}  // namespace classgen
@@ -0,0 +1,71 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <classgen/Record.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct BitfieldOptions {
+  /// Maximum number of records to list. 0 means no limit.
+  std::size_t max_entries = 50;
+};
+
+struct BitfieldReport {
+  /// A sequence of adjacent bitfield members.
+  struct Run {
+    std::vector<std::string> members;
+    /// Offset of the first byte of the run.
+    std::size_t offset{};
+    /// Size of the widest declared type in the run.
+    std::size_t unit_size{};
+    /// Bytes reserved for the run, up to the next field (or the end of the record data).
+    std::size_t storage_size{};
+    std::size_t bits_used{};
+    std::size_t bits_wasted{};
+    /// Smallest power-of-two number of bytes that can hold all bits of the run.
+    std::size_t narrowed_size{};
+  };
+
+  struct Entry {
+    std::string record_name;
+    std::size_t record_size{};
+    std::vector<Run> runs;
+    std::size_t bits_used{};
+    std::size_t bits_wasted{};
+    /// Whether bitfields are split into several runs by non-bitfield members.
+    bool is_split = false;
+    /// Upper bound on the bytes that would be saved by merging all runs into a single one.
+    std::size_t merge_savings{};
+    /// Upper bound on the bytes that would be saved by narrowing the declared types of runs
+    /// to the smallest type that holds all of their bits.
+    std::size_t narrowing_savings{};
+  };
+
+  std::size_t num_records{};
+  std::size_t num_runs{};
+  std::size_t total_bits_used{};
+  std::size_t total_bits_wasted{};
+  /// Sorted by decreasing potential savings, then by decreasing number of wasted bits.
+  std::vector<Entry> entries;
+};
+
+/// Reports how efficiently bitfields are packed in every record that has bitfields.
+/// Runs are built from member offsets and bitfield widths only.
+///
+/// Unnamed bitfields (including zero-width ones) are not stored in type dumps, so bits that
+/// are reserved on purpose with explicit padding are counted as wasted.
+BitfieldReport AnalyzeBitfields(const ParseResult& result, const BitfieldOptions& options = {});
+
+void PrintBitfieldReport(llvm::raw_ostream& os, const BitfieldReport& report);
+
+}  // namespace classgen
@@ -0,0 +1,63 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <classgen/CountTable.h>
+#include <classgen/Layout.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct DevirtualizationOptions {
+  /// Call sites that account for at least this fraction of all calls are considered hot.
+  double hot_call_fraction = 0.01;
+};
+
+struct DevirtualizationReport {
+  /// A virtual function that is introduced by a class and never overridden
+  /// in any derived record of the dump.
+  struct Function {
+    std::string record_name;
+    std::string function_name;
+    std::string repr;
+    std::uint64_t calls{};
+    bool is_hot = false;
+  };
+
+  /// An abstract class with exactly one concrete derived record in the dump.
+  struct SingleImplementation {
+    std::string record_name;
+    std::string implementation_name;
+    std::uint64_t calls{};
+    bool is_hot = false;
+  };
+
+  std::vector<Function> never_overridden;
+  std::vector<SingleImplementation> single_implementations;
+  /// Dynamic classes that no record in the dump derives from.
+  std::vector<std::string> final_candidates;
+
+  bool has_call_counts = false;
+  std::uint64_t total_calls{};
+};
+
+/// Finds virtual functions and classes for which virtual dispatch could be removed.
+/// `call_counts` is an optional count table with a member column (class,function,count) that
+/// records calls through each class interface.
+///
+/// Note that the results are only valid if the dump covers every class of the program.
+DevirtualizationReport AnalyzeDevirtualization(const TypeIndex& index,
+                                               const CountTable* call_counts,
+                                               const DevirtualizationOptions& options = {});
+
+void PrintDevirtualizationReport(llvm::raw_ostream& os, const DevirtualizationReport& report);
+
+}  // namespace classgen
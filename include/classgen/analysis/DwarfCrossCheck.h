@@ -0,0 +1,63 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <classgen/Layout.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct DwarfCrossCheckResult {
+  struct Mismatch {
+    enum class Kind {
+      Size,
+      /// A member variable is at a different offset (or bit offset for bitfields).
+      FieldOffset,
+      /// A non-virtual base is at a different offset.
+      BaseOffset,
+      /// The primary virtual table has a different number of function slots.
+      VTableSlots,
+    };
+
+    Kind kind{};
+    std::string record_name;
+    /// Member variable name or base type name. Empty for Size and VTableSlots.
+    std::string field_name;
+    /// Value in the source-extracted type dump. Offsets are in bits.
+    std::size_t source_value{};
+    /// Value in the debug info. Offsets are in bits.
+    std::size_t dwarf_value{};
+  };
+
+  explicit operator bool() const { return mismatches.empty(); }
+
+  /// In source order.
+  std::vector<Mismatch> mismatches;
+  /// Number of records that exist in both inputs.
+  std::size_t num_checked_records{};
+  /// Number of records that are not described by the debug info (e.g. unused types).
+  std::size_t num_missing_records{};
+  /// Number of checked records whose vtable slots were not compared because the vtable
+  /// could not be fully reconstructed from the debug info (see VTable::is_incomplete).
+  std::size_t num_incomplete_vtables{};
+};
+
+/// Compares layouts extracted from source code against layouts extracted from the debug info
+/// of the actual build artifacts (see ParseRecordsFromDwarf), to detect differences between
+/// the compilation flags that were used for extraction and the real build flags.
+///
+/// Anonymous records, virtual bases and fields that are missing from the debug info are skipped
+/// because DWARF does not describe them reliably.
+DwarfCrossCheckResult CrossCheckWithDwarf(const TypeIndex& source, const TypeIndex& dwarf);
+
+void PrintDwarfCrossCheckResult(llvm::raw_ostream& os, const DwarfCrossCheckResult& result);
+
+}  // namespace classgen
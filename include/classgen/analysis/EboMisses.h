@@ -0,0 +1,64 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <classgen/Layout.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct EboMissOptions {
+  /// Maximum number of records to list. 0 means no limit.
+  std::size_t max_entries = 50;
+};
+
+struct EboMissReport {
+  /// An empty subobject that takes up space.
+  struct Miss {
+    /// Empty record stored as a data member (rather than an empty base that could not be
+    /// placed at offset 0).
+    bool is_member = false;
+    /// Member name (for members).
+    std::string name;
+    std::string type_name;
+    std::size_t offset{};
+    /// Number of elements (for arrays of empty records).
+    std::uint64_t count = 1;
+    /// Bytes between the subobject and the next field.
+    std::size_t occupied_bytes{};
+  };
+
+  struct Entry {
+    std::string record_name;
+    std::size_t size{};
+    std::vector<Miss> misses;
+    /// Estimated number of bytes the record would shrink by if all empty subobjects
+    /// were optimised away.
+    std::size_t bytes_lost{};
+  };
+
+  /// Sorted by decreasing bytes lost.
+  std::vector<Entry> entries;
+  std::size_t total_bytes_lost{};
+  /// Set if the type dump was generated with inlined empty records (classgen-dump -i).
+  /// Empty bases and members are missing from such dumps, so nothing can be found.
+  bool empty_records_inlined = false;
+};
+
+/// Finds empty records that are stored as data members (where [[no_unique_address]] or
+/// inheriting from them would save space) and empty bases that could not be placed
+/// at offset 0, and estimates the bytes that are lost in each record.
+EboMissReport AnalyzeEboMisses(const TypeIndex& index, const EboMissOptions& options = {});
+
+void PrintEboMissReport(llvm::raw_ostream& os, const EboMissReport& report);
+
+}  // namespace classgen
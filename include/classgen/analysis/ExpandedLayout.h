@@ -0,0 +1,27 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <classgen/Layout.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct ExpandedLayoutOptions {
+  /// Names of the records to print. If empty, all records are printed.
+  std::vector<std::string> records;
+};
+
+/// Prints records as a flat list of leaf members with absolute offsets and access paths
+/// (see LayoutExpander). Returns false if a requested record could not be found.
+bool PrintExpandedLayouts(llvm::raw_ostream& os, const TypeIndex& index,
+                          const ExpandedLayoutOptions& options = {});
+
+}  // namespace classgen
@@ -0,0 +1,75 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <classgen/CountTable.h>
+#include <classgen/Layout.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct HeapFootprintOptions {
+  /// How deep embedded subobjects (bases, record members) should be expanded in the breakdown.
+  std::size_t max_depth = 2;
+  /// Maximum number of types and records to list. 0 means no limit.
+  std::size_t max_entries = 50;
+};
+
+struct HeapFootprintReport {
+  /// Bytes attributed to a field, to padding or to an embedded subobject.
+  struct Node {
+    std::string label;
+    bool is_padding = false;
+    std::size_t offset{};
+    /// Bytes across all live instances.
+    std::uint64_t bytes{};
+    std::vector<Node> children;
+  };
+
+  struct TypeEntry {
+    std::string name;
+    std::size_t size{};
+    std::uint64_t instances{};
+    std::uint64_t bytes{};
+    /// Padding bytes, including padding inside embedded subobjects.
+    std::uint64_t padding_bytes{};
+    std::vector<Node> breakdown;
+  };
+
+  struct RecordEntry {
+    std::string name;
+    /// Bytes occupied by this record across all live instances, including occurrences
+    /// as a base or as a member of other records.
+    std::uint64_t bytes{};
+    /// Padding bytes inside those occurrences (excluding embedded subobjects).
+    std::uint64_t padding_bytes{};
+  };
+
+  std::uint64_t total_bytes{};
+  std::uint64_t total_padding_bytes{};
+  /// Sorted by decreasing total size.
+  std::vector<TypeEntry> types;
+  /// Sorted by decreasing padding bytes (i.e. where shrinking a record would pay off most).
+  std::vector<RecordEntry> records;
+  /// Types in the instance count table that do not exist in the dump.
+  std::vector<std::string> unmatched_types;
+};
+
+/// Estimates the heap footprint of each type from live instance counts
+/// (a count table without member column), and attributes each type's bytes to fields,
+/// padding and embedded subobjects.
+HeapFootprintReport AnalyzeHeapFootprint(const TypeIndex& index, const CountTable& instances,
+                                         const HeapFootprintOptions& options = {});
+
+void PrintHeapFootprintReport(llvm::raw_ostream& os, const HeapFootprintReport& report);
+
+}  // namespace classgen
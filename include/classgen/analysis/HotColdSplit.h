@@ -0,0 +1,81 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <classgen/CountTable.h>
+#include <classgen/Record.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct HotColdOptions {
+  std::size_t cache_line_size = 64;
+  /// Hot fields are the most accessed fields that together account for this fraction of accesses.
+  double hot_coverage = 0.9;
+  /// Fields that account for less than this fraction of accesses are considered cold.
+  double cold_threshold = 0.01;
+  /// Size of the pointer that replaces cold fields when they are split into a separate struct.
+  std::size_t pointer_size = 8;
+};
+
+struct HotColdSuggestion {
+  enum class Temperature {
+    Hot,
+    Warm,
+    Cold,
+  };
+
+  /// A member variable or a run of adjacent bitfields (which cannot be moved separately).
+  struct Unit {
+    std::string name;
+    std::size_t offset{};
+    std::size_t size{};
+    std::size_t alignment{};
+    std::uint64_t count{};
+    Temperature temperature{};
+    /// Offset in the suggested layout. Meaningless for cold units if the record is split.
+    std::size_t new_offset{};
+  };
+
+  std::string record_name;
+  std::size_t record_size{};
+  std::uint64_t total_accesses{};
+  /// Units in the suggested order.
+  std::vector<Unit> units;
+  std::size_t hot_bytes{};
+  std::size_t cold_bytes{};
+
+  /// Estimated number of distinct cache lines that are touched per access to the record.
+  /// An access is modelled as touching each field with a probability that is proportional
+  /// to its access count (the most accessed field is always touched).
+  double lines_before{};
+  /// Same, after clustering hot fields at the start of the record.
+  double lines_reordered{};
+  /// Same, after also moving cold fields to a separate struct.
+  double lines_split{};
+};
+
+struct HotColdReport {
+  /// Sorted by decreasing estimated savings (cache lines saved, weighted by access counts).
+  std::vector<HotColdSuggestion> suggestions;
+  /// Profile entries that could not be matched to a record or a member.
+  std::vector<std::string> unmatched_entries;
+};
+
+/// Suggests hot/cold splits and hot field clustering based on a field access profile
+/// (a count table with a member column).
+HotColdReport AnalyzeHotColdSplit(const ParseResult& result, const CountTable& profile,
+                                  const HotColdOptions& options = {});
+
+void PrintHotColdReport(llvm::raw_ostream& os, const HotColdReport& report);
+
+}  // namespace classgen
@@ -0,0 +1,91 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <classgen/Layout.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+/// A set of layout rules.
+///
+/// The text format has one rule per line. Empty lines and lines that start with # are ignored.
+/// Patterns are glob patterns that are matched against fully qualified record names.
+///
+///   no-grow <pattern>              sizeof must not increase compared to the baseline
+///   no-alignment-growth <pattern>  alignof must not increase compared to the baseline
+///   no-padding-growth <pattern>    padding bytes must not increase compared to the baseline
+///   no-new-cache-lines <pattern>   the number of cache lines spanned must not increase
+///   sizeof(<pattern>) <= <N>       sizeof must not exceed N
+///   alignof(<pattern>) <= <N>      alignof must not exceed N
+struct LayoutPolicy {
+  struct Rule {
+    enum class Kind {
+      NoGrow,
+      NoAlignmentGrowth,
+      NoPaddingGrowth,
+      NoNewCacheLines,
+      MaxSize,
+      MaxAlignment,
+    };
+
+    Kind kind{};
+    std::string pattern;
+    /// Only used for MaxSize and MaxAlignment.
+    std::size_t limit{};
+    /// Where the rule was defined (e.g. `policy.txt:3`), for diagnostics.
+    std::string location;
+  };
+
+  /// Returns the policy that is used if no policy file is specified:
+  /// sizes, alignments and padding must not grow.
+  static LayoutPolicy Default();
+
+  /// Returns whether any rule compares against a baseline.
+  bool HasBaselineRules() const;
+
+  explicit operator bool() const { return error.empty(); }
+
+  std::string error;
+  std::vector<Rule> rules;
+};
+
+/// Reads a layout policy from a file. On failure, the error field of the returned policy is set.
+LayoutPolicy ReadLayoutPolicy(const std::string& path);
+
+struct LayoutCheckOptions {
+  std::size_t cache_line_size = 64;
+};
+
+struct LayoutCheckResult {
+  struct Violation {
+    std::string record_name;
+    std::string message;
+    /// The rule that was violated.
+    std::string rule_location;
+  };
+
+  explicit operator bool() const { return error.empty() && violations.empty(); }
+
+  /// Set if the policy is invalid (e.g. a malformed pattern).
+  std::string error;
+  std::vector<Violation> violations;
+  std::size_t num_checked_records{};
+};
+
+/// Checks the records in `current` against a policy. Rules that compare against a baseline
+/// are skipped if `baseline` is nullptr, and for records that do not exist in the baseline.
+LayoutCheckResult CheckLayouts(const TypeIndex* baseline, const TypeIndex& current,
+                               const LayoutPolicy& policy, const LayoutCheckOptions& options = {});
+
+void PrintLayoutCheckResult(llvm::raw_ostream& os, const LayoutCheckResult& result);
+
+}  // namespace classgen
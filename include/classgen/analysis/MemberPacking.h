@@ -0,0 +1,72 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <classgen/CountTable.h>
+#include <classgen/Layout.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct MemberPackingOptions {
+  /// Maximum number of records to list. 0 means no limit.
+  std::size_t max_entries = 50;
+};
+
+struct MemberPackingReport {
+  /// A bool or enum member variable.
+  struct Member {
+    std::string name;
+    std::string type_name;
+    std::size_t size{};
+    /// Number of bits that are required to represent all possible values.
+    std::size_t bits{};
+    /// Size of the smallest integer type that can represent all possible values.
+    std::size_t narrowed_size{};
+  };
+
+  struct Entry {
+    std::string record_name;
+    std::size_t record_size{};
+    std::vector<Member> bools;
+    std::vector<Member> enums;
+    /// Bytes saved by narrowing the underlying type of enums.
+    std::size_t narrowing_savings{};
+    /// Bytes saved by turning all bools and enums into bitfields.
+    std::size_t bitpacking_savings{};
+    /// Live instances (if instance counts are available).
+    std::uint64_t instances{};
+    /// Best per-instance savings multiplied by the number of live instances.
+    std::uint64_t weighted_savings{};
+  };
+
+  bool has_instance_counts = false;
+  /// Sum of the best per-instance savings of all records.
+  std::size_t total_savings{};
+  std::uint64_t total_weighted_savings{};
+  /// Sorted by decreasing weighted savings (if instance counts are available),
+  /// then by decreasing per-instance savings.
+  std::vector<Entry> entries;
+};
+
+/// Finds records with several bool members or with enum members whose underlying type is wider
+/// than what their enumerators require, and estimates the savings from bit-packing them or
+/// narrowing the enums. Savings are upper bounds: the record size only shrinks if the removed
+/// bytes are not replaced by padding.
+/// If live instance counts are passed (a count table without member column), savings are
+/// also weighted by instance counts.
+MemberPackingReport AnalyzeMemberPacking(const TypeIndex& index, const CountTable* instances,
+                                         const MemberPackingOptions& options = {});
+
+void PrintMemberPackingReport(llvm::raw_ostream& os, const MemberPackingReport& report);
+
+}  // namespace classgen
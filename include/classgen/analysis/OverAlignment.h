@@ -0,0 +1,71 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <classgen/Layout.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct OverAlignmentOptions {
+  /// Size and alignment of a vtable pointer.
+  std::size_t pointer_size = 8;
+  /// Maximum number of records to list. 0 means no limit.
+  std::size_t max_entries = 50;
+};
+
+struct OverAlignmentReport {
+  /// A place where an affected record is embedded by value.
+  struct Embedding {
+    std::string record_name;
+    /// Member name, or base class name.
+    std::string field_name;
+    /// Number of elements (1 for non-array members and bases).
+    std::uint64_t count{};
+    /// Bytes wasted by the embedded record(s) in each instance of the containing record.
+    std::uint64_t wasted_bytes{};
+  };
+
+  struct Entry {
+    std::string record_name;
+    std::size_t size{};
+    std::size_t alignment{};
+    /// Size and alignment of the record if nothing was over-aligned.
+    std::size_t natural_size{};
+    std::size_t natural_alignment{};
+    std::size_t internal_padding{};
+    std::size_t tail_padding{};
+    /// size - natural_size
+    std::size_t wasted_bytes{};
+    /// Whether the record itself is declared with a larger alignment than its fields require.
+    bool is_explicitly_aligned = false;
+    /// Fields whose alignment is larger than their natural alignment.
+    std::vector<std::string> over_aligned_fields;
+    std::vector<Embedding> embeddings;
+  };
+
+  /// Sorted by decreasing wasted bytes, then by decreasing alignment growth.
+  std::vector<Entry> entries;
+  /// Number of records that were not analysed because the type dump does not contain
+  /// the alignment of some of their members (dumps from older versions of classgen).
+  std::size_t num_records_without_member_alignments{};
+};
+
+/// Finds records that are larger or more aligned than they would be without alignas
+/// (on the record itself or on any of its fields, recursively), and lists where they are
+/// embedded so that the compounded waste is visible.
+OverAlignmentReport AnalyzeOverAlignment(const TypeIndex& index,
+                                         const OverAlignmentOptions& options = {});
+
+void PrintOverAlignmentReport(llvm::raw_ostream& os, const OverAlignmentReport& report);
+
+}  // namespace classgen
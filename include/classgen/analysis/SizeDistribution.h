@@ -0,0 +1,91 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringSet.h>
+
+#include <classgen/Layout.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct SizeDistributionOptions {
+  /// Prefix that is stripped from source file paths before grouping records by directory.
+  std::string source_root;
+  /// Optional label that identifies the data point (e.g. a commit hash or a date).
+  std::string label;
+};
+
+/// Histogram with power-of-two buckets: bucket 0 counts zeros and bucket i counts values
+/// in [2^(i-1), 2^i).
+struct SizeHistogram {
+  void Add(std::uint64_t value);
+
+  static std::uint64_t GetBucketMin(std::size_t bucket);
+  static std::uint64_t GetBucketMax(std::size_t bucket);
+
+  std::vector<std::uint64_t> buckets;
+};
+
+struct SizeDistributionReport {
+  struct Group {
+    std::size_t num_records{};
+    std::size_t num_dynamic_records{};
+    std::uint64_t total_size{};
+    std::size_t max_size{};
+    std::uint64_t total_fields{};
+    /// Record sizes in bytes.
+    SizeHistogram sizes;
+    /// Number of member variables (excluding bases and vtable pointers).
+    SizeHistogram field_counts;
+    /// Number of vtable components. Only dynamic records are counted.
+    SizeHistogram vtable_lengths;
+  };
+
+  std::string label;
+  Group total;
+  /// Keyed by enclosing namespace ("::" for the global namespace). Nested records are
+  /// attributed to the namespace of their outermost enclosing record.
+  std::map<std::string, Group> namespaces;
+  /// Keyed by the directory of the source file that contains the definition.
+  std::map<std::string, Group> directories;
+};
+
+/// Accumulates a size distribution report one record at a time, so that it can be computed
+/// while records are being dumped without keeping them around.
+class SizeDistributionBuilder {
+public:
+  explicit SizeDistributionBuilder(SizeDistributionOptions options = {});
+
+  void AddRecord(const Record& record);
+
+  /// Attributes nested records to namespaces and returns the report. Must only be called once.
+  SizeDistributionReport Finish();
+
+private:
+  SizeDistributionOptions m_options;
+  SizeDistributionReport m_report;
+  /// Keyed by the immediately enclosing scope, which may be a record.
+  std::map<std::string, SizeDistributionReport::Group> m_scopes;
+  llvm::StringSet<> m_record_names;
+};
+
+/// Computes histograms of record sizes, field counts and vtable lengths per namespace
+/// and per directory.
+SizeDistributionReport AnalyzeSizeDistribution(const TypeIndex& index,
+                                               const SizeDistributionOptions& options = {});
+
+/// Prints the report as JSON, so that it can be stored and compared across builds.
+void PrintSizeDistributionReport(llvm::raw_ostream& os, const SizeDistributionReport& report);
+
+}  // namespace classgen
@@ -0,0 +1,59 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <classgen/Layout.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct SoaCandidateOptions {
+  /// Templates that are considered to be containers of their first template argument.
+  /// For std::array, the second template argument is used as the element count.
+  std::vector<std::string> container_templates{"std::array", "std::deque", "std::vector"};
+  /// Minimum number of member variables for an element record to be considered.
+  std::size_t min_fields = 2;
+  /// Minimum number of padding bytes per element.
+  std::size_t min_padding = 1;
+  /// Maximum number of candidates to list. 0 means no limit.
+  std::size_t max_entries = 50;
+};
+
+struct SoaCandidateReport {
+  struct Entry {
+    /// Record that contains the array or container.
+    std::string record_name;
+    std::string field_name;
+    /// Name of the container template, or empty for fixed arrays.
+    std::string container;
+    std::string element_name;
+    /// Number of elements. 0 if unknown (dynamically sized containers).
+    std::uint64_t count{};
+    std::size_t element_size{};
+    std::size_t element_fields{};
+    std::size_t padding_per_element{};
+    /// Padding bytes across all elements (or per element if the count is unknown).
+    std::uint64_t wasted_bytes{};
+  };
+
+  /// Sorted by decreasing wasted bytes, then by decreasing padding per element.
+  std::vector<Entry> entries;
+};
+
+/// Finds fixed arrays and containers of records that have many fields and a lot of padding,
+/// i.e. places where converting an array of structs to a structure of arrays would help most.
+SoaCandidateReport FindSoaCandidates(const TypeIndex& index,
+                                     const SoaCandidateOptions& options = {});
+
+void PrintSoaCandidateReport(llvm::raw_ostream& os, const SoaCandidateReport& report);
+
+}  // namespace classgen
@@ -0,0 +1,60 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <classgen/Layout.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct VTableStatsOptions {
+  /// Size of a vtable pointer and of a vtable entry.
+  std::size_t pointer_size = 8;
+  /// Maximum number of records to list. 0 means no limit.
+  std::size_t max_entries = 50;
+};
+
+struct VTableStatsReport {
+  struct Entry {
+    std::string record_name;
+    /// Number of virtual tables (primary and secondary) in the vtable group.
+    std::size_t num_vtables{};
+    /// Number of secondary vtable pointers in the object (one per secondary vtable).
+    std::size_t num_secondary_vptrs{};
+    /// Object size overhead of secondary vtable pointers, in bytes.
+    std::size_t secondary_vptr_bytes{};
+    /// Size of the vtable group, in bytes.
+    std::size_t vtable_bytes{};
+    std::size_t num_functions{};
+    std::size_t num_thunks{};
+    /// Thunks with a non-virtual this adjustment.
+    std::size_t num_this_adjusting_thunks{};
+    /// Thunks with a virtual this adjustment (that use a vcall offset).
+    std::size_t num_virtual_this_adjusting_thunks{};
+    std::size_t num_return_adjusting_thunks{};
+    std::size_t num_vbase_offsets{};
+    std::size_t num_vcall_offsets{};
+  };
+
+  std::size_t num_dynamic_records{};
+  /// Sum of all entries.
+  Entry totals;
+  /// Sorted by decreasing object size overhead, then by number of thunks.
+  std::vector<Entry> entries;
+};
+
+/// Computes vtable, thunk and secondary vtable pointer statistics for every dynamic class.
+VTableStatsReport AnalyzeVTableStats(const ParseResult& result,
+                                     const VTableStatsOptions& options = {});
+
+void PrintVTableStatsReport(llvm::raw_ostream& os, const VTableStatsReport& report);
+
+}  // namespace classgen
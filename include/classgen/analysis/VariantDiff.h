@@ -0,0 +1,53 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <classgen/Record.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct VariantDiffReport {
+  struct RecordDiff {
+    std::string record_name;
+    std::string variant;
+    std::size_t main_size{};
+    std::size_t variant_size{};
+    std::size_t main_alignment{};
+    std::size_t variant_alignment{};
+    /// Human-readable descriptions of fields that moved, were added or were removed.
+    std::vector<std::string> field_changes;
+  };
+
+  struct VariantSummary {
+    std::string name;
+    /// Number of records that are only present in the variant.
+    std::size_t num_added_records{};
+    /// Number of records that are only present in the main result.
+    std::size_t num_missing_records{};
+    /// Number of records whose layout differs in a way that does not affect sizes or offsets
+    /// (e.g. different member types or vtable entries).
+    std::size_t num_other_changes{};
+  };
+
+  std::string main_variant;
+  std::vector<VariantSummary> variants;
+  /// Records whose size, alignment or field offsets differ from the main result.
+  /// Sorted by record name, then by variant order.
+  std::vector<RecordDiff> differences;
+};
+
+/// Compares the layouts of every parse variant with the main layouts.
+VariantDiffReport DiffVariants(const ParseResult& result);
+
+void PrintVariantDiffReport(llvm::raw_ostream& os, const VariantDiffReport& report);
+
+}  // namespace classgen
@@ -0,0 +1,71 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <classgen/Layout.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace classgen {
+
+struct VirtualInheritanceOptions {
+  /// Size and alignment of a vtable pointer and of a vtable entry.
+  std::size_t pointer_size = 8;
+  /// Maximum number of records to list. 0 means no limit.
+  std::size_t max_entries = 50;
+};
+
+struct VirtualInheritanceReport {
+  struct VirtualBase {
+    std::string type_name;
+    std::size_t offset{};
+    /// Data size of the base (0 if the base record is unknown).
+    std::size_t size{};
+  };
+
+  struct Entry {
+    std::string record_name;
+    std::size_t size{};
+    /// All virtual bases, including indirect ones, in layout order.
+    std::vector<VirtualBase> virtual_bases;
+    std::size_t num_vbase_offsets{};
+    std::size_t num_vcall_offsets{};
+    /// Size of the vbase and vcall offset entries in the vtables of the record.
+    std::size_t vtable_offset_bytes{};
+    /// Total number of vtable pointers in an instance.
+    std::size_t num_vptrs{};
+    /// Vtable pointers of virtual base subobjects. A non-virtual base can share
+    /// the vtable pointer of the derived class if it is the primary base.
+    std::size_t num_extra_vptrs{};
+    /// Estimated size of the record if every virtual base was inherited non-virtually
+    /// (and only once), without the extra vtable pointers.
+    std::size_t non_virtual_size{};
+    /// size - non_virtual_size (per instance).
+    std::size_t size_overhead{};
+  };
+
+  /// Sorted by decreasing size overhead.
+  std::vector<Entry> entries;
+  std::size_t num_records{};
+  std::size_t total_vbase_offsets{};
+  std::size_t total_vcall_offsets{};
+  std::size_t total_extra_vptrs{};
+};
+
+/// Quantifies the cost of virtual inheritance for every record that has virtual bases:
+/// where the virtual bases are placed, the vbase and vcall offset entries they add to vtables,
+/// the additional vtable pointers, and the size overhead compared with an equivalent
+/// hierarchy that does not use virtual inheritance.
+VirtualInheritanceReport AnalyzeVirtualInheritance(const TypeIndex& index,
+                                                   const VirtualInheritanceOptions& options = {});
+
+void PrintVirtualInheritanceReport(llvm::raw_ostream& os, const VirtualInheritanceReport& report);
+
+}  // namespace classgen
@@ -0,0 +1,389 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/CompilationDatabase.h"
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <vector>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <fmt/format.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/LineIterator.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/StringSaver.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace classgen {
+
+namespace {
+
+constexpr llvm::StringLiteral IndexMagic = "classgen-compdb-index 1";
+
+/// Location of an entry (a JSON object) in the database.
+struct EntryLocation {
+  std::size_t offset{};
+  std::size_t size{};
+};
+
+/// Maps normalized source file paths to the entries of a compilation database.
+struct CompileCommandsIndex {
+  void Add(llvm::StringRef file, EntryLocation location) {
+    const auto [it, inserted] = entries.try_emplace(file);
+    if (inserted)
+      files.push_back(file.str());
+    it->second.push_back(location);
+  }
+
+  /// In database order.
+  std::vector<std::string> files;
+  llvm::StringMap<llvm::SmallVector<EntryLocation, 1>> entries;
+};
+
+std::string NormalizePath(llvm::StringRef path, llvm::StringRef directory) {
+  llvm::SmallString<256> result{path};
+  if (directory.empty())
+    static_cast<void>(llvm::sys::fs::make_absolute(result));
+  else
+    llvm::sys::fs::make_absolute(directory, result);
+  llvm::sys::path::remove_dots(result, true);
+  llvm::sys::path::native(result);
+  return std::string(result);
+}
+
+/// Calls `callback` with the location of every object in a top-level JSON array, without
+/// decoding the objects. Returns false if the document is not an array of objects or if
+/// the callback returns false.
+template <typename Callback>
+bool ForEachArrayObject(llvm::StringRef json, Callback callback) {
+  std::size_t i = 0;
+  const auto skip_whitespace = [&] {
+    while (i < json.size() && llvm::isSpace(json[i]))
+      ++i;
+  };
+
+  skip_whitespace();
+  if (i == json.size() || json[i] != '[')
+    return false;
+  ++i;
+
+  while (true) {
+    skip_whitespace();
+    if (i == json.size())
+      return false;
+    if (json[i] == ']')
+      return true;
+    if (json[i] == ',') {
+      ++i;
+      continue;
+    }
+    if (json[i] != '{')
+      return false;
+
+    const std::size_t begin = i;
+    std::size_t depth = 0;
+    bool in_string = false;
+    for (; i < json.size(); ++i) {
+      const char c = json[i];
+      if (in_string) {
+        if (c == '\\')
+          ++i;
+        else if (c == '"')
+          in_string = false;
+      } else if (c == '"') {
+        in_string = true;
+      } else if (c == '{' || c == '[') {
+        ++depth;
+      } else if ((c == '}' || c == ']') && --depth == 0) {
+        break;
+      }
+    }
+
+    if (i >= json.size())
+      return false;
+    ++i;
+    if (!callback(EntryLocation{begin, i - begin}))
+      return false;
+  }
+}
+
+std::optional<llvm::json::Object> ParseEntry(llvm::StringRef json, EntryLocation location) {
+  llvm::Expected<llvm::json::Value> value =
+      llvm::json::parse(json.substr(location.offset, location.size));
+  if (!value) {
+    llvm::consumeError(value.takeError());
+    return std::nullopt;
+  }
+
+  llvm::json::Object* object = value->getAsObject();
+  if (!object)
+    return std::nullopt;
+  return std::move(*object);
+}
+
+bool BuildIndex(llvm::StringRef json, CompileCommandsIndex& index) {
+  return ForEachArrayObject(json, [&](EntryLocation location) {
+    const auto entry = ParseEntry(json, location);
+    if (!entry)
+      return false;
+
+    const auto directory = entry->getString("directory");
+    const auto file = entry->getString("file");
+    if (!directory || !file)
+      return false;
+
+    index.Add(NormalizePath(*file, *directory), location);
+    return true;
+  });
+}
+
+std::string GetIndexHeader(const llvm::sys::fs::file_status& status) {
+  return fmt::format("{} {} {}", IndexMagic,
+                     status.getLastModificationTime().time_since_epoch().count(),
+                     status.getSize());
+}
+
+/// Index format: a header line that identifies the version of the database, followed by
+/// one `<offset> <size> <normalized path>` line per entry.
+bool ReadIndex(const std::string& path, llvm::StringRef header, std::size_t database_size,
+               CompileCommandsIndex& index) {
+  auto buffer = llvm::MemoryBuffer::getFile(path, true);
+  if (!buffer)
+    return false;
+
+  llvm::line_iterator it{**buffer};
+  if (it.is_at_eof() || *it != header)
+    return false;
+
+  for (++it; !it.is_at_eof(); ++it) {
+    const auto [offset, rest] = it->split(' ');
+    const auto [size, file] = rest.split(' ');
+    EntryLocation location;
+    if (offset.getAsInteger(10, location.offset) || size.getAsInteger(10, location.size) ||
+        file.empty() || location.offset + location.size > database_size) {
+      return false;
+    }
+    index.Add(file, location);
+  }
+  return true;
+}
+
+/// Writes the index atomically. Failures are ignored (e.g. read-only build directories):
+/// the index is then rebuilt on every run.
+void WriteIndex(const std::string& path, llvm::StringRef header,
+                const CompileCommandsIndex& index) {
+  int fd;
+  llvm::SmallString<256> temp_path;
+  if (llvm::sys::fs::createUniqueFile(path + "-%%%%%%", fd, temp_path))
+    return;
+
+  {
+    llvm::raw_fd_ostream os{fd, true};
+    os << header << '\n';
+    for (const std::string& file : index.files) {
+      for (const EntryLocation& location : index.entries.find(file)->second)
+        os << location.offset << ' ' << location.size << ' ' << file << '\n';
+    }
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      llvm::sys::fs::remove(temp_path);
+      return;
+    }
+  }
+
+  if (llvm::sys::fs::rename(temp_path, path))
+    llvm::sys::fs::remove(temp_path);
+}
+
+std::string GetNormalizedCommandLine(const clang::tooling::CompileCommand& command) {
+  std::string key = command.Directory;
+  const std::vector<std::string>& args = command.CommandLine;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    const llvm::StringRef arg = args[i];
+    if (arg == command.Filename || (!command.Output.empty() && arg == "-o" + command.Output))
+      continue;
+    // Output and dependency file options.
+    if (arg == "-o" || arg == "-MF" || arg == "-MT" || arg == "-MQ") {
+      ++i;
+      continue;
+    }
+    if (arg.startswith("-MF") || arg.startswith("-MT") || arg.startswith("-MQ"))
+      continue;
+    key += '\0';
+    key += arg;
+  }
+  return key;
+}
+
+class IndexedCompilationDatabase final : public clang::tooling::CompilationDatabase {
+public:
+  IndexedCompilationDatabase(std::unique_ptr<llvm::MemoryBuffer> database,
+                             CompileCommandsIndex index)
+      : m_database(std::move(database)), m_index(std::move(index)) {}
+
+  std::vector<clang::tooling::CompileCommand>
+  getCompileCommands(llvm::StringRef FilePath) const override {
+    const auto it = m_index.entries.find(NormalizePath(FilePath, {}));
+    if (it == m_index.entries.end())
+      return {};
+
+    std::vector<clang::tooling::CompileCommand> commands;
+    for (const EntryLocation& location : it->second) {
+      if (auto command = DecodeEntry(location))
+        commands.emplace_back(std::move(*command));
+    }
+    return commands;
+  }
+
+  std::vector<std::string> getAllFiles() const override { return m_index.files; }
+
+  std::vector<clang::tooling::CompileCommand> getAllCompileCommands() const override {
+    std::vector<clang::tooling::CompileCommand> commands;
+    for (const std::string& file : m_index.files) {
+      for (const EntryLocation& location : m_index.entries.find(file)->second) {
+        if (auto command = DecodeEntry(location))
+          commands.emplace_back(std::move(*command));
+      }
+    }
+    return commands;
+  }
+
+private:
+  std::optional<clang::tooling::CompileCommand> DecodeEntry(EntryLocation location) const {
+    const auto entry = ParseEntry(m_database->getBuffer(), location);
+    if (!entry)
+      return std::nullopt;
+
+    const auto directory = entry->getString("directory");
+    const auto file = entry->getString("file");
+    if (!directory || !file)
+      return std::nullopt;
+
+    std::vector<std::string> command_line;
+    if (const llvm::json::Array* arguments = entry->getArray("arguments")) {
+      for (const llvm::json::Value& argument : *arguments) {
+        if (const auto str = argument.getAsString())
+          command_line.push_back(str->str());
+      }
+    } else if (const auto command = entry->getString("command")) {
+      llvm::BumpPtrAllocator allocator;
+      llvm::StringSaver saver{allocator};
+      llvm::SmallVector<const char*, 64> tokens;
+      llvm::cl::TokenizeGNUCommandLine(*command, saver, tokens);
+      command_line.assign(tokens.begin(), tokens.end());
+    } else {
+      return std::nullopt;
+    }
+
+    return clang::tooling::CompileCommand(*directory, *file, std::move(command_line),
+                                          entry->getString("output").getValueOr(""));
+  }
+
+  std::unique_ptr<llvm::MemoryBuffer> m_database;
+  CompileCommandsIndex m_index;
+};
+
+class CachingCompilationDatabase final : public clang::tooling::CompilationDatabase {
+public:
+  explicit CachingCompilationDatabase(const clang::tooling::CompilationDatabase& compilations)
+      : m_compilations(compilations) {}
+
+  std::vector<clang::tooling::CompileCommand>
+  getCompileCommands(llvm::StringRef FilePath) const override {
+    // ClangTool looks files up by absolute path.
+    const std::string path = NormalizePath(FilePath, {});
+    const auto [it, inserted] = m_commands.try_emplace(path);
+    if (inserted)
+      it->second = m_compilations.getCompileCommands(FilePath);
+    return it->second;
+  }
+
+  std::vector<std::string> getAllFiles() const override { return m_compilations.getAllFiles(); }
+
+  std::vector<clang::tooling::CompileCommand> getAllCompileCommands() const override {
+    return m_compilations.getAllCompileCommands();
+  }
+
+private:
+  const clang::tooling::CompilationDatabase& m_compilations;
+  mutable llvm::StringMap<std::vector<clang::tooling::CompileCommand>> m_commands;
+};
+
+}  // namespace
+
+std::unique_ptr<clang::tooling::CompilationDatabase>
+LoadIndexedCompilationDatabase(std::string_view path, std::string& error) {
+  llvm::SmallString<256> database_path{llvm::StringRef(path.data(), path.size())};
+  if (llvm::sys::fs::is_directory(database_path))
+    llvm::sys::path::append(database_path, "compile_commands.json");
+
+  llvm::sys::fs::file_status status;
+  if (const auto ec = llvm::sys::fs::status(database_path, status)) {
+    error = fmt::format("failed to stat {}: {}", database_path.str(), ec.message());
+    return nullptr;
+  }
+
+  // Entries are decoded lazily: avoid reading the whole file if it can be mapped.
+  auto buffer = llvm::MemoryBuffer::getFile(database_path, false, false);
+  if (!buffer) {
+    error = fmt::format("failed to read {}: {}", database_path.str(), buffer.getError().message());
+    return nullptr;
+  }
+
+  const std::string index_path = (database_path + ".classgen-index").str();
+  const std::string header = GetIndexHeader(status);
+  CompileCommandsIndex index;
+  if (!ReadIndex(index_path, header, (*buffer)->getBufferSize(), index)) {
+    index = {};
+    if (!BuildIndex((*buffer)->getBuffer(), index)) {
+      error = fmt::format("failed to parse {}", database_path.str());
+      return nullptr;
+    }
+    WriteIndex(index_path, header, index);
+  }
+
+  auto database =
+      std::make_unique<IndexedCompilationDatabase>(std::move(*buffer), std::move(index));
+  // Same adjustments as clang::tooling::CompilationDatabase::loadFromDirectory.
+  return clang::tooling::inferTargetAndDriverMode(clang::tooling::inferMissingCompileCommands(
+      clang::tooling::expandResponseFiles(std::move(database), llvm::vfs::getRealFileSystem())));
+}
+
+std::unique_ptr<clang::tooling::CompilationDatabase>
+MakeCachingCompilationDatabase(const clang::tooling::CompilationDatabase& compilations) {
+  return std::make_unique<CachingCompilationDatabase>(compilations);
+}
+
+std::vector<std::string>
+GroupByCompileFlags(const clang::tooling::CompilationDatabase& compilations,
+                    std::span<const std::string> source_files) {
+  llvm::StringMap<std::size_t> group_indices;
+  std::vector<std::vector<std::string>> groups;
+
+  for (const std::string& file : source_files) {
+    const auto commands = compilations.getCompileCommands(file);
+    const std::string key = commands.empty() ? "" : GetNormalizedCommandLine(commands.front());
+    const auto [it, inserted] = group_indices.try_emplace(key, groups.size());
+    if (inserted)
+      groups.emplace_back();
+    groups[it->second].push_back(file);
+  }
+
+  std::vector<std::string> result;
+  result.reserve(source_files.size());
+  for (std::vector<std::string>& group : groups)
+    std::move(group.begin(), group.end(), std::back_inserter(result));
+  return result;
+}
+
+}  // namespace classgen
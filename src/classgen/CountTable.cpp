@@ -0,0 +1,75 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/CountTable.h"
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/LineIterator.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include "classgen/Layout.h"
+
+namespace classgen {
+
+namespace {
+
+bool IsIdentifier(llvm::StringRef str) {
+  return !str.empty() && llvm::all_of(str, [](char c) { return llvm::isAlnum(c) || c == '_'; });
+}
+
+}  // namespace
+
+CountTable ReadCountTable(const std::string& path, bool has_member_column) {
+  CountTable table;
+
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    table.error = fmt::format("failed to read {}: {}", path, buffer.getError().message());
+    return table;
+  }
+
+  for (llvm::line_iterator it(**buffer, /*SkipBlanks=*/true, '#'); !it.is_at_end(); ++it) {
+    const auto fail = [&](std::string_view message) {
+      table.error = fmt::format("{}:{}: {}", path, it.line_number(), message);
+      table.entries.clear();
+      return table;
+    };
+
+    const llvm::StringRef line = it->trim();
+    if (line.empty())
+      continue;
+
+    if (!line.contains(','))
+      return fail("expected a count column");
+
+    auto [rest, count_str] = line.rsplit(',');
+
+    CountTable::Entry entry;
+    if (count_str.trim().getAsInteger(10, entry.count))
+      return fail("invalid count");
+
+    rest = rest.trim();
+    if (has_member_column) {
+      auto [name, member] = rest.rsplit(',');
+      if (!IsIdentifier(member.trim())) {
+        // Type::member shorthand.
+        const size_t separator = FindLastScopeSeparator(rest);
+        if (separator == llvm::StringRef::npos)
+          return fail("expected a member column");
+        name = rest.take_front(separator);
+        member = rest.drop_front(separator + 2);
+      }
+      entry.name = name.trim().str();
+      entry.member = member.trim().str();
+    } else {
+      entry.name = rest.str();
+    }
+
+    table.entries.emplace_back(std::move(entry));
+  }
+
+  return table;
+}
+
+}  // namespace classgen
@@ -0,0 +1,999 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/Dwarf.h"
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+#include <fmt/format.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/BinaryFormat/Dwarf.h>
+#include <llvm/DebugInfo/DWARF/DWARFContext.h>
+#include <llvm/DebugInfo/DWARF/DWARFDie.h>
+#include <llvm/DebugInfo/DWARF/DWARFFormValue.h>
+#include <llvm/DebugInfo/DWARF/DWARFUnit.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/LEB128.h>
+#include <llvm/Support/MathExtras.h>
+
+namespace classgen {
+
+namespace {
+
+using llvm::DWARFDie;
+namespace dwarf = llvm::dwarf;
+
+bool GetFlag(const DWARFDie& die, dwarf::Attribute attr) {
+  const auto value = die.find(attr);
+  return value && value->getRawUValue() != 0;
+}
+
+std::optional<std::uint64_t> GetUnsigned(const DWARFDie& die, dwarf::Attribute attr) {
+  if (const auto value = dwarf::toUnsigned(die.find(attr)))
+    return *value;
+  return std::nullopt;
+}
+
+/// Decodes a constant location, either stored directly or as a DWARF expression that consists
+/// of a single DW_OP_plus_uconst or DW_OP_constu operation (older producers and vtable slots).
+std::optional<std::uint64_t> GetConstantLocation(const DWARFDie& die, dwarf::Attribute attr) {
+  const auto value = die.find(attr);
+  if (!value)
+    return std::nullopt;
+
+  if (const auto constant = value->getAsUnsignedConstant())
+    return *constant;
+
+  const auto block = value->getAsBlock();
+  if (!block || block->empty())
+    return std::nullopt;
+
+  const std::uint8_t op = block->front();
+  if (op != dwarf::DW_OP_plus_uconst && op != dwarf::DW_OP_constu)
+    return std::nullopt;
+
+  unsigned length = 0;
+  const char* error = nullptr;
+  const std::uint64_t result =
+      llvm::decodeULEB128(block->data() + 1, &length, block->data() + block->size(), &error);
+  if (error || 1 + length != block->size())
+    return std::nullopt;
+  return result;
+}
+
+bool IsRecordTag(dwarf::Tag tag) {
+  return tag == dwarf::DW_TAG_structure_type || tag == dwarf::DW_TAG_class_type ||
+         tag == dwarf::DW_TAG_union_type;
+}
+
+/// Skips typedefs (member types are canonical types, like in the Clang backend).
+DWARFDie StripTypedefs(DWARFDie type) {
+  for (int i = 0; type && type.getTag() == dwarf::DW_TAG_typedef && i < 64; ++i)
+    type = type.getAttributeValueAsReferencedDie(dwarf::DW_AT_type);
+  return type;
+}
+
+/// Skips typedefs and cv-qualifiers.
+DWARFDie StripQualifiers(DWARFDie type) {
+  for (int i = 0; type && i < 64; ++i) {
+    switch (type.getTag()) {
+    case dwarf::DW_TAG_typedef:
+    case dwarf::DW_TAG_const_type:
+    case dwarf::DW_TAG_volatile_type:
+    case dwarf::DW_TAG_restrict_type:
+    case dwarf::DW_TAG_atomic_type:
+      type = type.getAttributeValueAsReferencedDie(dwarf::DW_AT_type);
+      break;
+    default:
+      return type;
+    }
+  }
+  return type;
+}
+
+DWARFDie GetType(const DWARFDie& die) {
+  return StripTypedefs(die.getAttributeValueAsReferencedDie(dwarf::DW_AT_type));
+}
+
+/// Returns the element counts of an array type (outermost dimension first).
+llvm::SmallVector<std::uint64_t, 2> GetArrayDimensions(const DWARFDie& array) {
+  llvm::SmallVector<std::uint64_t, 2> dimensions;
+  for (const DWARFDie child : array.children()) {
+    if (child.getTag() != dwarf::DW_TAG_subrange_type)
+      continue;
+    if (const auto count = GetUnsigned(child, dwarf::DW_AT_count)) {
+      dimensions.push_back(*count);
+    } else if (const auto upper_bound = GetUnsigned(child, dwarf::DW_AT_upper_bound)) {
+      const std::uint64_t lower_bound = GetUnsigned(child, dwarf::DW_AT_lower_bound).value_or(0);
+      dimensions.push_back(*upper_bound + 1 - lower_bound);
+    } else {
+      // Flexible array member.
+      dimensions.push_back(0);
+    }
+  }
+  return dimensions;
+}
+
+bool IsVTablePointer(const DWARFDie& member) {
+  // GCC names vtable pointers _vptr.Class and Clang uses _vptr$Class.
+  const llvm::StringRef name = member.getShortName() ? member.getShortName() : "";
+  return GetFlag(member, dwarf::DW_AT_artificial) && name.startswith("_vptr");
+}
+
+class DwarfParser {
+public:
+  explicit DwarfParser(ParseResult& result) : m_result(result) {}
+
+  void ParseUnit(llvm::DWARFUnit& unit) {
+    m_pointer_size = unit.getAddressByteSize();
+    Walk(unit.getUnitDIE(false));
+  }
+
+  /// Must be called after all units of an object file have been parsed, while its DIEs
+  /// are still valid.
+  void ResolveDeferredRecords() {
+    const auto handle = [&](const std::vector<DWARFDie>& dies) {
+      for (const DWARFDie& die : dies) {
+        const auto it = m_records.find(GetQualifiedName(die));
+        if (it != m_records.end() && it->second == InProgress)
+          m_records.erase(it);
+        HandleRecord(die);
+      }
+    };
+
+    // Resolving a record can make it possible to resolve other deferred records.
+    while (!m_deferred.empty()) {
+      const std::vector<DWARFDie> deferred = std::exchange(m_deferred, {});
+      handle(deferred);
+      if (m_deferred.size() == deferred.size()) {
+        // No progress: the missing bases are not defined in this object file.
+        m_allow_unresolved_bases = true;
+        handle(std::exchange(m_deferred, {}));
+        m_allow_unresolved_bases = false;
+      }
+    }
+  }
+
+  void Reset() {
+    // DIE offsets are only unique within one object file.
+    m_alignments.clear();
+  }
+
+private:
+  static constexpr std::size_t InProgress = std::numeric_limits<std::size_t>::max();
+
+  void Walk(const DWARFDie& die) {
+    for (const DWARFDie child : die.children()) {
+      const dwarf::Tag tag = child.getTag();
+      if (tag == dwarf::DW_TAG_namespace) {
+        Walk(child);
+      } else if (IsRecordTag(tag)) {
+        if (IsDefinition(child))
+          HandleRecord(child);
+        // Nested types.
+        Walk(child);
+      } else if (tag == dwarf::DW_TAG_enumeration_type) {
+        if (IsDefinition(child))
+          HandleEnum(child);
+      }
+    }
+  }
+
+  static bool IsDefinition(const DWARFDie& die) {
+    return !GetFlag(die, dwarf::DW_AT_declaration) && die.find(dwarf::DW_AT_byte_size);
+  }
+
+  // Names.
+
+  std::string GetQualifiedName(const DWARFDie& die) {
+    std::string name = GetUnqualifiedName(die);
+
+    for (DWARFDie parent = die.getParent(); parent; parent = parent.getParent()) {
+      const dwarf::Tag tag = parent.getTag();
+      if (tag == dwarf::DW_TAG_namespace) {
+        const char* parent_name = parent.getShortName();
+        name = fmt::format("{}::{}", parent_name ? parent_name : "(anonymous namespace)", name);
+      } else if (IsRecordTag(tag) || tag == dwarf::DW_TAG_enumeration_type) {
+        return GetQualifiedName(parent) + "::" + name;
+      } else {
+        break;
+      }
+    }
+
+    return name;
+  }
+
+  static std::string GetUnqualifiedName(const DWARFDie& die) {
+    if (const char* name = die.getShortName())
+      return name;
+
+    // Same format as Clang.
+    const char* kind = "struct";
+    switch (die.getTag()) {
+    case dwarf::DW_TAG_class_type:
+      kind = "class";
+      break;
+    case dwarf::DW_TAG_union_type:
+      kind = "union";
+      break;
+    case dwarf::DW_TAG_enumeration_type:
+      kind = "enum";
+      break;
+    default:
+      break;
+    }
+    return fmt::format("(anonymous {} at {}:{}:{})", kind,
+                       die.getDeclFile(llvm::DILineInfoSpecifier::FileLineInfoKind::RawValue),
+                       die.getDeclLine(), GetUnsigned(die, dwarf::DW_AT_decl_column).value_or(0));
+  }
+
+  /// Returns a type name in the same format as Clang's canonical type names.
+  std::string GetTypeName(DWARFDie type) {
+    type = StripTypedefs(type);
+    if (!type)
+      return "void";
+
+    const auto append_declarator = [](std::string name, llvm::StringRef declarator) {
+      if (!name.empty() && (name.back() == '*' || name.back() == '&'))
+        return name + declarator.str();
+      return name + " " + declarator.str();
+    };
+
+    switch (type.getTag()) {
+    case dwarf::DW_TAG_base_type:
+      return type.getShortName() ? type.getShortName() : "";
+    case dwarf::DW_TAG_unspecified_type:
+      return "std::nullptr_t";
+    case dwarf::DW_TAG_structure_type:
+    case dwarf::DW_TAG_class_type:
+    case dwarf::DW_TAG_union_type:
+    case dwarf::DW_TAG_enumeration_type:
+      return GetQualifiedName(type);
+    case dwarf::DW_TAG_const_type:
+    case dwarf::DW_TAG_volatile_type: {
+      const char* qualifier = type.getTag() == dwarf::DW_TAG_const_type ? "const" : "volatile";
+      const DWARFDie inner = GetType(type);
+      if (inner && inner.getTag() == dwarf::DW_TAG_pointer_type)
+        return append_declarator(GetTypeName(inner), qualifier);
+      return fmt::format("{} {}", qualifier, GetTypeName(inner));
+    }
+    case dwarf::DW_TAG_pointer_type:
+    case dwarf::DW_TAG_reference_type:
+    case dwarf::DW_TAG_rvalue_reference_type: {
+      const char* declarator = type.getTag() == dwarf::DW_TAG_pointer_type     ? "*"
+                               : type.getTag() == dwarf::DW_TAG_reference_type ? "&"
+                                                                               : "&&";
+      const DWARFDie pointee = GetType(type);
+      if (pointee && pointee.getTag() == dwarf::DW_TAG_subroutine_type)
+        return fmt::format("{} ({})({})", GetTypeName(GetType(pointee)), declarator,
+                           llvm::join(GetParamTypeNames(pointee), ", "));
+      return append_declarator(GetTypeName(pointee), declarator);
+    }
+    case dwarf::DW_TAG_ptr_to_member_type: {
+      const DWARFDie class_type =
+          StripTypedefs(type.getAttributeValueAsReferencedDie(dwarf::DW_AT_containing_type));
+      return fmt::format("{} {}::*", GetTypeName(GetType(type)), GetTypeName(class_type));
+    }
+    case dwarf::DW_TAG_array_type: {
+      std::string name = GetTypeName(GetType(type)) + " ";
+      for (const std::uint64_t count : GetArrayDimensions(type))
+        name += fmt::format("[{}]", count);
+      return name;
+    }
+    case dwarf::DW_TAG_subroutine_type:
+      return fmt::format("{} ({})", GetTypeName(GetType(type)),
+                         llvm::join(GetParamTypeNames(type), ", "));
+    case dwarf::DW_TAG_atomic_type:
+      return fmt::format("_Atomic({})", GetTypeName(GetType(type)));
+    default:
+      return type.getShortName() ? type.getShortName() : "";
+    }
+  }
+
+  std::vector<std::string> GetParamTypeNames(const DWARFDie& function) {
+    std::vector<std::string> names;
+    for (const DWARFDie child : function.children()) {
+      if (child.getTag() == dwarf::DW_TAG_formal_parameter &&
+          !GetFlag(child, dwarf::DW_AT_artificial)) {
+        names.push_back(GetTypeName(GetType(child)));
+      } else if (child.getTag() == dwarf::DW_TAG_unspecified_parameters) {
+        names.emplace_back("...");
+      }
+    }
+    return names;
+  }
+
+  std::unique_ptr<ComplexType> TranslateToComplexType(DWARFDie type) {
+    type = StripTypedefs(type);
+    if (!type)
+      return std::make_unique<ComplexTypeName>("void", false, false);
+
+    switch (type.getTag()) {
+    case dwarf::DW_TAG_array_type: {
+      const auto dimensions = GetArrayDimensions(type);
+      auto result = TranslateToComplexType(GetType(type));
+      for (const std::uint64_t count : llvm::reverse(dimensions))
+        result = std::make_unique<ComplexTypeArray>(std::move(result), count);
+      return result;
+    }
+    case dwarf::DW_TAG_ptr_to_member_type:
+      return std::make_unique<ComplexTypeMemberPointer>(
+          TranslateToComplexType(
+              type.getAttributeValueAsReferencedDie(dwarf::DW_AT_containing_type)),
+          TranslateToComplexType(GetType(type)), GetTypeName(type));
+    case dwarf::DW_TAG_pointer_type:
+    case dwarf::DW_TAG_reference_type:
+    case dwarf::DW_TAG_rvalue_reference_type:
+      return std::make_unique<ComplexTypePointer>(TranslateToComplexType(GetType(type)));
+    case dwarf::DW_TAG_subroutine_type:
+      return TranslateFunctionType(type);
+    case dwarf::DW_TAG_atomic_type:
+      return std::make_unique<ComplexTypeAtomic>(TranslateToComplexType(GetType(type)));
+    default:
+      break;
+    }
+
+    bool is_const = false;
+    bool is_volatile = false;
+    while (type && (type.getTag() == dwarf::DW_TAG_const_type ||
+                    type.getTag() == dwarf::DW_TAG_volatile_type)) {
+      is_const |= type.getTag() == dwarf::DW_TAG_const_type;
+      is_volatile |= type.getTag() == dwarf::DW_TAG_volatile_type;
+      type = GetType(type);
+    }
+
+    // Qualified pointers and arrays.
+    if (type && type.getTag() != dwarf::DW_TAG_base_type && !IsRecordTag(type.getTag()) &&
+        type.getTag() != dwarf::DW_TAG_enumeration_type) {
+      return TranslateToComplexType(type);
+    }
+
+    return std::make_unique<ComplexTypeName>(GetTypeName(type), is_const, is_volatile);
+  }
+
+  std::unique_ptr<ComplexType> TranslateFunctionType(const DWARFDie& function) {
+    std::vector<std::unique_ptr<ComplexType>> params;
+    for (const DWARFDie child : function.children()) {
+      if (child.getTag() == dwarf::DW_TAG_formal_parameter &&
+          !GetFlag(child, dwarf::DW_AT_artificial)) {
+        params.emplace_back(TranslateToComplexType(GetType(child)));
+      }
+    }
+    return std::make_unique<ComplexTypeFunction>(std::move(params),
+                                                 TranslateToComplexType(GetType(function)));
+  }
+
+  // Sizes.
+
+  std::uint64_t GetTypeSize(DWARFDie type, int depth = 0) {
+    type = StripQualifiers(type);
+    if (!type || depth > 64)
+      return 0;
+
+    if (const auto size = GetUnsigned(type, dwarf::DW_AT_byte_size))
+      return *size;
+
+    switch (type.getTag()) {
+    case dwarf::DW_TAG_pointer_type:
+    case dwarf::DW_TAG_reference_type:
+    case dwarf::DW_TAG_rvalue_reference_type:
+      return m_pointer_size;
+    case dwarf::DW_TAG_ptr_to_member_type: {
+      const DWARFDie pointee = StripQualifiers(GetType(type));
+      const bool is_function = pointee && pointee.getTag() == dwarf::DW_TAG_subroutine_type;
+      return is_function ? 2 * m_pointer_size : m_pointer_size;
+    }
+    case dwarf::DW_TAG_array_type: {
+      std::uint64_t size = GetTypeSize(GetType(type), depth + 1);
+      for (const std::uint64_t count : GetArrayDimensions(type))
+        size *= count;
+      return size;
+    }
+    case dwarf::DW_TAG_enumeration_type:
+      return GetTypeSize(GetType(type), depth + 1);
+    default:
+      return 0;
+    }
+  }
+
+  std::uint64_t GetTypeAlignment(DWARFDie type, int depth = 0) {
+    type = StripQualifiers(type);
+    if (!type || depth > 64)
+      return 1;
+
+    if (const auto alignment = GetUnsigned(type, dwarf::DW_AT_alignment))
+      return *alignment;
+
+    const auto it = m_alignments.find(type.getOffset());
+    if (it != m_alignments.end())
+      return it->second;
+
+    std::uint64_t alignment = 1;
+    switch (type.getTag()) {
+    case dwarf::DW_TAG_array_type:
+      alignment = GetTypeAlignment(GetType(type), depth + 1);
+      break;
+    case dwarf::DW_TAG_enumeration_type:
+      alignment = type.find(dwarf::DW_AT_type) ? GetTypeAlignment(GetType(type), depth + 1)
+                                               : GetTypeSize(type);
+      break;
+    case dwarf::DW_TAG_structure_type:
+    case dwarf::DW_TAG_class_type:
+    case dwarf::DW_TAG_union_type:
+      for (const DWARFDie child : type.children()) {
+        if (child.getTag() == dwarf::DW_TAG_member && !GetFlag(child, dwarf::DW_AT_declaration))
+          alignment = std::max(alignment, GetMemberAlignment(child, depth + 1));
+        else if (child.getTag() == dwarf::DW_TAG_inheritance)
+          alignment = std::max(alignment, GetTypeAlignment(GetType(child), depth + 1));
+      }
+      break;
+    default:
+      // Scalars are naturally aligned.
+      alignment = llvm::PowerOf2Ceil(std::max<std::uint64_t>(GetTypeSize(type), 1));
+      break;
+    }
+
+    m_alignments[type.getOffset()] = alignment;
+    return alignment;
+  }
+
+  std::uint64_t GetMemberAlignment(const DWARFDie& member, int depth = 0) {
+    if (const auto alignment = GetUnsigned(member, dwarf::DW_AT_alignment))
+      return *alignment;
+    return GetTypeAlignment(GetType(member), depth);
+  }
+
+  // Enums.
+
+  void HandleEnum(const DWARFDie& die) {
+    std::string name = GetQualifiedName(die);
+    if (!m_enums.insert(name).second)
+      return;
+
+    const DWARFDie underlying_type = StripQualifiers(GetType(die));
+    const std::uint64_t size = GetTypeSize(die);
+
+    Enum& enum_def = m_result.enums.emplace_back();
+    enum_def.is_scoped = GetFlag(die, dwarf::DW_AT_enum_class);
+    enum_def.is_anonymous = die.getShortName() == nullptr;
+    enum_def.name = std::move(name);
+    enum_def.underlying_type_size = static_cast<std::uint8_t>(size);
+
+    bool is_signed = false;
+    if (underlying_type) {
+      enum_def.underlying_type_name = GetTypeName(underlying_type);
+      const auto encoding = GetUnsigned(underlying_type, dwarf::DW_AT_encoding);
+      is_signed = encoding == dwarf::DW_ATE_signed || encoding == dwarf::DW_ATE_signed_char;
+    } else {
+      // Older producers do not record the underlying type.
+      enum_def.underlying_type_name = "unsigned int";
+    }
+
+    for (const DWARFDie child : die.children()) {
+      if (child.getTag() != dwarf::DW_TAG_enumerator)
+        continue;
+
+      Enum::Enumerator& entry = enum_def.enumerators.emplace_back();
+      entry.identifier = child.getShortName() ? child.getShortName() : "";
+
+      const auto value = child.find(dwarf::DW_AT_const_value);
+      if (!value)
+        continue;
+      if (is_signed || value->getForm() == dwarf::DW_FORM_sdata)
+        entry.value = std::to_string(value->getAsSignedConstant().getValueOr(0));
+      else
+        entry.value = std::to_string(value->getAsUnsignedConstant().getValueOr(0));
+    }
+  }
+
+  // Records.
+
+  /// Returns the index of the record in ParseResult::records, or InProgress if the record
+  /// is being processed or could not be processed.
+  std::size_t HandleRecord(const DWARFDie& die) {
+    std::string name = GetQualifiedName(die);
+    const auto [it, inserted] = m_records.try_emplace(name, InProgress);
+    if (!inserted)
+      return it->second;
+
+    Record record;
+    record.is_anonymous = die.getShortName() == nullptr;
+    record.kind = die.getTag() == dwarf::DW_TAG_class_type   ? Record::Kind::Class
+                  : die.getTag() == dwarf::DW_TAG_union_type ? Record::Kind::Union
+                                                             : Record::Kind::Struct;
+    record.name = name;
+    record.size = GetTypeSize(die);
+    record.alignment = GetTypeAlignment(die);
+    record.source_file =
+        die.getDeclFile(llvm::DILineInfoSpecifier::FileLineInfoKind::AbsoluteFilePath);
+
+    // Bases must be processed first (for the data size and the vtable).
+    struct BaseInfo {
+      std::size_t offset;
+      std::size_t record_idx;
+    };
+    llvm::SmallVector<BaseInfo, 4> bases;
+    bool has_vtable_pointer = false;
+    bool has_unresolved_base = false;
+
+    for (const DWARFDie child : die.children()) {
+      if (child.getTag() == dwarf::DW_TAG_inheritance) {
+        // Virtual base offsets are not constants.
+        const auto offset = GetConstantLocation(child, dwarf::DW_AT_data_member_location);
+        if (GetUnsigned(child, dwarf::DW_AT_virtuality).value_or(0) != 0 || !offset)
+          continue;
+        const std::size_t base_idx = ResolveBase(StripQualifiers(GetType(child)));
+        has_unresolved_base |= base_idx == InProgress;
+        bases.push_back({*offset, base_idx});
+        continue;
+      }
+
+      if (child.getTag() == dwarf::DW_TAG_member && IsVTablePointer(child))
+        has_vtable_pointer = true;
+    }
+
+    // With limited debug info, dynamic classes are only defined in the unit that contains
+    // their key function. Try again once all units have been seen.
+    if (has_unresolved_base && !m_allow_unresolved_bases) {
+      m_deferred.push_back(die);
+      return InProgress;
+    }
+
+    const auto get_base_vtable = [&](const BaseInfo& base) -> const VTable* {
+      if (base.record_idx == InProgress)
+        return nullptr;
+      return m_result.records[base.record_idx].vtable.get();
+    };
+
+    std::optional<std::size_t> primary_base;
+    if (!has_vtable_pointer) {
+      for (std::size_t i = 0; i < bases.size(); ++i) {
+        if (bases[i].offset == 0 && get_base_vtable(bases[i])) {
+          primary_base = i;
+          break;
+        }
+      }
+    }
+
+    std::size_t base_idx = 0;
+    for (const DWARFDie child : die.children()) {
+      if (child.getTag() == dwarf::DW_TAG_inheritance) {
+        const auto offset = GetConstantLocation(child, dwarf::DW_AT_data_member_location);
+        if (GetUnsigned(child, dwarf::DW_AT_virtuality).value_or(0) != 0 || !offset)
+          continue;
+        Field& field = record.fields.emplace_back();
+        field.offset = *offset;
+        field.data = Field::Base{
+            .is_primary = primary_base == base_idx++,
+            .is_virtual = false,
+            .type_name = GetTypeName(GetType(child)),
+        };
+        continue;
+      }
+
+      if (child.getTag() != dwarf::DW_TAG_member || GetFlag(child, dwarf::DW_AT_declaration) ||
+          GetFlag(child, dwarf::DW_AT_external)) {
+        continue;
+      }
+
+      const std::uint64_t location =
+          GetConstantLocation(child, dwarf::DW_AT_data_member_location).value_or(0);
+
+      if (IsVTablePointer(child)) {
+        Field& field = record.fields.emplace_back();
+        field.offset = location;
+        field.data = Field::VTablePointer();
+        continue;
+      }
+
+      const DWARFDie type = GetType(child);
+      Field::MemberVariable member{
+          .size = GetTypeSize(type),
+          .alignment = GetMemberAlignment(child),
+          .type = TranslateToComplexType(type),
+          .type_name = GetTypeName(type),
+          .name = child.getShortName() ? child.getShortName() : "",
+      };
+
+      std::uint64_t offset = location;
+      if (const auto bit_size = GetUnsigned(child, dwarf::DW_AT_bit_size)) {
+        std::uint64_t bit_offset = 0;
+        if (const auto data_bit_offset = GetUnsigned(child, dwarf::DW_AT_data_bit_offset)) {
+          bit_offset = *data_bit_offset;
+        } else {
+          // DWARF 2/3: DW_AT_bit_offset counts from the most significant bit of the storage unit.
+          // Only little-endian targets are supported.
+          const std::uint64_t storage_size =
+              GetUnsigned(child, dwarf::DW_AT_byte_size).value_or(member.size);
+          const std::uint64_t msb_offset = GetUnsigned(child, dwarf::DW_AT_bit_offset).value_or(0);
+          bit_offset = location * 8 + storage_size * 8 - msb_offset - *bit_size;
+        }
+        offset = bit_offset / 8;
+        member.bitfield_width = static_cast<unsigned int>(*bit_size);
+        member.bitfield_offset = static_cast<unsigned int>(bit_offset % 8);
+      }
+
+      Field& field = record.fields.emplace_back();
+      field.offset = offset;
+      field.data = std::move(member);
+    }
+
+    llvm::stable_sort(record.fields,
+                      [](const Field& lhs, const Field& rhs) { return lhs.offset < rhs.offset; });
+
+    // Only the first dynamic base can be at offset 0 without a vtable pointer in front of it,
+    // so an unresolved base at offset 0 might be a primary base.
+    const bool might_have_primary_base =
+        !has_vtable_pointer && !primary_base && llvm::any_of(bases, [](const BaseInfo& base) {
+          return base.offset == 0 && base.record_idx == InProgress;
+        });
+
+    record.data_size = ComputeDataSize(record);
+    record.vtable = BuildVTable(die, record.name, has_vtable_pointer || might_have_primary_base,
+                                bases, primary_base, get_base_vtable);
+    if (record.vtable) {
+      record.vtable->is_incomplete =
+          has_unresolved_base || llvm::any_of(bases, [&](const BaseInfo& base) {
+            const VTable* base_vtable = get_base_vtable(base);
+            return base_vtable && base_vtable->is_incomplete;
+          });
+    }
+
+    const std::size_t record_idx = m_result.records.size();
+    m_result.records.emplace_back(std::move(record));
+    // The iterator might have been invalidated by nested calls.
+    m_records[name] = record_idx;
+    return record_idx;
+  }
+
+  /// Returns the index of a base record, or InProgress if it is not defined yet.
+  std::size_t ResolveBase(const DWARFDie& base) {
+    if (!base)
+      return InProgress;
+    if (IsDefinition(base))
+      return HandleRecord(base);
+    const auto it = m_records.find(GetQualifiedName(base));
+    return it != m_records.end() ? it->second : InProgress;
+  }
+
+  std::size_t ComputeDataSize(const Record& record) const {
+    std::size_t data_size = 0;
+    for (const Field& field : record.fields) {
+      std::size_t end = field.offset;
+      if (const auto* member = std::get_if<Field::MemberVariable>(&field.data)) {
+        end += member->bitfield_width == 0
+                   ? member->size
+                   : llvm::divideCeil(member->bitfield_offset + member->bitfield_width, 8);
+      } else if (std::holds_alternative<Field::VTablePointer>(field.data)) {
+        end += m_pointer_size;
+      } else if (const auto* base = std::get_if<Field::Base>(&field.data)) {
+        const auto it = m_records.find(base->type_name);
+        if (it != m_records.end() && it->second != InProgress)
+          end += m_result.records[it->second].data_size;
+      }
+      data_size = std::max(data_size, end);
+    }
+    return data_size;
+  }
+
+  VTableComponent::FunctionPointer MakeFunctionPointer(const DWARFDie& function,
+                                                       const std::string& class_name) {
+    VTableComponent::FunctionPointer entry;
+    const std::string name = function.getShortName() ? function.getShortName() : "";
+    const bool is_dtor = llvm::StringRef(name).startswith("~");
+
+    for (const DWARFDie child : function.children()) {
+      if (child.getTag() != dwarf::DW_TAG_formal_parameter ||
+          !GetFlag(child, dwarf::DW_AT_artificial)) {
+        continue;
+      }
+      // The implicit object parameter is a pointer to a const object for const functions.
+      const DWARFDie pointee = GetType(GetType(child));
+      entry.is_const = pointee && pointee.getTag() == dwarf::DW_TAG_const_type;
+      break;
+    }
+
+    if (is_dtor) {
+      entry.repr = fmt::format("{}::{}()", class_name, name);
+    } else {
+      entry.repr = fmt::format("{} {}::{}({}){}", GetTypeName(GetType(function)), class_name,
+                               name, llvm::join(GetParamTypeNames(function), ", "),
+                               entry.is_const ? " const" : "");
+      entry.function_name = name;
+    }
+
+    if (GetUnsigned(function, dwarf::DW_AT_virtuality) == dwarf::DW_VIRTUALITY_pure_virtual)
+      entry.repr += " [pure]";
+
+    entry.type = TranslateFunctionType(function);
+    return entry;
+  }
+
+  /// Returns the vtable group of a base (from the offset-to-top entry to the next group).
+  static llvm::ArrayRef<VTableComponent> GetFirstVTableGroup(const VTable& vtable) {
+    llvm::ArrayRef<VTableComponent> components = vtable.components;
+    const auto is_offset_to_top = [](const VTableComponent& component) {
+      return std::holds_alternative<VTableComponent::OffsetToTop>(component.data);
+    };
+    const auto begin = llvm::find_if(components, is_offset_to_top);
+    if (begin == components.end())
+      return {};
+    const auto end = std::find_if(begin + 1, components.end(), [](const VTableComponent& c) {
+      return !std::holds_alternative<VTableComponent::RTTI>(c.data) &&
+             !std::holds_alternative<VTableComponent::FunctionPointer>(c.data) &&
+             !std::holds_alternative<VTableComponent::CompleteDtorPointer>(c.data) &&
+             !std::holds_alternative<VTableComponent::DeletingDtorPointer>(c.data);
+    });
+    return components.slice(begin - components.begin(), end - begin);
+  }
+
+  static VTableComponent CopyComponent(const VTableComponent& component) {
+    return std::visit(
+        [](const auto& data) -> VTableComponent {
+          using T = std::decay_t<decltype(data)>;
+          if constexpr (std::is_base_of_v<VTableComponent::FunctionPointer, T>) {
+            T copy;
+            static_cast<VTableComponent::FunctionPointer&>(copy) = CopyFunctionPointer(data);
+            return VTableComponent{std::move(copy)};
+          } else {
+            return VTableComponent{data};
+          }
+        },
+        component.data);
+  }
+
+  static VTableComponent::FunctionPointer
+  CopyFunctionPointer(const VTableComponent::FunctionPointer& function) {
+    VTableComponent::FunctionPointer copy;
+    copy.is_thunk = function.is_thunk;
+    copy.is_const = function.is_const;
+    copy.return_adjustment = function.return_adjustment;
+    copy.return_adjustment_vbase_offset_offset = function.return_adjustment_vbase_offset_offset;
+    copy.this_adjustment = function.this_adjustment;
+    copy.this_adjustment_vcall_offset_offset = function.this_adjustment_vcall_offset_offset;
+    copy.repr = function.repr;
+    copy.function_name = function.function_name;
+    copy.type = function.type ? CloneComplexType(*function.type) : nullptr;
+    return copy;
+  }
+
+  static std::unique_ptr<ComplexType> CloneComplexType(const ComplexType& type) {
+    switch (type.GetKind()) {
+    case ComplexType::Kind::TypeName: {
+      const auto& name = static_cast<const ComplexTypeName&>(type);
+      return std::make_unique<ComplexTypeName>(name.name, name.is_const, name.is_volatile);
+    }
+    case ComplexType::Kind::Pointer:
+      return std::make_unique<ComplexTypePointer>(
+          CloneComplexType(*static_cast<const ComplexTypePointer&>(type).pointee_type));
+    case ComplexType::Kind::Array: {
+      const auto& array = static_cast<const ComplexTypeArray&>(type);
+      return std::make_unique<ComplexTypeArray>(CloneComplexType(*array.element_type),
+                                                array.size);
+    }
+    case ComplexType::Kind::Function: {
+      const auto& function = static_cast<const ComplexTypeFunction&>(type);
+      std::vector<std::unique_ptr<ComplexType>> params;
+      for (const auto& param : function.param_types)
+        params.emplace_back(CloneComplexType(*param));
+      return std::make_unique<ComplexTypeFunction>(std::move(params),
+                                                   CloneComplexType(*function.return_type));
+    }
+    case ComplexType::Kind::MemberPointer: {
+      const auto& ptr = static_cast<const ComplexTypeMemberPointer&>(type);
+      return std::make_unique<ComplexTypeMemberPointer>(
+          CloneComplexType(*ptr.class_type), CloneComplexType(*ptr.pointee_type), ptr.repr);
+    }
+    case ComplexType::Kind::Atomic:
+      return std::make_unique<ComplexTypeAtomic>(
+          CloneComplexType(*static_cast<const ComplexTypeAtomic&>(type).value_type));
+    }
+    return nullptr;
+  }
+
+  static VTableComponent MakePlaceholder() {
+    VTableComponent::FunctionPointer placeholder;
+    placeholder.repr = "(unknown)";
+    placeholder.type = std::make_unique<ComplexTypeFunction>(
+        std::vector<std::unique_ptr<ComplexType>>{},
+        std::make_unique<ComplexTypeName>("void", false, false));
+    return VTableComponent{std::move(placeholder)};
+  }
+
+  static const VTableComponent::FunctionPointer* AsFunctionPointer(const VTableComponent& c) {
+    return std::visit(
+        [](const auto& data) -> const VTableComponent::FunctionPointer* {
+          using T = std::decay_t<decltype(data)>;
+          if constexpr (std::is_base_of_v<VTableComponent::FunctionPointer, T>)
+            return &data;
+          else
+            return nullptr;
+        },
+        c.data);
+  }
+
+  template <typename Bases, typename GetBaseVTable>
+  std::unique_ptr<VTable> BuildVTable(const DWARFDie& die, const std::string& class_name,
+                                      bool has_vtable_pointer, const Bases& bases,
+                                      std::optional<std::size_t> primary_base,
+                                      GetBaseVTable get_base_vtable) {
+    const bool has_secondary_vtables = llvm::any_of(bases, get_base_vtable);
+    if (!has_vtable_pointer && !has_secondary_vtables)
+      return nullptr;
+
+    // Virtual member functions declared in this record, by vtable slot.
+    struct VirtualFunction {
+      std::uint64_t slot;
+      DWARFDie die;
+    };
+    llvm::SmallVector<VirtualFunction, 8> functions;
+    // GCC does not emit a vtable slot for virtual destructors.
+    DWARFDie dtor_without_slot;
+    for (const DWARFDie child : die.children()) {
+      if (child.getTag() != dwarf::DW_TAG_subprogram)
+        continue;
+      if (const auto slot = GetConstantLocation(child, dwarf::DW_AT_vtable_elem_location)) {
+        functions.push_back({*slot, child});
+      } else if (GetUnsigned(child, dwarf::DW_AT_virtuality).value_or(0) != 0 &&
+                 child.getShortName() && llvm::StringRef(child.getShortName()).startswith("~")) {
+        dtor_without_slot = child;
+      }
+    }
+
+    auto vtable = std::make_unique<VTable>();
+
+    // Primary vtable: the primary base's functions, followed by new virtual functions.
+    std::vector<VTableComponent> primary;
+    primary.emplace_back(VTableComponent::OffsetToTop{0});
+    primary.emplace_back(VTableComponent::RTTI{class_name});
+    if (primary_base) {
+      const auto group = GetFirstVTableGroup(*get_base_vtable(bases[*primary_base]));
+      for (const VTableComponent& component : group.drop_front(2))
+        primary.emplace_back(CopyComponent(component));
+    }
+
+    const auto set_dtor = [&](std::size_t idx, VTableComponent::FunctionPointer entry) {
+      VTableComponent::FunctionPointer deleting = CopyFunctionPointer(entry);
+      entry.repr += " [complete]";
+      deleting.repr += " [deleting]";
+      primary[idx] = VTableComponent{VTableComponent::CompleteDtorPointer{std::move(entry)}};
+      primary[idx + 1] = VTableComponent{VTableComponent::DeletingDtorPointer{std::move(deleting)}};
+    };
+
+    for (const VirtualFunction& function : functions) {
+      VTableComponent::FunctionPointer entry = MakeFunctionPointer(function.die, class_name);
+      const std::size_t idx = 2 + function.slot;
+      const bool is_dtor = entry.function_name.empty();
+      // Slots of functions that are not declared in this record should have been filled
+      // by the primary base. If they were not, leave placeholders.
+      while (primary.size() < idx + (is_dtor ? 2 : 1))
+        primary.emplace_back(MakePlaceholder());
+
+      if (is_dtor)
+        set_dtor(idx, std::move(entry));
+      else
+        primary[idx] = VTableComponent{std::move(entry)};
+    }
+
+    if (dtor_without_slot) {
+      // Overrides the inherited destructor if there is one. Otherwise, the destructor takes
+      // the first two slots that are not accounted for, or is appended.
+      std::size_t idx = 2;
+      const auto is_unknown = [&](std::size_t i) {
+        const auto* function = AsFunctionPointer(primary[i]);
+        return function && function->repr == "(unknown)";
+      };
+      const auto is_dtor = [&](std::size_t i) {
+        return std::holds_alternative<VTableComponent::CompleteDtorPointer>(primary[i].data);
+      };
+      while (idx + 1 < primary.size() && !is_dtor(idx) && !(is_unknown(idx) && is_unknown(idx + 1)))
+        ++idx;
+      while (primary.size() < idx + 2)
+        primary.emplace_back(MakePlaceholder());
+      set_dtor(idx, MakeFunctionPointer(dtor_without_slot, class_name));
+    }
+    vtable->components = std::move(primary);
+
+    // Secondary vtables: overriders are reached through this-adjusting thunks.
+    for (std::size_t i = 0; i < bases.size(); ++i) {
+      const VTable* base_vtable = get_base_vtable(bases[i]);
+      if (!base_vtable || primary_base == i)
+        continue;
+
+      const auto offset = static_cast<std::int64_t>(bases[i].offset);
+      vtable->components.emplace_back(VTableComponent::OffsetToTop{-offset});
+      vtable->components.emplace_back(VTableComponent::RTTI{class_name});
+
+      for (const VTableComponent& component : GetFirstVTableGroup(*base_vtable).drop_front(2)) {
+        VTableComponent copy = CopyComponent(component);
+        const auto* base_function = AsFunctionPointer(component);
+        const auto overrider =
+            llvm::find_if(functions, [&](const VirtualFunction& function) {
+              return base_function && IsOverrider(function.die, *base_function);
+            });
+        if (overrider != functions.end()) {
+          VTableComponent::FunctionPointer entry = MakeFunctionPointer(overrider->die, class_name);
+          entry.is_thunk = true;
+          entry.this_adjustment = -offset;
+          entry.repr += fmt::format(" [this adjustment: {:#x}]", -offset);
+          if (std::holds_alternative<VTableComponent::FunctionPointer>(component.data)) {
+            copy = VTableComponent{std::move(entry)};
+          } else {
+            entry.repr += std::holds_alternative<VTableComponent::CompleteDtorPointer>(
+                              component.data)
+                              ? " [complete]"
+                              : " [deleting]";
+            if (std::holds_alternative<VTableComponent::CompleteDtorPointer>(component.data))
+              copy = VTableComponent{VTableComponent::CompleteDtorPointer{std::move(entry)}};
+            else
+              copy = VTableComponent{VTableComponent::DeletingDtorPointer{std::move(entry)}};
+          }
+        }
+        vtable->components.emplace_back(std::move(copy));
+      }
+    }
+
+    return vtable;
+  }
+
+  bool IsOverrider(const DWARFDie& function, const VTableComponent::FunctionPointer& base) {
+    const std::string name = function.getShortName() ? function.getShortName() : "";
+    if (llvm::StringRef(name).startswith("~"))
+      return base.function_name.empty();
+    if (name != base.function_name)
+      return false;
+
+    // Compare parameter types (the part of the repr that follows the function name).
+    const std::string params = llvm::join(GetParamTypeNames(function), ", ");
+    return llvm::StringRef(base.repr).contains(fmt::format("::{}({})", name, params));
+  }
+
+  ParseResult& m_result;
+  std::uint8_t m_pointer_size = 8;
+  llvm::StringMap<std::size_t> m_records;
+  /// Records with bases that were not defined when the records were first seen.
+  std::vector<DWARFDie> m_deferred;
+  bool m_allow_unresolved_bases = false;
+  llvm::StringSet<> m_enums;
+  /// Alignments of type DIEs, by DIE offset.
+  llvm::DenseMap<std::uint64_t, std::uint64_t> m_alignments;
+};
+
+}  // namespace
+
+ParseResult ParseRecordsFromDwarf(std::span<const std::string> paths) {
+  ParseResult result;
+  DwarfParser parser{result};
+
+  for (const std::string& path : paths) {
+    auto binary = llvm::object::ObjectFile::createObjectFile(path);
+    if (!binary) {
+      return ParseResult::Fail(
+          fmt::format("failed to open {}: {}", path, llvm::toString(binary.takeError())));
+    }
+
+    // Malformed debug info is skipped.
+    const auto ignore_error = [](llvm::Error error) { llvm::consumeError(std::move(error)); };
+    const auto context = llvm::DWARFContext::create(
+        *binary->getBinary(), llvm::DWARFContext::ProcessDebugRelocations::Process, nullptr, "",
+        ignore_error, ignore_error);
+
+    parser.Reset();
+    for (const auto& unit : context->info_section_units())
+      parser.ParseUnit(*unit);
+    parser.ResolveDeferredRecords();
+  }
+
+  return result;
+}
+
+}  // namespace classgen
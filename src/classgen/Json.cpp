@@ -0,0 +1,849 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/Json.h"
+#include <iterator>
+#include <string_view>
+#include <utility>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include "classgen/ComplexType.h"
+
+namespace classgen {
+
+namespace {
+
+// must be called inside an object block
+void DumpComplexType(llvm::json::OStream& out, const ComplexType& type) {
+  const auto write_common = [&](llvm::StringRef kind) { out.attribute("kind", kind); };
+
+  switch (type.GetKind()) {
+  case ComplexType::Kind::TypeName: {
+    const auto& name = static_cast<const ComplexTypeName&>(type);
+    write_common("type_name");
+    out.attribute("name", name.name);
+    out.attribute("is_const", name.is_const);
+    out.attribute("is_volatile", name.is_volatile);
+    break;
+  }
+
+  case ComplexType::Kind::Pointer: {
+    const auto& ptr = static_cast<const ComplexTypePointer&>(type);
+    write_common("pointer");
+    out.attributeObject("pointee_type", [&] { DumpComplexType(out, *ptr.pointee_type); });
+    break;
+  }
+
+  case ComplexType::Kind::Array: {
+    const auto& array = static_cast<const ComplexTypeArray&>(type);
+    write_common("array");
+    out.attributeObject("element_type", [&] { DumpComplexType(out, *array.element_type); });
+    out.attribute("size", array.size);
+    break;
+  }
+
+  case ComplexType::Kind::Function: {
+    const auto& fn = static_cast<const ComplexTypeFunction&>(type);
+    write_common("function");
+
+    out.attributeArray("param_types", [&] {
+      for (const auto& param_type : fn.param_types)
+        out.object([&] { DumpComplexType(out, *param_type); });
+    });
+
+    out.attributeObject("return_type", [&] { DumpComplexType(out, *fn.return_type); });
+    break;
+  }
+
+  case ComplexType::Kind::MemberPointer: {
+    const auto& ptr = static_cast<const ComplexTypeMemberPointer&>(type);
+    write_common("member_pointer");
+    out.attributeObject("class_type", [&] { DumpComplexType(out, *ptr.class_type); });
+    out.attributeObject("pointee_type", [&] { DumpComplexType(out, *ptr.pointee_type); });
+    out.attribute("repr", ptr.repr);
+    break;
+  }
+
+  case ComplexType::Kind::Atomic: {
+    const auto& ptr = static_cast<const ComplexTypeAtomic&>(type);
+    write_common("atomic");
+    out.attributeObject("value_type", [&] { DumpComplexType(out, *ptr.value_type); });
+    break;
+  }
+  }
+}
+
+// must be called inside an object block
+void DumpEnum(llvm::json::OStream& out, const Enum& enum_def) {
+  out.attribute("is_scoped", enum_def.is_scoped);
+  out.attribute("is_anonymous", enum_def.is_anonymous);
+  out.attribute("name", enum_def.name);
+  out.attribute("underlying_type_name", enum_def.underlying_type_name);
+  out.attribute("underlying_type_size", enum_def.underlying_type_size);
+
+  out.attributeArray("enumerators", [&] {
+    for (const Enum::Enumerator& entry : enum_def.enumerators) {
+      out.object([&] {
+        out.attribute("identifier", entry.identifier);
+        out.attribute("value", entry.value);
+      });
+    }
+  });
+}
+
+// must be called inside an object block
+void DumpVTableFunction(llvm::json::OStream& out, const VTableComponent::FunctionPointer& func) {
+  out.attribute("is_thunk", func.is_thunk);
+  out.attribute("is_const", func.is_const);
+
+  if (func.is_thunk) {
+    out.attribute("return_adjustment", func.return_adjustment);
+    out.attribute("return_adjustment_vbase_offset_offset",
+                  func.return_adjustment_vbase_offset_offset);
+
+    out.attribute("this_adjustment", func.this_adjustment);
+    out.attribute("this_adjustment_vcall_offset_offset", func.this_adjustment_vcall_offset_offset);
+  }
+
+  out.attribute("repr", func.repr);
+  out.attribute("function_name", func.function_name);
+  out.attributeObject("type", [&] { DumpComplexType(out, *func.type); });
+}
+
+// must be called inside an object block
+void DumpRecord(llvm::json::OStream& out, const Record& record) {
+  out.attribute("is_anonymous", record.is_anonymous);
+  out.attribute("kind", int(record.kind));
+  out.attribute("name", record.name);
+  out.attribute("size", record.size);
+  out.attribute("data_size", record.data_size);
+  out.attribute("alignment", record.alignment);
+  out.attribute("source_file", record.source_file);
+
+  out.attributeArray("fields", [&] {
+    for (const Field& field : record.fields) {
+      // must be called inside an object block
+      const auto write_common = [&](llvm::StringRef kind) {
+        out.attribute("offset", field.offset);
+        out.attribute("kind", kind);
+      };
+
+      if (auto* member = std::get_if<Field::MemberVariable>(&field.data)) {
+        out.object([&] {
+          write_common("member");
+          if (member->bitfield_width != 0) {
+            out.attribute("bitfield_width", member->bitfield_width);
+            out.attribute("bitfield_offset", member->bitfield_offset);
+          }
+          out.attribute("size", member->size);
+          out.attribute("alignment", member->alignment);
+          out.attributeObject("type", [&] { DumpComplexType(out, *member->type); });
+          out.attribute("type_name", member->type_name);
+          out.attribute("name", member->name);
+        });
+        continue;
+      }
+
+      if (auto* base = std::get_if<Field::Base>(&field.data)) {
+        out.object([&] {
+          write_common("base");
+          out.attribute("is_primary", base->is_primary);
+          out.attribute("is_virtual", base->is_virtual);
+          out.attribute("type_name", base->type_name);
+        });
+        continue;
+      }
+
+      if (auto* vtable_ptr = std::get_if<Field::VTablePointer>(&field.data)) {
+        out.object([&] {
+          write_common("vtable_ptr");
+          // No other attributes.
+        });
+      }
+    }
+  });
+
+  if (record.vtable) {
+    out.attributeArray("vtable", [&] {
+      for (const VTableComponent& component : record.vtable->components) {
+        // must be called inside an object block
+        const auto write_common = [&](llvm::StringRef kind) { out.attribute("kind", kind); };
+
+        if (auto* vcallo = std::get_if<VTableComponent::VCallOffset>(&component.data)) {
+          out.object([&] {
+            write_common("vcall_offset");
+            out.attribute("offset", vcallo->offset);
+          });
+          continue;
+        }
+
+        if (auto* vbaseo = std::get_if<VTableComponent::VBaseOffset>(&component.data)) {
+          out.object([&] {
+            write_common("vbase_offset");
+            out.attribute("offset", vbaseo->offset);
+          });
+          continue;
+        }
+
+        if (auto* offset = std::get_if<VTableComponent::OffsetToTop>(&component.data)) {
+          out.object([&] {
+            write_common("offset_to_top");
+            out.attribute("offset", offset->offset);
+          });
+          continue;
+        }
+
+        if (auto* rtti = std::get_if<VTableComponent::RTTI>(&component.data)) {
+          out.object([&] {
+            write_common("rtti");
+            out.attribute("class_name", rtti->class_name);
+          });
+          continue;
+        }
+
+        if (auto* func = std::get_if<VTableComponent::FunctionPointer>(&component.data)) {
+          out.object([&] {
+            write_common("func");
+            DumpVTableFunction(out, *func);
+          });
+          continue;
+        }
+
+        if (auto* complete_dtor =
+                std::get_if<VTableComponent::CompleteDtorPointer>(&component.data)) {
+          out.object([&] {
+            write_common("complete_dtor");
+            DumpVTableFunction(out, *complete_dtor);
+          });
+          continue;
+        }
+
+        if (auto* deleting_dtor =
+                std::get_if<VTableComponent::DeletingDtorPointer>(&component.data)) {
+          out.object([&] {
+            write_common("deleting_dtor");
+            DumpVTableFunction(out, *deleting_dtor);
+          });
+          continue;
+        }
+      }
+    });
+    if (record.vtable->is_incomplete)
+      out.attribute("vtable_is_incomplete", true);
+  } else {
+    out.attribute("vtable", nullptr);
+  }
+}
+
+// must be called inside an object block
+void DumpVariant(llvm::json::OStream& out, const ParseVariantResult& variant) {
+  out.attribute("name", variant.name);
+
+  out.attributeArray("enums", [&] {
+    for (const Enum& enum_def : variant.enums)
+      out.object([&] { DumpEnum(out, enum_def); });
+  });
+
+  out.attributeArray("records", [&] {
+    for (const Record& record : variant.records)
+      out.object([&] { DumpRecord(out, record); });
+  });
+
+  out.attributeArray("missing_records", [&] {
+    for (const std::string& name : variant.missing_records)
+      out.value(name);
+  });
+}
+
+// must be called inside an object block
+void DumpLayoutConflict(llvm::json::OStream& out, const LayoutConflict& conflict) {
+  const auto write_layout = [&](llvm::StringRef key, const LayoutConflict::Layout& layout) {
+    out.attributeObject(key, [&] {
+      out.attribute("translation_unit", layout.translation_unit);
+      out.attribute("description", layout.description);
+    });
+  };
+
+  out.attribute("name", conflict.name);
+  write_layout("first", conflict.first);
+  write_layout("second", conflict.second);
+}
+
+constexpr std::pair<TranslationUnitStatus::Kind, std::string_view> TranslationUnitStatusNames[] = {
+    {TranslationUnitStatus::Kind::Ok, "ok"},
+    {TranslationUnitStatus::Kind::Failed, "failed"},
+    {TranslationUnitStatus::Kind::TimedOut, "timed_out"},
+    {TranslationUnitStatus::Kind::Crashed, "crashed"},
+    {TranslationUnitStatus::Kind::Cancelled, "cancelled"},
+};
+
+/// Whether a translation unit status is stored in the errors section of type dumps.
+bool ShouldDumpTranslationUnitStatus(const TranslationUnitStatus& status) {
+  return status.status != TranslationUnitStatus::Kind::Ok || status.num_attempts > 1;
+}
+
+// must be called inside an object block
+void DumpTranslationUnitStatus(llvm::json::OStream& out, const TranslationUnitStatus& status) {
+  out.attribute("file", status.file);
+  if (!status.variant.empty())
+    out.attribute("variant", status.variant);
+  for (const auto& [kind, name] : TranslationUnitStatusNames) {
+    if (kind == status.status)
+      out.attribute("status", llvm::StringRef(name.data(), name.size()));
+  }
+  out.attribute("num_attempts", status.num_attempts);
+  out.attributeArray("retry_args", [&] {
+    for (const std::string& arg : status.retry_args)
+      out.value(arg);
+  });
+  out.attributeArray("diagnostics", [&] {
+    for (const std::string& diagnostic : status.diagnostics)
+      out.value(diagnostic);
+  });
+}
+
+/// Reads a type dump. Any error is recorded in m_error and aborts the load.
+class JsonReader {
+public:
+  bool ReadResult(const llvm::json::Object& root, ParseResult& result) {
+    if (!ReadTypes(root, result.enums, result.records))
+      return false;
+
+    // Optional sections.
+    result.inline_empty_structs = root.getBoolean("inline_empty_structs").getValueOr(false);
+
+    if (const auto* variants = root.getArray("variants")) {
+      if (!GetString(root, "variant_name", result.variant_name))
+        return false;
+
+      for (const llvm::json::Value& value : *variants) {
+        const auto* obj = AsObject(value, "variant");
+        if (!obj || !ReadVariant(*obj, result.variants.emplace_back()))
+          return false;
+      }
+    }
+
+    if (const auto* conflicts = root.getArray("layout_conflicts")) {
+      for (const llvm::json::Value& value : *conflicts) {
+        const auto* obj = AsObject(value, "layout conflict");
+        if (!obj || !ReadLayoutConflict(*obj, result.layout_conflicts.emplace_back()))
+          return false;
+      }
+    }
+
+    if (const auto* errors = root.getArray("errors")) {
+      for (const llvm::json::Value& value : *errors) {
+        const auto* obj = AsObject(value, "translation unit status");
+        if (!obj || !ReadTranslationUnitStatus(*obj, result.translation_units.emplace_back()))
+          return false;
+      }
+    }
+
+    return true;
+  }
+
+  const std::string& GetError() const { return m_error; }
+
+private:
+  bool Fail(std::string error) {
+    if (m_error.empty())
+      m_error = std::move(error);
+    return false;
+  }
+
+  /// Prefixes the current error with the object that was being read. Always returns false.
+  bool AddContext(std::string_view context) {
+    m_error = fmt::format("{}: {}", context, m_error);
+    return false;
+  }
+
+  const llvm::json::Object* AsObject(const llvm::json::Value& value, std::string_view what) {
+    const auto* obj = value.getAsObject();
+    if (!obj)
+      Fail(fmt::format("expected {} to be an object", what));
+    return obj;
+  }
+
+  const llvm::json::Array* GetArray(const llvm::json::Object& obj, llvm::StringRef key) {
+    const auto* array = obj.getArray(key);
+    if (!array)
+      Fail(fmt::format("missing or invalid array: {}", key.str()));
+    return array;
+  }
+
+  const llvm::json::Object* GetObject(const llvm::json::Object& obj, llvm::StringRef key) {
+    const auto* value = obj.getObject(key);
+    if (!value)
+      Fail(fmt::format("missing or invalid object: {}", key.str()));
+    return value;
+  }
+
+  bool GetString(const llvm::json::Object& obj, llvm::StringRef key, std::string& out) {
+    const auto value = obj.getString(key);
+    if (!value)
+      return Fail(fmt::format("missing or invalid string: {}", key.str()));
+    out = value->str();
+    return true;
+  }
+
+  bool GetBool(const llvm::json::Object& obj, llvm::StringRef key, bool& out) {
+    const auto value = obj.getBoolean(key);
+    if (!value)
+      return Fail(fmt::format("missing or invalid boolean: {}", key.str()));
+    out = *value;
+    return true;
+  }
+
+  template <typename T>
+  bool GetInt(const llvm::json::Object& obj, llvm::StringRef key, T& out) {
+    const auto value = obj.getInteger(key);
+    if (!value)
+      return Fail(fmt::format("missing or invalid integer: {}", key.str()));
+    out = static_cast<T>(*value);
+    return true;
+  }
+
+  /// Like GetInt, but leaves `out` untouched if the key does not exist.
+  /// This is used for attributes that older versions of classgen did not emit.
+  template <typename T>
+  void GetOptionalInt(const llvm::json::Object& obj, llvm::StringRef key, T& out) {
+    if (const auto value = obj.getInteger(key))
+      out = static_cast<T>(*value);
+  }
+
+  std::unique_ptr<ComplexType> ReadComplexType(const llvm::json::Object* obj) {
+    if (!obj)
+      return {};
+
+    std::string kind;
+    if (!GetString(*obj, "kind", kind))
+      return {};
+
+    if (kind == "type_name") {
+      std::string name;
+      bool is_const{}, is_volatile{};
+      if (!GetString(*obj, "name", name) || !GetBool(*obj, "is_const", is_const) ||
+          !GetBool(*obj, "is_volatile", is_volatile)) {
+        return {};
+      }
+      return std::make_unique<ComplexTypeName>(std::move(name), is_const, is_volatile);
+    }
+
+    if (kind == "pointer") {
+      auto pointee_type = ReadComplexType(GetObject(*obj, "pointee_type"));
+      if (!pointee_type)
+        return {};
+      return std::make_unique<ComplexTypePointer>(std::move(pointee_type));
+    }
+
+    if (kind == "array") {
+      auto element_type = ReadComplexType(GetObject(*obj, "element_type"));
+      std::uint64_t size{};
+      if (!element_type || !GetInt(*obj, "size", size))
+        return {};
+      return std::make_unique<ComplexTypeArray>(std::move(element_type), size);
+    }
+
+    if (kind == "function") {
+      const auto* param_values = GetArray(*obj, "param_types");
+      if (!param_values)
+        return {};
+
+      std::vector<std::unique_ptr<ComplexType>> params;
+      params.reserve(param_values->size());
+      for (const llvm::json::Value& value : *param_values) {
+        auto param = ReadComplexType(AsObject(value, "parameter type"));
+        if (!param)
+          return {};
+        params.emplace_back(std::move(param));
+      }
+
+      auto return_type = ReadComplexType(GetObject(*obj, "return_type"));
+      if (!return_type)
+        return {};
+      return std::make_unique<ComplexTypeFunction>(std::move(params), std::move(return_type));
+    }
+
+    if (kind == "member_pointer") {
+      auto class_type = ReadComplexType(GetObject(*obj, "class_type"));
+      auto pointee_type = ReadComplexType(GetObject(*obj, "pointee_type"));
+      std::string repr;
+      if (!class_type || !pointee_type || !GetString(*obj, "repr", repr))
+        return {};
+      return std::make_unique<ComplexTypeMemberPointer>(std::move(class_type),
+                                                        std::move(pointee_type), std::move(repr));
+    }
+
+    if (kind == "atomic") {
+      auto value_type = ReadComplexType(GetObject(*obj, "value_type"));
+      if (!value_type)
+        return {};
+      return std::make_unique<ComplexTypeAtomic>(std::move(value_type));
+    }
+
+    Fail(fmt::format("unknown complex type kind: {}", kind));
+    return {};
+  }
+
+  bool ReadTypes(const llvm::json::Object& root, std::vector<Enum>& enums_out,
+                 std::vector<Record>& records_out) {
+    const auto* enums = GetArray(root, "enums");
+    const auto* records = GetArray(root, "records");
+    if (!enums || !records)
+      return false;
+
+    enums_out.reserve(enums->size());
+    for (const llvm::json::Value& value : *enums) {
+      const auto* obj = AsObject(value, "enum");
+      if (!obj || !ReadEnum(*obj, enums_out.emplace_back()))
+        return false;
+    }
+
+    records_out.reserve(records->size());
+    for (const llvm::json::Value& value : *records) {
+      const auto* obj = AsObject(value, "record");
+      if (!obj || !ReadRecord(*obj, records_out.emplace_back()))
+        return false;
+    }
+
+    return true;
+  }
+
+  bool ReadVariant(const llvm::json::Object& obj, ParseVariantResult& variant) {
+    if (!GetString(obj, "name", variant.name) ||
+        !ReadTypes(obj, variant.enums, variant.records)) {
+      return false;
+    }
+
+    const auto* missing_records = GetArray(obj, "missing_records");
+    if (!missing_records)
+      return false;
+
+    for (const llvm::json::Value& value : *missing_records) {
+      const auto name = value.getAsString();
+      if (!name)
+        return Fail("expected missing record to be a string");
+      variant.missing_records.push_back(name->str());
+    }
+
+    return true;
+  }
+
+  bool ReadLayoutConflict(const llvm::json::Object& obj, LayoutConflict& conflict) {
+    const auto read_layout = [&](llvm::StringRef key, LayoutConflict::Layout& layout) {
+      const auto* layout_obj = GetObject(obj, key);
+      return layout_obj && GetString(*layout_obj, "translation_unit", layout.translation_unit) &&
+             GetString(*layout_obj, "description", layout.description);
+    };
+
+    return GetString(obj, "name", conflict.name) && read_layout("first", conflict.first) &&
+           read_layout("second", conflict.second);
+  }
+
+  bool ReadTranslationUnitStatus(const llvm::json::Object& obj, TranslationUnitStatus& status) {
+    std::string status_name;
+    if (!GetString(obj, "file", status.file) || !GetString(obj, "status", status_name) ||
+        !GetInt(obj, "num_attempts", status.num_attempts)) {
+      return false;
+    }
+
+    if (const auto variant = obj.getString("variant"))
+      status.variant = variant->str();
+
+    const auto* kind = llvm::find_if(TranslationUnitStatusNames, [&](const auto& entry) {
+      return entry.second == status_name;
+    });
+    if (kind == std::end(TranslationUnitStatusNames))
+      return Fail(fmt::format("unknown translation unit status: {}", status_name));
+    status.status = kind->first;
+
+    const auto read_strings = [&](llvm::StringRef key, std::vector<std::string>& strings) {
+      const auto* array = GetArray(obj, key);
+      if (!array)
+        return false;
+      for (const llvm::json::Value& value : *array) {
+        const auto str = value.getAsString();
+        if (!str)
+          return Fail(fmt::format("expected {} to contain strings", key.str()));
+        strings.push_back(str->str());
+      }
+      return true;
+    };
+
+    return read_strings("retry_args", status.retry_args) &&
+           read_strings("diagnostics", status.diagnostics);
+  }
+
+  bool ReadEnum(const llvm::json::Object& obj, Enum& enum_def) {
+    if (!GetBool(obj, "is_scoped", enum_def.is_scoped) ||
+        !GetBool(obj, "is_anonymous", enum_def.is_anonymous) ||
+        !GetString(obj, "name", enum_def.name) ||
+        !GetString(obj, "underlying_type_name", enum_def.underlying_type_name) ||
+        !GetInt(obj, "underlying_type_size", enum_def.underlying_type_size)) {
+      return false;
+    }
+
+    const auto* enumerators = GetArray(obj, "enumerators");
+    if (!enumerators)
+      return false;
+
+    enum_def.enumerators.reserve(enumerators->size());
+    for (const llvm::json::Value& value : *enumerators) {
+      const auto* entry_obj = AsObject(value, "enumerator");
+      if (!entry_obj)
+        return false;
+
+      Enum::Enumerator& entry = enum_def.enumerators.emplace_back();
+      if (!GetString(*entry_obj, "identifier", entry.identifier) ||
+          !GetString(*entry_obj, "value", entry.value)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool ReadVTableFunction(const llvm::json::Object& obj, VTableComponent::FunctionPointer& func) {
+    if (!GetBool(obj, "is_thunk", func.is_thunk) || !GetBool(obj, "is_const", func.is_const))
+      return false;
+
+    if (func.is_thunk) {
+      if (!GetInt(obj, "return_adjustment", func.return_adjustment) ||
+          !GetInt(obj, "return_adjustment_vbase_offset_offset",
+                  func.return_adjustment_vbase_offset_offset) ||
+          !GetInt(obj, "this_adjustment", func.this_adjustment) ||
+          !GetInt(obj, "this_adjustment_vcall_offset_offset",
+                  func.this_adjustment_vcall_offset_offset)) {
+        return false;
+      }
+    }
+
+    if (!GetString(obj, "repr", func.repr) || !GetString(obj, "function_name", func.function_name))
+      return false;
+
+    func.type = ReadComplexType(GetObject(obj, "type"));
+    return func.type != nullptr;
+  }
+
+  bool ReadVTableComponent(const llvm::json::Object& obj, VTable& vtable) {
+    std::string kind;
+    if (!GetString(obj, "kind", kind))
+      return false;
+
+    if (kind == "vcall_offset") {
+      VTableComponent::VCallOffset entry;
+      if (!GetInt(obj, "offset", entry.offset))
+        return false;
+      vtable.components.emplace_back(entry);
+      return true;
+    }
+
+    if (kind == "vbase_offset") {
+      VTableComponent::VBaseOffset entry;
+      if (!GetInt(obj, "offset", entry.offset))
+        return false;
+      vtable.components.emplace_back(entry);
+      return true;
+    }
+
+    if (kind == "offset_to_top") {
+      VTableComponent::OffsetToTop entry;
+      if (!GetInt(obj, "offset", entry.offset))
+        return false;
+      vtable.components.emplace_back(entry);
+      return true;
+    }
+
+    if (kind == "rtti") {
+      VTableComponent::RTTI entry;
+      if (!GetString(obj, "class_name", entry.class_name))
+        return false;
+      vtable.components.emplace_back(std::move(entry));
+      return true;
+    }
+
+    if (kind == "func") {
+      VTableComponent::FunctionPointer entry;
+      if (!ReadVTableFunction(obj, entry))
+        return false;
+      vtable.components.emplace_back(std::move(entry));
+      return true;
+    }
+
+    if (kind == "complete_dtor") {
+      VTableComponent::CompleteDtorPointer entry;
+      if (!ReadVTableFunction(obj, entry))
+        return false;
+      vtable.components.emplace_back(std::move(entry));
+      return true;
+    }
+
+    if (kind == "deleting_dtor") {
+      VTableComponent::DeletingDtorPointer entry;
+      if (!ReadVTableFunction(obj, entry))
+        return false;
+      vtable.components.emplace_back(std::move(entry));
+      return true;
+    }
+
+    return Fail(fmt::format("unknown vtable component kind: {}", kind));
+  }
+
+  bool ReadField(const llvm::json::Object& obj, Field& field) {
+    std::string kind;
+    if (!GetInt(obj, "offset", field.offset) || !GetString(obj, "kind", kind))
+      return false;
+
+    if (kind == "member") {
+      Field::MemberVariable member;
+      GetOptionalInt(obj, "bitfield_width", member.bitfield_width);
+      GetOptionalInt(obj, "bitfield_offset", member.bitfield_offset);
+      GetOptionalInt(obj, "size", member.size);
+      GetOptionalInt(obj, "alignment", member.alignment);
+      member.type = ReadComplexType(GetObject(obj, "type"));
+      if (!member.type || !GetString(obj, "type_name", member.type_name) ||
+          !GetString(obj, "name", member.name)) {
+        return false;
+      }
+      field.data = std::move(member);
+      return true;
+    }
+
+    if (kind == "base") {
+      Field::Base base;
+      if (!GetBool(obj, "is_primary", base.is_primary) ||
+          !GetBool(obj, "is_virtual", base.is_virtual) ||
+          !GetString(obj, "type_name", base.type_name)) {
+        return false;
+      }
+      field.data = std::move(base);
+      return true;
+    }
+
+    if (kind == "vtable_ptr") {
+      field.data = Field::VTablePointer();
+      return true;
+    }
+
+    return Fail(fmt::format("unknown field kind: {}", kind));
+  }
+
+  bool ReadRecord(const llvm::json::Object& obj, Record& record) {
+    int kind{};
+    if (!GetBool(obj, "is_anonymous", record.is_anonymous) || !GetInt(obj, "kind", kind) ||
+        !GetString(obj, "name", record.name) || !GetInt(obj, "size", record.size) ||
+        !GetInt(obj, "data_size", record.data_size) ||
+        !GetInt(obj, "alignment", record.alignment)) {
+      return false;
+    }
+    record.kind = static_cast<Record::Kind>(kind);
+    // Optional (older dumps do not record source files).
+    if (const auto source_file = obj.getString("source_file"))
+      record.source_file = source_file->str();
+
+    const auto* fields = GetArray(obj, "fields");
+    if (!fields)
+      return false;
+
+    record.fields.reserve(fields->size());
+    for (const llvm::json::Value& value : *fields) {
+      const auto* field_obj = AsObject(value, "field");
+      if (!field_obj || !ReadField(*field_obj, record.fields.emplace_back()))
+        return AddContext(record.name);
+    }
+
+    // A null vtable means that the record has no vtable.
+    if (const auto* components = obj.getArray("vtable")) {
+      record.vtable = std::make_unique<VTable>();
+      record.vtable->components.reserve(components->size());
+      for (const llvm::json::Value& value : *components) {
+        const auto* component_obj = AsObject(value, "vtable component");
+        if (!component_obj || !ReadVTableComponent(*component_obj, *record.vtable))
+          return AddContext(record.name);
+      }
+      record.vtable->is_incomplete = obj.getBoolean("vtable_is_incomplete").getValueOr(false);
+    }
+
+    return true;
+  }
+
+  std::string m_error;
+};
+
+}  // namespace
+
+void WriteJson(llvm::raw_ostream& os, const ParseResult& result) {
+  llvm::json::OStream out(os);
+
+  out.object([&] {
+    out.attributeArray("enums", [&] {
+      for (const Enum& enum_def : result.enums)
+        out.object([&] { DumpEnum(out, enum_def); });
+    });
+
+    out.attributeArray("records", [&] {
+      for (const Record& record : result.records)
+        out.object([&] { DumpRecord(out, record); });
+    });
+
+    if (result.inline_empty_structs)
+      out.attribute("inline_empty_structs", true);
+
+    if (!result.variants.empty()) {
+      out.attribute("variant_name", result.variant_name);
+      out.attributeArray("variants", [&] {
+        for (const ParseVariantResult& variant : result.variants)
+          out.object([&] { DumpVariant(out, variant); });
+      });
+    }
+
+    if (!result.layout_conflicts.empty()) {
+      out.attributeArray("layout_conflicts", [&] {
+        for (const LayoutConflict& conflict : result.layout_conflicts)
+          out.object([&] { DumpLayoutConflict(out, conflict); });
+      });
+    }
+
+    if (llvm::any_of(result.translation_units, ShouldDumpTranslationUnitStatus)) {
+      out.attributeArray("errors", [&] {
+        for (const TranslationUnitStatus& status : result.translation_units) {
+          if (ShouldDumpTranslationUnitStatus(status))
+            out.object([&] { DumpTranslationUnitStatus(out, status); });
+        }
+      });
+    }
+  });
+}
+
+ParseResult ReadJson(std::string_view json) {
+  auto value = llvm::json::parse(llvm::StringRef(json.data(), json.size()));
+  if (!value)
+    return ParseResult::Fail("failed to parse JSON: " + llvm::toString(value.takeError()));
+
+  const auto* root = value->getAsObject();
+  if (!root)
+    return ParseResult::Fail("expected the type dump to be a JSON object");
+
+  ParseResult result;
+  JsonReader reader;
+  if (!reader.ReadResult(*root, result))
+    return ParseResult::Fail("invalid type dump: " + reader.GetError());
+
+  return result;
+}
+
+ParseResult ReadJsonFile(const std::string& path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return ParseResult::Fail("failed to read " + path + ": " + buffer.getError().message());
+
+  auto result = ReadJson((*buffer)->getBuffer());
+  if (!result)
+    result.AddErrorContext(path);
+  return result;
+}
+
+}  // namespace classgen
@@ -0,0 +1,387 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/Layout.h"
+#include <algorithm>
+#include <type_traits>
+#include <unordered_set>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Support/MathExtras.h>
+#include "classgen/ComplexType.h"
+
+namespace classgen {
+
+namespace {
+
+/// Upper bound for the size of a vtable pointer. The dump does not record the pointer size
+/// of the target, so vtable pointers are assumed to extend up to the next field.
+constexpr std::size_t MaxPointerSize = 8;
+
+std::size_t GetNaturalFieldSize(const TypeIndex& index, const Field& field) {
+  if (const auto* member = std::get_if<Field::MemberVariable>(&field.data))
+    return member->size;
+
+  if (const auto* base = std::get_if<Field::Base>(&field.data)) {
+    if (const Record* record = index.FindRecord(base->type_name))
+      return record->data_size;
+    return 0;
+  }
+
+  if (std::holds_alternative<Field::VTablePointer>(field.data))
+    return MaxPointerSize;
+
+  return 0;
+}
+
+bool IsEmptyRecord(const TypeIndex& index, const Record& record, std::size_t depth) {
+  if (record.data_size == 0)
+    return true;
+
+  if (record.vtable || depth > MaxNestingDepth)
+    return false;
+
+  return llvm::all_of(record.fields, [&](const Field& field) {
+    const auto* base = std::get_if<Field::Base>(&field.data);
+    if (!base)
+      return false;
+    const Record* base_record = index.FindRecord(base->type_name);
+    return base_record && IsEmptyRecord(index, *base_record, depth + 1);
+  });
+}
+
+}  // namespace
+
+std::size_t GetSizeForBits(std::size_t bits) {
+  return llvm::PowerOf2Ceil(std::max<std::size_t>(llvm::divideCeil(bits, CharBit), 1));
+}
+
+ArrayElementType GetArrayElementType(const ComplexType* type) {
+  ArrayElementType result{type, 1};
+  while (result.type && result.type->GetKind() == ComplexType::Kind::Array) {
+    const auto* array = static_cast<const ComplexTypeArray*>(result.type);
+    result.count *= array->size;
+    result.type = array->element_type.get();
+  }
+  return result;
+}
+
+TypeIndex::TypeIndex(const ParseResult& result) : m_result(result) {
+  m_records.reserve(result.records.size());
+  for (const Record& record : result.records)
+    m_records.emplace(record.name, &record);
+
+  m_enums.reserve(result.enums.size());
+  for (const Enum& enum_def : result.enums)
+    m_enums.emplace(enum_def.name, &enum_def);
+}
+
+const Record* TypeIndex::FindRecord(std::string_view name) const {
+  const auto it = m_records.find(name);
+  return it == m_records.end() ? nullptr : it->second;
+}
+
+const Enum* TypeIndex::FindEnum(std::string_view name) const {
+  const auto it = m_enums.find(name);
+  return it == m_enums.end() ? nullptr : it->second;
+}
+
+ClassHierarchy::ClassHierarchy(const TypeIndex& index) {
+  for (const Record& record : index.GetResult().records) {
+    for (const Field& field : record.fields) {
+      const auto* base = std::get_if<Field::Base>(&field.data);
+      if (!base)
+        continue;
+      if (const Record* base_record = index.FindRecord(base->type_name))
+        m_derived[base_record].push_back({&record, &field});
+    }
+  }
+}
+
+const std::vector<ClassHierarchy::Derived>&
+ClassHierarchy::GetDerivedRecords(const Record& record) const {
+  static const std::vector<Derived> empty;
+  const auto it = m_derived.find(&record);
+  return it == m_derived.end() ? empty : it->second;
+}
+
+std::vector<const Record*> ClassHierarchy::GetAllDerivedRecords(const Record& record) const {
+  std::vector<const Record*> result;
+  std::unordered_set<const Record*> visited{&record};
+  std::vector<const Record*> stack{&record};
+
+  while (!stack.empty()) {
+    const Record* current = stack.back();
+    stack.pop_back();
+    for (const Derived& derived : GetDerivedRecords(*current)) {
+      if (!visited.insert(derived.record).second)
+        continue;
+      result.push_back(derived.record);
+      stack.push_back(derived.record);
+    }
+  }
+
+  return result;
+}
+
+std::vector<FieldExtent> GetFieldExtents(const TypeIndex& index, const Record& record) {
+  std::vector<std::size_t> offsets;
+  offsets.reserve(record.fields.size());
+  for (const Field& field : record.fields)
+    offsets.push_back(field.offset);
+  llvm::sort(offsets);
+
+  std::vector<FieldExtent> extents;
+  extents.reserve(record.fields.size());
+  for (std::size_t i = 0; i < record.fields.size(); ++i) {
+    const Field& field = record.fields[i];
+
+    // A field cannot extend past the start of the next field or past the end of the record.
+    const auto next = std::upper_bound(offsets.begin(), offsets.end(), field.offset);
+    const std::size_t limit = next == offsets.end() ? record.size : *next;
+    const std::size_t available = limit > field.offset ? limit - field.offset : 0;
+
+    std::size_t size = GetNaturalFieldSize(index, field);
+    // Older dumps do not record member sizes.
+    if (size == 0 && std::holds_alternative<Field::MemberVariable>(field.data))
+      size = available;
+
+    extents.push_back({i, field.offset, std::min(size, available)});
+  }
+
+  return extents;
+}
+
+std::size_t GetPaddingSize(const Record& record, const std::vector<FieldExtent>& extents) {
+  std::vector<std::pair<std::size_t, std::size_t>> ranges;
+  ranges.reserve(extents.size());
+  for (const FieldExtent& extent : extents) {
+    if (extent.size != 0)
+      ranges.emplace_back(extent.offset, extent.offset + extent.size);
+  }
+  llvm::sort(ranges);
+
+  std::size_t covered = 0;
+  std::size_t end = 0;
+  for (const auto& [range_begin, range_end] : ranges) {
+    const std::size_t begin = std::max(range_begin, end);
+    if (range_end > begin) {
+      covered += range_end - begin;
+      end = range_end;
+    }
+  }
+
+  return record.size > covered ? record.size - covered : 0;
+}
+
+bool IsEmptyRecord(const TypeIndex& index, const Record& record) {
+  return IsEmptyRecord(index, record, 0);
+}
+
+bool HaveSameLayout(const Record& lhs, const Record& rhs) {
+  if (lhs.kind != rhs.kind || lhs.size != rhs.size || lhs.data_size != rhs.data_size ||
+      lhs.alignment != rhs.alignment || lhs.fields.size() != rhs.fields.size()) {
+    return false;
+  }
+
+  for (std::size_t i = 0; i < lhs.fields.size(); ++i) {
+    const Field& a = lhs.fields[i];
+    const Field& b = rhs.fields[i];
+    if (a.offset != b.offset || a.data.index() != b.data.index())
+      return false;
+
+    if (const auto* member_a = std::get_if<Field::MemberVariable>(&a.data)) {
+      const auto& member_b = std::get<Field::MemberVariable>(b.data);
+      if (member_a->name != member_b.name || member_a->type_name != member_b.type_name ||
+          member_a->bitfield_width != member_b.bitfield_width ||
+          member_a->bitfield_offset != member_b.bitfield_offset ||
+          member_a->size != member_b.size || member_a->alignment != member_b.alignment) {
+        return false;
+      }
+    } else if (const auto* base_a = std::get_if<Field::Base>(&a.data)) {
+      const auto& base_b = std::get<Field::Base>(b.data);
+      if (base_a->type_name != base_b.type_name || base_a->is_virtual != base_b.is_virtual ||
+          base_a->is_primary != base_b.is_primary) {
+        return false;
+      }
+    }
+  }
+
+  if (!lhs.vtable || !rhs.vtable)
+    return !lhs.vtable && !rhs.vtable;
+
+  const auto& lhs_components = lhs.vtable->components;
+  const auto& rhs_components = rhs.vtable->components;
+  if (lhs_components.size() != rhs_components.size())
+    return false;
+
+  for (std::size_t i = 0; i < lhs_components.size(); ++i) {
+    const VTableComponent::Data& a = lhs_components[i].data;
+    const VTableComponent::Data& b = rhs_components[i].data;
+    if (a.index() != b.index())
+      return false;
+
+    const bool same = std::visit(
+        [&](const auto& component) {
+          using T = std::decay_t<decltype(component)>;
+          const T& other = std::get<T>(b);
+          if constexpr (std::is_base_of_v<VTableComponent::FunctionPointer, T>)
+            return component.repr == other.repr;
+          else if constexpr (std::is_same_v<T, VTableComponent::RTTI>)
+            return component.class_name == other.class_name;
+          else
+            return component.offset == other.offset;
+        },
+        a);
+    if (!same)
+      return false;
+  }
+
+  return true;
+}
+
+bool HaveSameLayout(const Enum& lhs, const Enum& rhs) {
+  if (lhs.underlying_type_name != rhs.underlying_type_name ||
+      lhs.underlying_type_size != rhs.underlying_type_size ||
+      lhs.enumerators.size() != rhs.enumerators.size()) {
+    return false;
+  }
+
+  for (std::size_t i = 0; i < lhs.enumerators.size(); ++i) {
+    if (lhs.enumerators[i].identifier != rhs.enumerators[i].identifier ||
+        lhs.enumerators[i].value != rhs.enumerators[i].value) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::string DescribeLayout(const Record& record) {
+  std::string description = fmt::format("size {:#x}, data size {:#x}, alignment {:#x}",
+                                        record.size, record.data_size, record.alignment);
+
+  for (const Field& field : record.fields) {
+    if (const auto* member = std::get_if<Field::MemberVariable>(&field.data)) {
+      description += fmt::format("; [{:#x}] {} {}", field.offset, member->type_name, member->name);
+      if (member->bitfield_width != 0)
+        description += fmt::format(" : {}", member->bitfield_width);
+    } else if (const auto* base = std::get_if<Field::Base>(&field.data)) {
+      description += fmt::format("; [{:#x}] {}base {}", field.offset,
+                                 base->is_virtual ? "virtual " : "", base->type_name);
+    } else if (std::holds_alternative<Field::VTablePointer>(field.data)) {
+      description += fmt::format("; [{:#x}] vptr", field.offset);
+    }
+  }
+
+  return description;
+}
+
+EmbeddedRecord GetEmbeddedRecord(const TypeIndex& index, const Field& field) {
+  const auto* member = std::get_if<Field::MemberVariable>(&field.data);
+  if (!member)
+    return {};
+
+  const auto [type, count] = GetArrayElementType(member->type.get());
+  if (!type || type->GetKind() != ComplexType::Kind::TypeName)
+    return {};
+
+  const auto* name = static_cast<const ComplexTypeName*>(type);
+  if (const Record* record = index.FindRecord(name->name))
+    return {record, count};
+
+  return {};
+}
+
+const std::vector<ExpandedMember>& LayoutExpander::Expand(const Record& record) {
+  static const std::vector<ExpandedMember> s_empty;
+
+  if (const auto it = m_expansions.find(&record); it != m_expansions.end())
+    return it->second;
+
+  if (!m_in_progress.insert(&record).second)
+    return s_empty;
+
+  std::vector<ExpandedMember> members;
+  for (const Field& field : record.fields) {
+    if (const auto* base = std::get_if<Field::Base>(&field.data)) {
+      if (const Record* base_record = m_index.FindRecord(base->type_name)) {
+        AddSubobject(members, *base_record, field.offset, base->type_name + "::", true,
+                     base->is_virtual);
+        continue;
+      }
+      members.push_back({base->type_name, field.offset, &field, base->is_virtual});
+      continue;
+    }
+
+    if (const auto* member = std::get_if<Field::MemberVariable>(&field.data)) {
+      const EmbeddedRecord embedded =
+          m_expand_member_records ? GetEmbeddedRecord(m_index, field) : EmbeddedRecord{};
+      const bool is_array = member->type && member->type->GetKind() == ComplexType::Kind::Array;
+      if (embedded.record && !is_array && !Expand(*embedded.record).empty()) {
+        // Members of anonymous structs and unions are accessed without an intermediate name.
+        AddSubobject(members, *embedded.record, field.offset,
+                     member->name.empty() ? "" : member->name + ".", false, false);
+        continue;
+      }
+      members.push_back({member->name, field.offset, &field, false});
+      continue;
+    }
+
+    if (std::holds_alternative<Field::VTablePointer>(field.data))
+      members.push_back({"__vptr", field.offset, &field, false});
+  }
+
+  llvm::stable_sort(members, [](const ExpandedMember& lhs, const ExpandedMember& rhs) {
+    return lhs.offset < rhs.offset;
+  });
+
+  m_in_progress.erase(&record);
+  return m_expansions[&record] = std::move(members);
+}
+
+void LayoutExpander::AddSubobject(std::vector<ExpandedMember>& members, const Record& record,
+                                  std::size_t offset, std::string_view prefix, bool is_base,
+                                  bool is_virtual_base) {
+  for (const ExpandedMember& member : Expand(record)) {
+    // Virtual bases of base subobjects are listed (and placed) by the most derived record.
+    if (is_base && member.in_virtual_base)
+      continue;
+
+    ExpandedMember& expanded = members.emplace_back();
+    expanded.path.reserve(prefix.size() + member.path.size());
+    expanded.path.append(prefix);
+    expanded.path.append(member.path);
+    expanded.offset = offset + member.offset;
+    expanded.field = member.field;
+    expanded.in_virtual_base = is_virtual_base;
+  }
+}
+
+std::size_t FindLastScopeSeparator(std::string_view name) {
+  std::size_t result = std::string_view::npos;
+  int depth = 0;
+  for (std::size_t i = 0; i + 1 < name.size(); ++i) {
+    switch (name[i]) {
+    case '<':
+    case '(':
+      ++depth;
+      break;
+    case '>':
+    case ')':
+      --depth;
+      break;
+    case ':':
+      if (depth == 0 && name[i + 1] == ':') {
+        result = i;
+        ++i;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  return result;
+}
+
+}  // namespace classgen
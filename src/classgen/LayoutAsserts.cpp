@@ -0,0 +1,120 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/LayoutAsserts.h"
+#include <string_view>
+#include <unordered_set>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace classgen {
+
+namespace {
+
+bool CanBeNamed(const Record& record) {
+  if (record.is_anonymous || record.name.empty())
+    return false;
+
+  const llvm::StringRef name = record.name;
+  return !name.contains("(anonymous") && !name.contains("(unnamed") && !name.contains("(lambda");
+}
+
+bool HasVirtualBases(const Record& record) {
+  return llvm::any_of(record.fields, [](const Field& field) {
+    const auto* base = std::get_if<Field::Base>(&field.data);
+    return base && base->is_virtual;
+  });
+}
+
+void WriteRecordAsserts(llvm::raw_ostream& os, const Record& record, std::size_t index,
+                        const LayoutAssertOptions& options) {
+  os << fmt::format("\n// {}\n", record.name);
+  os << fmt::format("static_assert(sizeof({0}) == {1:#x}, \"wrong size for {0}\");\n", record.name,
+                    record.size);
+  os << fmt::format("static_assert(alignof({0}) == {1}, \"wrong alignment for {0}\");\n",
+                    record.name, record.alignment);
+
+  // offsetof cannot be used on types with virtual bases.
+  if (!options.check_offsets || HasVirtualBases(record))
+    return;
+
+  // Commas in template argument lists would split the offsetof macro arguments.
+  std::string type_name = record.name;
+  if (llvm::StringRef(record.name).contains(',')) {
+    type_name = fmt::format("classgen_layout_asserts::T{}", index);
+    os << fmt::format("namespace classgen_layout_asserts {{ using T{} = {}; }}\n", index,
+                      record.name);
+  }
+
+  for (const Field& field : record.fields) {
+    const auto* member = std::get_if<Field::MemberVariable>(&field.data);
+    // Bitfields cannot be passed to offsetof, and members of anonymous structs and unions are
+    // listed in the anonymous record.
+    if (!member || member->bitfield_width != 0 || member->name.empty())
+      continue;
+
+    os << fmt::format("static_assert(CLASSGEN_OFFSETOF({0}, {1}) == {2:#x}, "
+                      "\"wrong offset for {3}::{1}\");\n",
+                      type_name, member->name, field.offset, record.name);
+  }
+}
+
+}  // namespace
+
+bool WriteLayoutAsserts(llvm::raw_ostream& os, const ParseResult& result,
+                        const LayoutAssertOptions& options, std::string& error) {
+  const std::unordered_set<std::string_view> selected{options.records.begin(),
+                                                      options.records.end()};
+
+  std::vector<std::string> errors;
+  for (const std::string& name : options.records) {
+    const auto it = llvm::find_if(result.records,
+                                  [&](const Record& record) { return record.name == name; });
+    if (it == result.records.end())
+      errors.push_back("unknown record: " + name);
+    else if (!CanBeNamed(*it))
+      errors.push_back("record cannot be named in C++: " + name);
+  }
+  if (!errors.empty()) {
+    error = llvm::join(errors, "\n");
+    return false;
+  }
+
+  os << "// Layout checks generated by classgen. Do not edit.\n"
+        "// Include this file after the definitions of all checked types.\n"
+        "\n"
+        "#pragma once\n"
+        "\n"
+        "#include <cstddef>\n"
+        "\n"
+        "// Can be overridden, e.g. to check private members from a friend or with "
+        "-Dprivate=public.\n"
+        "#ifndef CLASSGEN_OFFSETOF\n"
+        "#define CLASSGEN_OFFSETOF(type, member) offsetof(type, member)\n"
+        "#endif\n"
+        "\n"
+        "#if defined(__GNUC__)\n"
+        "#pragma GCC diagnostic push\n"
+        "#pragma GCC diagnostic ignored \"-Winvalid-offsetof\"\n"
+        "#endif\n";
+
+  for (std::size_t i = 0; i < result.records.size(); ++i) {
+    const Record& record = result.records[i];
+    if (!CanBeNamed(record))
+      continue;
+    if (!selected.empty() && !selected.contains(record.name))
+      continue;
+    WriteRecordAsserts(os, record, i, options);
+  }
+
+  os << "\n"
+        "#if defined(__GNUC__)\n"
+        "#pragma GCC diagnostic pop\n"
+        "#endif\n";
+  return true;
+}
+
+}  // namespace classgen
@@ -0,0 +1,114 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/PreambleCache.h"
+#include <algorithm>
+#include <clang/Basic/FileManager.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Frontend/PrecompiledPreamble.h>
+#include <clang/Lex/PreprocessorOptions.h>
+#include <llvm/ADT/Hashing.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/StringSaver.h>
+#include <llvm/Support/VirtualFileSystem.h>
+
+namespace classgen {
+
+namespace {
+
+constexpr std::size_t MaxPreambles = 8;
+
+/// Returns a key that is identical for invocations that only differ in their input and output
+/// files, based on the -cc1 command line and the working directory.
+std::string GetInvocationKey(const clang::CompilerInvocation& invocation,
+                             llvm::vfs::FileSystem& fs) {
+  clang::CompilerInvocation copy{invocation};
+  copy.getFrontendOpts().Inputs.clear();
+  copy.getFrontendOpts().OutputFile.clear();
+  copy.getCodeGenOpts().MainFileName.clear();
+  copy.getDependencyOutputOpts() = clang::DependencyOutputOptions();
+
+  llvm::BumpPtrAllocator allocator;
+  llvm::StringSaver saver{allocator};
+  llvm::SmallVector<const char*, 256> args;
+  copy.generateCC1CommandLine(args,
+                              [&](const llvm::Twine& arg) { return saver.save(arg).data(); });
+
+  std::string key;
+  if (const auto cwd = fs.getCurrentWorkingDirectory())
+    key = *cwd;
+  for (const char* arg : args) {
+    key += '\0';
+    key += arg;
+  }
+  return key;
+}
+
+}  // namespace
+
+PreambleCache::PreambleCache() = default;
+
+PreambleCache::~PreambleCache() = default;
+
+void PreambleCache::Apply(clang::CompilerInvocation& invocation, clang::FileManager& files,
+                          const std::shared_ptr<clang::PCHContainerOperations>& pch_container_ops,
+                          clang::DiagnosticConsumer* diag_consumer) {
+  const auto& inputs = invocation.getFrontendOpts().Inputs;
+  if (inputs.size() != 1 || !inputs[0].isFile())
+    return;
+
+  auto buffer = files.getBufferForFile(inputs[0].getFile());
+  if (!buffer)
+    return;
+
+  const clang::PreambleBounds bounds =
+      clang::ComputePreambleBounds(*invocation.getLangOpts(), (*buffer)->getMemBufferRef(), 0);
+  if (bounds.Size == 0)
+    return;
+
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs{&files.getVirtualFileSystem()};
+  const std::string key = GetInvocationKey(invocation, *fs);
+
+  const auto use_preamble = [&](const clang::PrecompiledPreamble& preamble) {
+    // The precompiled preamble is stored in a temporary file, which is visible through the file
+    // manager as long as its file system is backed by the real file system.
+    const clang::PreprocessorOptions options = invocation.getPreprocessorOpts();
+    auto preamble_fs = fs;
+    preamble.AddImplicitPreamble(invocation, preamble_fs, buffer->get());
+    if (preamble_fs != fs)
+      invocation.getPreprocessorOpts() = options;
+  };
+
+  const auto it = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry& entry) {
+    return entry.key == key &&
+           entry.preamble->CanReuse(invocation, (*buffer)->getMemBufferRef(), bounds, *fs);
+  });
+  if (it != m_entries.end()) {
+    std::rotate(it, it + 1, m_entries.end());
+    use_preamble(*m_entries.back().preamble);
+    return;
+  }
+
+  const std::size_t hash = llvm::hash_combine(key, (*buffer)->getBuffer().take_front(bounds.Size));
+  if (m_seen.insert(hash).second)
+    return;
+
+  auto diagnostics = clang::CompilerInstance::createDiagnostics(&invocation.getDiagnosticOpts(),
+                                                                diag_consumer, false);
+  clang::PreambleCallbacks callbacks;
+  auto preamble = clang::PrecompiledPreamble::Build(invocation, buffer->get(), bounds,
+                                                    *diagnostics, fs, pch_container_ops,
+                                                    /*StoreInMemory=*/false, callbacks);
+  if (!preamble)
+    return;
+
+  if (m_entries.size() == MaxPreambles)
+    m_entries.erase(m_entries.begin());
+  m_entries.push_back({key, std::make_unique<clang::PrecompiledPreamble>(std::move(*preamble))});
+  use_preamble(*m_entries.back().preamble);
+}
+
+}  // namespace classgen
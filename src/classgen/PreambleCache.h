@@ -0,0 +1,51 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace clang {
+class CompilerInvocation;
+class DiagnosticConsumer;
+class FileManager;
+class PCHContainerOperations;
+class PrecompiledPreamble;
+}  // namespace clang
+
+namespace classgen {
+
+/// Shares precompiled preambles (the leading #includes of a main file) between translation units
+/// that are compiled with the same flags and start with the same preamble.
+///
+/// A preamble is only built the second time it is seen, so that translation units with unique
+/// preambles do not pay for PCH generation. Translation units should be processed in groups of
+/// equivalent flags (see GroupByCompileFlags) because only a few preambles are kept.
+class PreambleCache {
+public:
+  PreambleCache();
+  ~PreambleCache();
+
+  /// Makes the invocation use a precompiled preamble if possible.
+  void Apply(clang::CompilerInvocation& invocation, clang::FileManager& files,
+             const std::shared_ptr<clang::PCHContainerOperations>& pch_container_ops,
+             clang::DiagnosticConsumer* diag_consumer);
+
+private:
+  struct Entry {
+    std::string key;
+    std::unique_ptr<clang::PrecompiledPreamble> preamble;
+  };
+
+  /// Most recently used last.
+  std::vector<Entry> m_entries;
+  /// Hashes of the keys and preambles that have been seen once.
+  std::unordered_set<std::size_t> m_seen;
+};
+
+}  // namespace classgen
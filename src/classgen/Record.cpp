@@ -2,37 +2,74 @@
 // SPDX-License-Identifier: MIT
 
 #include "classgen/Record.h"
+#include <optional>
+#include <clang/AST/DeclGroup.h>
 #include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/Basic/Diagnostic.h>
+#include <clang/Basic/FileManager.h>
+#include <clang/Basic/SourceManager.h>
 #include <clang/Basic/TargetInfo.h>
+#include <clang/Frontend/CompilerInvocation.h>
 #include <clang/Frontend/FrontendAction.h>
+#include <clang/Frontend/PCHContainerOperations.h>
+#include <clang/Frontend/TextDiagnosticPrinter.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
 #include <clang/Tooling/CompilationDatabase.h>
 #include <clang/Tooling/Tooling.h>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include "classgen/CompilationDatabase.h"
+#include "classgen/Layout.h"
+#include "classgen/PreambleCache.h"
 #include "classgen/RecordImpl.h"
 
 namespace classgen {
 
 namespace {
 
+constexpr const char* CancelledError = "parsing was cancelled";
+
+bool IsCancelled(const ParseConfig& config) {
+  return config.cancellation_token && config.cancellation_token->IsCancelled();
+}
+
 class ParseRecordConsumer final : public clang::ASTConsumer,
                                   public clang::RecursiveASTVisitor<ParseRecordConsumer> {
 public:
-  explicit ParseRecordConsumer(ParseContext& context) : m_parse_context(context) {}
+  explicit ParseRecordConsumer(ParseContext& context, llvm::StringRef file)
+      : m_parse_context(context), m_file(file) {}
+
+  /// Returning false stops parsing.
+  bool HandleTopLevelDecl(clang::DeclGroupRef) override { return !IsCancelled(); }
 
   void HandleTranslationUnit(clang::ASTContext& Ctx) override {
+    if (IsCancelled())
+      return;
+
     if (!Ctx.getTargetInfo().getCXXABI().isItaniumFamily()) {
       m_parse_context.GetResult().error = "only the Itanium C++ ABI is supported";
       return;
     }
 
+    m_parse_context.SetTranslationUnit(m_file);
     TraverseAST(Ctx);
   }
 
   bool VisitEnumDecl(clang::EnumDecl* D) {
+    if (IsCancelled())
+      return false;
     m_parse_context.HandleEnumDecl(D);
     return true;
   }
 
   bool VisitRecordDecl(clang::RecordDecl* D) {
+    if (IsCancelled())
+      return false;
     m_parse_context.HandleRecordDecl(D);
     return true;
   }
@@ -40,7 +77,10 @@ public:
   bool shouldVisitTemplateInstantiations() const { return true; }
 
 private:
+  bool IsCancelled() const { return classgen::IsCancelled(m_parse_context.GetConfig()); }
+
   ParseContext& m_parse_context;
+  std::string m_file;
 };
 
 class ParseRecordAction final : public clang::ASTFrontendAction {
@@ -50,47 +90,380 @@ public:
 protected:
   std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(clang::CompilerInstance& CI,
                                                         llvm::StringRef InFile) override {
-    return std::make_unique<ParseRecordConsumer>(m_context);
+    return std::make_unique<ParseRecordConsumer>(m_context, InFile);
   }
 
 private:
   ParseContext& m_context;
 };
 
+/// Forwards diagnostics to another consumer and records errors.
+class RecordingDiagnosticConsumer final : public clang::DiagnosticConsumer {
+public:
+  /// Maximum number of errors that are recorded per translation unit.
+  static constexpr std::size_t MaxDiagnostics = 20;
+
+  RecordingDiagnosticConsumer(clang::DiagnosticConsumer& target,
+                              std::vector<std::string>& diagnostics)
+      : m_target(target), m_diagnostics(diagnostics) {}
+
+  void BeginSourceFile(const clang::LangOptions& LangOpts, const clang::Preprocessor* PP) override {
+    m_target.BeginSourceFile(LangOpts, PP);
+  }
+
+  void EndSourceFile() override { m_target.EndSourceFile(); }
+
+  void finish() override { m_target.finish(); }
+
+  void HandleDiagnostic(clang::DiagnosticsEngine::Level level,
+                        const clang::Diagnostic& info) override {
+    DiagnosticConsumer::HandleDiagnostic(level, info);
+    m_target.HandleDiagnostic(level, info);
+
+    if (level < clang::DiagnosticsEngine::Error || m_diagnostics.size() >= MaxDiagnostics)
+      return;
+
+    llvm::SmallString<256> message;
+    info.FormatDiagnostic(message);
+
+    std::string location;
+    if (info.hasSourceManager() && info.getLocation().isValid()) {
+      const clang::PresumedLoc loc = info.getSourceManager().getPresumedLoc(info.getLocation());
+      if (loc.isValid())
+        location = fmt::format("{}:{}:{}: ", loc.getFilename(), loc.getLine(), loc.getColumn());
+    }
+
+    m_diagnostics.push_back(fmt::format(
+        "{}{}: {}", location, level == clang::DiagnosticsEngine::Fatal ? "fatal error" : "error",
+        std::string(message.str())));
+  }
+
+private:
+  clang::DiagnosticConsumer& m_target;
+  std::vector<std::string>& m_diagnostics;
+};
+
+std::string GetMainFile(const clang::CompilerInvocation& invocation, clang::FileManager& files) {
+  const auto& inputs = invocation.getFrontendOpts().Inputs;
+  if (inputs.empty() || !inputs[0].isFile())
+    return {};
+
+  llvm::SmallString<256> path{inputs[0].getFile()};
+  static_cast<void>(files.getVirtualFileSystem().makeAbsolute(path));
+  llvm::sys::path::remove_dots(path, true);
+  return std::string(path);
+}
+
+/// Creates ParseRecordActions and records the status of every translation unit.
+/// The types of translation units that fail to compile or are cancelled are discarded.
 class ParseRecordActionFactory final : public clang::tooling::FrontendActionFactory {
 public:
-  explicit ParseRecordActionFactory(ParseContext& context) : m_context(context) {}
+  explicit ParseRecordActionFactory(ParseContext& context,
+                                    std::vector<TranslationUnitStatus>& statuses,
+                                    std::string_view variant)
+      : m_context(context), m_config(context.GetConfig()), m_statuses(statuses),
+        m_variant(variant) {
+    if (m_config.share_preambles)
+      m_preambles.emplace();
+  }
 
   std::unique_ptr<clang::FrontendAction> create() override {
     return std::make_unique<ParseRecordAction>(m_context);
   }
 
+  bool runInvocation(std::shared_ptr<clang::CompilerInvocation> invocation,
+                     clang::FileManager* files,
+                     std::shared_ptr<clang::PCHContainerOperations> pch_container_ops,
+                     clang::DiagnosticConsumer* diag_consumer) override {
+    TranslationUnitStatus& status = m_statuses.emplace_back();
+    status.file = GetMainFile(*invocation, *files);
+
+    // Skipped translation units are not processing failures: don't make ClangTool report them.
+    if (IsCancelled(m_config)) {
+      status.status = TranslationUnitStatus::Kind::Cancelled;
+      return true;
+    }
+
+    ReportProgress(ParseProgress::Event::TranslationUnitStarted, status);
+
+    if (m_preambles)
+      m_preambles->Apply(*invocation, *files, pch_container_ops, diag_consumer);
+
+    std::optional<clang::TextDiagnosticPrinter> printer;
+    if (!diag_consumer)
+      diag_consumer = &printer.emplace(llvm::errs(), &invocation->getDiagnosticOpts());
+    RecordingDiagnosticConsumer recorder{*diag_consumer, status.diagnostics};
+
+    m_context.BeginTranslationUnit();
+    const bool ok = FrontendActionFactory::runInvocation(std::move(invocation), files,
+                                                         std::move(pch_container_ops), &recorder);
+    if (IsCancelled(m_config)) {
+      m_context.DiscardTranslationUnit();
+      status.status = TranslationUnitStatus::Kind::Cancelled;
+    } else if (!ok) {
+      m_context.DiscardTranslationUnit();
+      status.status = TranslationUnitStatus::Kind::Failed;
+    }
+
+    ReportProgress(ParseProgress::Event::TranslationUnitFinished, status);
+    return ok || status.status == TranslationUnitStatus::Kind::Cancelled;
+  }
+
+private:
+  void ReportProgress(ParseProgress::Event event, const TranslationUnitStatus& status) const {
+    if (!m_config.progress_callback)
+      return;
+
+    m_config.progress_callback({
+        .event = event,
+        .file = status.file,
+        .variant = m_variant,
+        .status = status.status,
+        .num_records = m_context.GetResult().records.size(),
+    });
+  }
+
   ParseContext& m_context;
+  const ParseConfig& m_config;
+  std::vector<TranslationUnitStatus>& m_statuses;
+  std::string_view m_variant;
+  std::optional<PreambleCache> m_preambles;
 };
 
+bool IsFailed(const TranslationUnitStatus& status) {
+  return status.status != TranslationUnitStatus::Kind::Ok;
+}
+
+void CheckTranslationUnits(ParseResult& result, const ParseConfig& config) {
+  if (IsCancelled(config))
+    result.error = CancelledError;
+  else if (!result.translation_units.empty() && llvm::all_of(result.translation_units, IsFailed))
+    result.AddErrorContext("no translation unit could be parsed");
+}
+
+std::unique_ptr<clang::tooling::ClangTool>
+MakeTool(const clang::tooling::CompilationDatabase& compilations,
+         llvm::ArrayRef<std::string> source_paths, const std::vector<std::string>& args,
+         llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs,
+         llvm::IntrusiveRefCntPtr<clang::FileManager> files) {
+  auto tool = std::make_unique<clang::tooling::ClangTool>(
+      compilations, source_paths, std::make_shared<clang::PCHContainerOperations>(), fs, files);
+  if (!args.empty()) {
+    tool->appendArgumentsAdjuster(clang::tooling::getInsertArgumentAdjuster(
+        args, clang::tooling::ArgumentInsertPosition::END));
+  }
+  return tool;
+}
+
+/// Parses source files with extra compiler arguments, then retries failed translation units
+/// according to the retry policy.
+ParseResult ParseWithRetries(const clang::tooling::CompilationDatabase& compilations,
+                             llvm::ArrayRef<std::string> source_paths,
+                             const std::vector<std::string>& args,
+                             llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs,
+                             llvm::IntrusiveRefCntPtr<clang::FileManager> files,
+                             std::string_view variant, const ParseConfig& config) {
+  ParseResult result;
+  auto context = ParseContext::Make(result, config);
+
+  ParseRecordActionFactory factory{*context, result.translation_units, variant};
+  MakeTool(compilations, source_paths, args, fs, files)->run(&factory);
+
+  std::vector<std::string> absolute_paths;
+  absolute_paths.reserve(source_paths.size());
+  for (const std::string& path : source_paths) {
+    llvm::SmallString<256> absolute_path{path};
+    static_cast<void>(fs->makeAbsolute(absolute_path));
+    llvm::sys::path::remove_dots(absolute_path, true);
+    absolute_paths.emplace_back(absolute_path);
+  }
+
+  const auto index_statuses = [&] {
+    llvm::StringMap<std::size_t> index;
+    for (std::size_t i = 0; i < result.translation_units.size(); ++i)
+      index.try_emplace(result.translation_units[i].file, i);
+    return index;
+  };
+
+  // Files that were skipped before compilation started (e.g. because of a missing compile
+  // command or a driver error) have no status yet.
+  {
+    const auto statuses = index_statuses();
+    for (const std::string& path : absolute_paths) {
+      if (statuses.count(path) != 0)
+        continue;
+      TranslationUnitStatus& status = result.translation_units.emplace_back();
+      status.file = path;
+      status.status = TranslationUnitStatus::Kind::Failed;
+      status.diagnostics.push_back("could not create a compiler invocation");
+    }
+  }
+
+  for (const std::vector<std::string>& retry_args : config.retry_args) {
+    if (IsCancelled(config))
+      break;
+
+    const auto statuses = index_statuses();
+    std::vector<std::string> failed_paths;
+    for (std::size_t i = 0; i < source_paths.size(); ++i) {
+      const auto it = statuses.find(absolute_paths[i]);
+      if (it != statuses.end() && IsFailed(result.translation_units[it->second]))
+        failed_paths.push_back(source_paths[i]);
+    }
+    if (failed_paths.empty())
+      break;
+
+    std::vector<std::string> tool_args = args;
+    llvm::append_range(tool_args, retry_args);
+
+    std::vector<TranslationUnitStatus> retry_statuses;
+    ParseRecordActionFactory retry_factory{*context, retry_statuses, variant};
+    MakeTool(compilations, failed_paths, tool_args, fs, files)->run(&retry_factory);
+
+    for (const TranslationUnitStatus& retry_status : retry_statuses) {
+      const auto it = statuses.find(retry_status.file);
+      if (it == statuses.end())
+        continue;
+      TranslationUnitStatus& status = result.translation_units[it->second];
+      ++status.num_attempts;
+      if (!IsFailed(retry_status)) {
+        status.status = TranslationUnitStatus::Kind::Ok;
+        status.retry_args = retry_args;
+      }
+    }
+  }
+
+  CheckTranslationUnits(result, config);
+  return result;
+}
+
 }  // namespace
 
 ParseResult ParseRecords(clang::tooling::ClangTool& tool, const ParseConfig& config) {
   ParseResult result;
   auto context = ParseContext::Make(result, config);
-  ParseRecordActionFactory factory{*context};
-  if (tool.run(&factory) != 0) {
+  ParseRecordActionFactory factory{*context, result.translation_units, {}};
+  // Translation units that fail to compile are reported in the result.
+  if (tool.run(&factory) != 0 && llvm::none_of(result.translation_units, IsFailed))
     result.AddErrorContext("failed to run tool");
-  }
+  CheckTranslationUnits(result, config);
   return result;
 }
 
 ParseResult ParseRecords(std::string_view build_dir, std::span<const std::string> source_files,
                          const ParseConfig& config) {
   std::string compilation_db_error;
-  auto compilation_db =
-      clang::tooling::CompilationDatabase::loadFromDirectory(build_dir, compilation_db_error);
+  auto compilation_db = LoadIndexedCompilationDatabase(build_dir, compilation_db_error);
   if (!compilation_db) {
     return ParseResult::Fail("failed to create compilation database: " + compilation_db_error);
   }
 
-  clang::tooling::ClangTool tool{*compilation_db, {source_files.data(), source_files.size()}};
-  return ParseRecords(tool, config);
+  return ParseRecords(*compilation_db, source_files, {}, config);
+}
+
+ParseResult ParseRecords(const clang::tooling::CompilationDatabase& compilations,
+                         std::span<const std::string> source_files,
+                         std::span<const ParseVariant> variants, const ParseConfig& config) {
+  // Compile commands are needed for grouping and for every variant: only decode them once.
+  const auto cached_compilations = MakeCachingCompilationDatabase(compilations);
+
+  // Translation units with the same flags are processed together to make preamble reuse
+  // more likely.
+  const std::vector<std::string> source_paths =
+      config.share_preambles ? GroupByCompileFlags(*cached_compilations, source_files)
+                             : std::vector<std::string>(source_files.begin(), source_files.end());
+
+  // Share the file manager between tools so that files are only read and stat'ed once.
+  const auto fs = llvm::vfs::getRealFileSystem();
+  llvm::IntrusiveRefCntPtr<clang::FileManager> files{
+      new clang::FileManager(clang::FileSystemOptions(), fs)};
+
+  if (variants.empty())
+    return ParseWithRetries(*cached_compilations, source_paths, {}, fs, files, {}, config);
+
+  ParseResult result;
+  result.inline_empty_structs = config.inline_empty_structs;
+  std::vector<std::string> errors;
+
+  for (std::size_t i = 0; i < variants.size() && !IsCancelled(config); ++i) {
+    const ParseVariant& variant = variants[i];
+
+    ParseResult variant_result = ParseWithRetries(*cached_compilations, source_paths,
+                                                  variant.args, fs, files, variant.name, config);
+    if (!variant_result)
+      errors.push_back(variant.name + ": " + variant_result.error);
+
+    for (TranslationUnitStatus& status : variant_result.translation_units) {
+      status.variant = variant.name;
+      result.translation_units.emplace_back(std::move(status));
+    }
+
+    for (LayoutConflict& conflict : variant_result.layout_conflicts) {
+      conflict.name = fmt::format("{} [{}]", conflict.name, variant.name);
+      result.layout_conflicts.emplace_back(std::move(conflict));
+    }
+
+    if (i == 0) {
+      result.enums = std::move(variant_result.enums);
+      result.records = std::move(variant_result.records);
+      result.variant_name = variant.name;
+    } else {
+      result.variants.emplace_back(
+          MakeVariantResult(variant.name, result, std::move(variant_result)));
+    }
+  }
+
+  result.error = IsCancelled(config) ? CancelledError : llvm::join(errors, "; ");
+  return result;
+}
+
+ParseVariantResult MakeVariantResult(std::string name, const ParseResult& main,
+                                     ParseResult&& variant) {
+  ParseVariantResult result;
+  result.name = std::move(name);
+
+  const TypeIndex main_index{main};
+  const TypeIndex variant_index{variant};
+
+  for (Enum& enum_def : variant.enums) {
+    const Enum* main_enum = main_index.FindEnum(enum_def.name);
+    if (!main_enum || !HaveSameLayout(*main_enum, enum_def))
+      result.enums.emplace_back(std::move(enum_def));
+  }
+
+  for (const Record& record : main.records) {
+    if (!variant_index.FindRecord(record.name))
+      result.missing_records.push_back(record.name);
+  }
+
+  for (Record& record : variant.records) {
+    const Record* main_record = main_index.FindRecord(record.name);
+    if (!main_record || !HaveSameLayout(*main_record, record))
+      result.records.emplace_back(std::move(record));
+  }
+
+  return result;
+}
+
+ParseResult ParseRecordsFromCode(std::string_view code, std::span<const std::string> args,
+                                 std::span<const VirtualFile> virtual_files,
+                                 const ParseConfig& config) {
+  clang::tooling::FileContentMappings mappings;
+  mappings.reserve(virtual_files.size());
+  for (const VirtualFile& file : virtual_files)
+    mappings.emplace_back(file.path, file.contents);
+
+  ParseResult result;
+  auto context = ParseContext::Make(result, config);
+  const bool ok = clang::tooling::runToolOnCodeWithArgs(
+      std::make_unique<ParseRecordAction>(*context), llvm::StringRef(code.data(), code.size()),
+      std::vector<std::string>(args.begin(), args.end()), "input.cc", "classgen",
+      std::make_shared<clang::PCHContainerOperations>(), mappings);
+  if (IsCancelled(config))
+    result.error = CancelledError;
+  else if (!ok)
+    result.AddErrorContext("failed to parse code");
+  return result;
 }
 
 }  // namespace classgen
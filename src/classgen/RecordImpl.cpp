@@ -9,12 +9,16 @@
 #include <clang/AST/PrettyPrinter.h>
 #include <clang/AST/RecordLayout.h>
 #include <clang/AST/VTableBuilder.h>
+#include <clang/Basic/SourceManager.h>
 #include <clang/Basic/Thunk.h>
 #include <fmt/format.h>
+#include <limits>
+#include <llvm/ADT/Hashing.h>
 #include <llvm/ADT/STLExtras.h>
 #include <llvm/ADT/SmallVector.h>
-#include <llvm/ADT/StringSet.h>
+#include <llvm/ADT/StringMap.h>
 #include "classgen/ComplexType.h"
+#include "classgen/Layout.h"
 #include "classgen/Record.h"
 
 namespace classgen {
@@ -345,7 +349,9 @@ std::unique_ptr<VTable> ParseVTable(const clang::CXXRecordDecl* D) {
 class ParseContextImpl final : public ParseContext {
 public:
   explicit ParseContextImpl(ParseResult& result, const ParseConfig& config)
-      : ParseContext(result, config) {}
+      : ParseContext(result, config) {
+    result.inline_empty_structs = config.inline_empty_structs;
+  }
 
   void HandleEnumDecl(clang::EnumDecl* D) override {
     D = D->getDefinition();
@@ -380,17 +386,64 @@ public:
     if (!CanProcess(D))
       return;
 
+    if (ShouldInlineEmptyRecord(D))
+      return;
+
+    const std::size_t record_idx = m_result.records.size();
+    ParseRecord(m_result.records.emplace_back(), D);
+
+    if (m_config.check_layout_conflicts) {
+      ProcessedType& processed = m_processed[m_result.records[record_idx].name];
+      processed.record_idx = record_idx;
+      processed.fingerprint = GetLayoutFingerprint(D);
+    }
+  }
+
+  void BeginTranslationUnit() override {
+    m_checkpoint.num_enums = m_result.enums.size();
+    m_checkpoint.num_records = m_result.records.size();
+    m_checkpoint.num_layout_conflicts = m_result.layout_conflicts.size();
+    m_checkpoint.new_types.clear();
+  }
+
+  void DiscardTranslationUnit() override {
+    m_result.enums.erase(m_result.enums.begin() + m_checkpoint.num_enums, m_result.enums.end());
+    m_result.records.erase(m_result.records.begin() + m_checkpoint.num_records,
+                           m_result.records.end());
+    m_result.layout_conflicts.erase(
+        m_result.layout_conflicts.begin() + m_checkpoint.num_layout_conflicts,
+        m_result.layout_conflicts.end());
+    for (const std::string& name : m_checkpoint.new_types)
+      m_processed.erase(name);
+    m_checkpoint.new_types.clear();
+  }
+
+private:
+  struct Checkpoint {
+    std::size_t num_enums{};
+    std::size_t num_records{};
+    std::size_t num_layout_conflicts{};
+    /// Names of the types that have been processed since the checkpoint.
+    std::vector<std::string> new_types;
+  };
+
+  struct ProcessedType {
+    /// [Layout conflict checks] Index into ParseResult::records.
+    std::size_t record_idx = std::numeric_limits<std::size_t>::max();
+    /// [Layout conflict checks] Index into m_translation_units.
+    std::size_t translation_unit_idx{};
+    llvm::hash_code fingerprint{};
+    /// [Layout conflict checks] Fingerprints of conflicting layouts that have been reported.
+    llvm::SmallVector<llvm::hash_code, 1> reported_fingerprints;
+  };
+
+  void ParseRecord(Record& record, const clang::RecordDecl* D) {
     auto* CXXRD = dyn_cast<clang::CXXRecordDecl>(D);
 
     const clang::ASTContext& ctx = D->getASTContext();
     const clang::PrintingPolicy policy{D->getLangOpts()};
     const clang::ASTRecordLayout& layout = ctx.getASTRecordLayout(D);
 
-    if (ShouldInlineEmptyRecord(D))
-      return;
-
-    Record& record = m_result.records.emplace_back();
-
     record.is_anonymous = D->isAnonymousStructOrUnion();
     record.kind = [&] {
       switch (D->getTagKind()) {
@@ -411,13 +464,81 @@ public:
     record.data_size = layout.getDataSize().getQuantity();
     record.alignment = layout.getAlignment().getQuantity();
 
+    const clang::SourceManager& source_manager = ctx.getSourceManager();
+    record.source_file =
+        source_manager.getFilename(source_manager.getExpansionLoc(D->getLocation())).str();
+
     AddFields(record, clang::CharUnits::Zero(), D, layout, policy);
 
     if (CXXRD)
       record.vtable = ParseVTable(CXXRD);
   }
 
-private:
+  /// Computes a hash of the layout of a record without fully parsing it.
+  static llvm::hash_code GetLayoutFingerprint(const clang::RecordDecl* D) {
+    const clang::ASTContext& ctx = D->getASTContext();
+    const clang::ASTRecordLayout& layout = ctx.getASTRecordLayout(D);
+
+    llvm::hash_code hash =
+        llvm::hash_combine(layout.getSize().getQuantity(), layout.getDataSize().getQuantity(),
+                           layout.getAlignment().getQuantity());
+
+    if (const auto* CXXRD = dyn_cast<clang::CXXRecordDecl>(D)) {
+      hash = llvm::hash_combine(hash, CXXRD->isDynamicClass(),
+                                layout.getPrimaryBase() != nullptr);
+
+      for (const clang::CXXBaseSpecifier& base : CXXRD->bases()) {
+        const auto* base_decl = base.getType()->getAsCXXRecordDecl();
+        if (base_decl && !base.isVirtual())
+          hash = llvm::hash_combine(hash, layout.getBaseClassOffset(base_decl).getQuantity());
+      }
+
+      for (const clang::CXXBaseSpecifier& base : CXXRD->vbases()) {
+        const auto* base_decl = base.getType()->getAsCXXRecordDecl();
+        if (base_decl)
+          hash = llvm::hash_combine(hash, layout.getVBaseClassOffset(base_decl).getQuantity());
+      }
+    }
+
+    for (const clang::FieldDecl* field_decl : D->fields()) {
+      hash = llvm::hash_combine(hash, layout.getFieldOffset(field_decl->getFieldIndex()),
+                                field_decl->getName(), ctx.getTypeSize(field_decl->getType()),
+                                field_decl->isBitField() ? field_decl->getBitWidthValue(ctx) : 0);
+    }
+
+    return hash;
+  }
+
+  void CheckLayoutConflict(const clang::RecordDecl* D, ProcessedType& processed) {
+    if (processed.record_idx >= m_result.records.size())
+      return;
+
+    const llvm::hash_code fingerprint = GetLayoutFingerprint(D);
+    if (fingerprint == processed.fingerprint ||
+        llvm::is_contained(processed.reported_fingerprints, fingerprint)) {
+      return;
+    }
+    processed.reported_fingerprints.push_back(fingerprint);
+
+    // Only conflicting layouts are fully parsed.
+    Record other;
+    ParseRecord(other, D);
+
+    const Record& record = m_result.records[processed.record_idx];
+    LayoutConflict& conflict = m_result.layout_conflicts.emplace_back();
+    conflict.name = record.name;
+    conflict.first.translation_unit = m_translation_units[processed.translation_unit_idx];
+    conflict.first.description = DescribeLayout(record);
+    conflict.second.translation_unit = m_translation_unit;
+    conflict.second.description = DescribeLayout(other);
+  }
+
+  std::size_t GetTranslationUnitIdx() {
+    if (m_translation_units.empty() || m_translation_units.back() != m_translation_unit)
+      m_translation_units.push_back(m_translation_unit);
+    return m_translation_units.size() - 1;
+  }
+
   bool CanProcess(const clang::TagDecl* D) {
     if (!D)
       return false;
@@ -438,10 +559,18 @@ private:
     const clang::PrintingPolicy policy{D->getLangOpts()};
     const auto name = ctx.getTypeDeclType(D).getAsString(policy);
 
-    if (m_processed.contains(name))
+    const auto [it, inserted] = m_processed.try_emplace(name);
+    if (!inserted) {
+      if (m_config.check_layout_conflicts) {
+        if (const auto* RD = dyn_cast<clang::RecordDecl>(D))
+          CheckLayoutConflict(RD, it->second);
+      }
       return false;
+    }
 
-    m_processed.insert(name);
+    m_checkpoint.new_types.push_back(name);
+    if (m_config.check_layout_conflicts)
+      it->second.translation_unit_idx = GetTranslationUnitIdx();
     return true;
   }
 
@@ -529,13 +658,13 @@ private:
                       const clang::ASTRecordLayout& layout, const clang::PrintingPolicy& policy) {
     clang::ASTContext& ctx = D->getASTContext();
 
-    uint64_t field_idx = 0;
     for (const clang::FieldDecl* field_decl : D->fields()) {
       // Unnamed bitfields are not members.
       if (field_decl->isUnnamedBitfield())
         continue;
 
-      const auto rel_offset_in_bits = layout.getFieldOffset(field_idx++);
+      // Unnamed bitfields have a field index too.
+      const auto rel_offset_in_bits = layout.getFieldOffset(field_decl->getFieldIndex());
       const auto offset =
           base_offset + ctx.toCharUnitsFromBits(static_cast<int64_t>(rel_offset_in_bits));
 
@@ -545,6 +674,9 @@ private:
           Field& field = record.fields.emplace_back();
           field.offset = offset.getQuantity();
           field.data = Field::MemberVariable{
+              .size = static_cast<std::size_t>(
+                  ctx.getTypeSizeInChars(field_decl->getType()).getQuantity()),
+              .alignment = static_cast<std::size_t>(ctx.getDeclAlign(field_decl).getQuantity()),
               .type = TranslateToComplexType(ctx.getTypeDeclType(field_record), ctx, policy),
               .type_name = ctx.getTypeDeclType(field_record).getAsString(policy),
               .name = field_decl->getNameAsString(),
@@ -557,6 +689,13 @@ private:
       field.offset = offset.getQuantity();
       field.data = Field::MemberVariable{
           .bitfield_width = field_decl->isBitField() ? field_decl->getBitWidthValue(ctx) : 0,
+          .bitfield_offset =
+              field_decl->isBitField()
+                  ? static_cast<unsigned int>(rel_offset_in_bits % ctx.getCharWidth())
+                  : 0,
+          .size = static_cast<std::size_t>(
+              ctx.getTypeSizeInChars(field_decl->getType()).getQuantity()),
+          .alignment = static_cast<std::size_t>(ctx.getDeclAlign(field_decl).getQuantity()),
           .type = TranslateToComplexType(field_decl->getType(), ctx, policy),
           .type_name = field_decl->getType().getCanonicalType().getAsString(policy),
           .name = field_decl->getNameAsString(),
@@ -595,7 +734,10 @@ private:
            !CXXRD->hasDirectFields();
   }
 
-  llvm::StringSet<> m_processed;
+  llvm::StringMap<ProcessedType> m_processed;
+  Checkpoint m_checkpoint;
+  /// [Layout conflict checks] Names of the translation units that have been seen so far.
+  std::vector<std::string> m_translation_units;
 };
 
 }  // namespace
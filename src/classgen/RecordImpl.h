@@ -4,6 +4,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 
 namespace clang {
 class ASTContext;
@@ -26,6 +27,16 @@ public:
   virtual void HandleRecordDecl(clang::RecordDecl* D) = 0;
 
   ParseResult& GetResult() const { return m_result; }
+  const ParseConfig& GetConfig() const { return m_config; }
+
+  /// Must be called before any declaration from a new translation unit is handled.
+  void SetTranslationUnit(std::string name) { m_translation_unit = std::move(name); }
+
+  /// Must be called before a translation unit is parsed, so that its types can be discarded
+  /// if it fails to compile.
+  virtual void BeginTranslationUnit() = 0;
+  /// Removes the types that have been added since the last call to BeginTranslationUnit.
+  virtual void DiscardTranslationUnit() = 0;
 
 protected:
   explicit ParseContext(ParseResult& result, const ParseConfig& config)
@@ -33,6 +44,7 @@ protected:
 
   ParseResult& m_result;
   const ParseConfig& m_config;
+  std::string m_translation_unit;
 };
 
 }  // namespace classgen
@@ -0,0 +1,83 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/VTableLayout.h"
+
+namespace classgen {
+
+std::vector<VTableGroup> GetVTableGroups(const VTable& vtable) {
+  std::vector<VTableGroup> groups;
+  bool has_offset_to_top = false;
+
+  const auto start_group = [&](std::size_t idx) {
+    if (!groups.empty())
+      groups.back().end = idx;
+    groups.emplace_back().begin = idx;
+    has_offset_to_top = false;
+  };
+
+  for (std::size_t idx = 0; idx < vtable.components.size(); ++idx) {
+    const VTableComponent& component = vtable.components[idx];
+
+    // vcall and vbase offsets precede the offset to top, so they always begin a new group
+    // unless they follow other offsets.
+    if (std::holds_alternative<VTableComponent::VCallOffset>(component.data)) {
+      if (groups.empty() || has_offset_to_top)
+        start_group(idx);
+      ++groups.back().num_vcall_offsets;
+      continue;
+    }
+
+    if (std::holds_alternative<VTableComponent::VBaseOffset>(component.data)) {
+      if (groups.empty() || has_offset_to_top)
+        start_group(idx);
+      ++groups.back().num_vbase_offsets;
+      continue;
+    }
+
+    if (const auto* offset = std::get_if<VTableComponent::OffsetToTop>(&component.data)) {
+      if (groups.empty() || has_offset_to_top)
+        start_group(idx);
+      groups.back().offset_to_top = offset->offset;
+      has_offset_to_top = true;
+      continue;
+    }
+
+    if (GetFunctionPointer(component)) {
+      if (groups.empty())
+        start_group(idx);
+      groups.back().functions.push_back(&component);
+    }
+  }
+
+  if (!groups.empty())
+    groups.back().end = vtable.components.size();
+
+  return groups;
+}
+
+const VTableComponent::FunctionPointer* GetFunctionPointer(const VTableComponent& component) {
+  if (const auto* func = std::get_if<VTableComponent::FunctionPointer>(&component.data))
+    return func;
+  if (const auto* dtor = std::get_if<VTableComponent::CompleteDtorPointer>(&component.data))
+    return dtor;
+  if (const auto* dtor = std::get_if<VTableComponent::DeletingDtorPointer>(&component.data))
+    return dtor;
+  return nullptr;
+}
+
+bool IsDestructor(const VTableComponent& component) {
+  return std::holds_alternative<VTableComponent::CompleteDtorPointer>(component.data) ||
+         std::holds_alternative<VTableComponent::DeletingDtorPointer>(component.data);
+}
+
+std::string_view GetImplementationKey(const VTableComponent::FunctionPointer& func) {
+  const std::string_view repr = func.repr;
+  return repr.substr(0, repr.find(" ["));
+}
+
+bool IsPureVirtual(const VTableComponent::FunctionPointer& func) {
+  return func.repr.find(" [pure]") != std::string::npos;
+}
+
+}  // namespace classgen
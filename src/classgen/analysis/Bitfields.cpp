@@ -0,0 +1,170 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/Bitfields.h"
+#include <algorithm>
+#include <tuple>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/raw_ostream.h>
+#include "classgen/Layout.h"
+
+namespace classgen {
+
+namespace {
+
+using Run = BitfieldReport::Run;
+using Entry = BitfieldReport::Entry;
+
+/// Returns the end offset of the storage unit that contains a bitfield member.
+std::size_t GetBitfieldStorageEnd(const Field& field) {
+  const auto& member = std::get<Field::MemberVariable>(field.data);
+  const std::size_t end_bit =
+      field.offset * CharBit + member.bitfield_offset + member.bitfield_width;
+  return llvm::alignTo(llvm::divideCeil(end_bit, CharBit), std::max<std::size_t>(member.size, 1));
+}
+
+std::vector<Run> BuildRuns(const Record& record) {
+  std::vector<Run> runs;
+  bool in_run = false;
+
+  for (std::size_t i = 0; i < record.fields.size(); ++i) {
+    const Field& field = record.fields[i];
+    const auto* member = std::get_if<Field::MemberVariable>(&field.data);
+    if (!member || member->bitfield_width == 0) {
+      in_run = false;
+      continue;
+    }
+
+    if (!in_run) {
+      Run& run = runs.emplace_back();
+      run.offset = field.offset;
+      // Storage extends up to the next field that is not part of this run. The last run ends
+      // with the storage unit of its last bitfield (not at the end of the record, which can
+      // include padding).
+      std::size_t end = 0;
+      bool is_last_run = true;
+      for (std::size_t j = i + 1; j < record.fields.size(); ++j) {
+        const auto* next = std::get_if<Field::MemberVariable>(&record.fields[j].data);
+        if (!next || next->bitfield_width == 0) {
+          end = record.fields[j].offset;
+          is_last_run = false;
+          break;
+        }
+      }
+      if (is_last_run) {
+        for (std::size_t j = i; j < record.fields.size(); ++j)
+          end = std::max(end, GetBitfieldStorageEnd(record.fields[j]));
+        end = std::min(end, record.data_size);
+      }
+      run.storage_size = end > run.offset ? end - run.offset : 0;
+      in_run = true;
+    }
+
+    Run& run = runs.back();
+    run.members.push_back(member->name);
+    run.unit_size = std::max(run.unit_size, member->size);
+    run.bits_used += member->bitfield_width;
+  }
+
+  for (Run& run : runs) {
+    // The storage size can be 0 for broken or truncated dumps.
+    run.storage_size =
+        std::max<std::size_t>(run.storage_size, llvm::divideCeil(run.bits_used, CharBit));
+    run.bits_wasted = run.storage_size * CharBit - run.bits_used;
+    run.narrowed_size = GetSizeForBits(run.bits_used);
+  }
+
+  return runs;
+}
+
+Entry ComputeEntry(const Record& record, std::vector<Run> runs) {
+  Entry entry;
+  entry.record_name = record.name;
+  entry.record_size = record.size;
+  entry.is_split = runs.size() > 1;
+
+  std::size_t storage_size = 0;
+  for (const Run& run : runs) {
+    entry.bits_used += run.bits_used;
+    entry.bits_wasted += run.bits_wasted;
+    storage_size += run.storage_size;
+
+    // Narrowing only helps if the declared type is wider than what the bits require.
+    if (run.unit_size > run.narrowed_size)
+      entry.narrowing_savings += std::min(run.unit_size, run.storage_size) - run.narrowed_size;
+  }
+
+  if (entry.is_split) {
+    const std::size_t merged_size = GetSizeForBits(entry.bits_used);
+    entry.merge_savings = storage_size > merged_size ? storage_size - merged_size : 0;
+  }
+
+  entry.runs = std::move(runs);
+  return entry;
+}
+
+}  // namespace
+
+BitfieldReport AnalyzeBitfields(const ParseResult& result, const BitfieldOptions& options) {
+  BitfieldReport report;
+
+  for (const Record& record : result.records) {
+    // Union members all start at offset 0 and do not form runs.
+    if (record.kind == Record::Kind::Union)
+      continue;
+
+    auto runs = BuildRuns(record);
+    if (runs.empty())
+      continue;
+
+    Entry entry = ComputeEntry(record, std::move(runs));
+    ++report.num_records;
+    report.num_runs += entry.runs.size();
+    report.total_bits_used += entry.bits_used;
+    report.total_bits_wasted += entry.bits_wasted;
+    report.entries.emplace_back(std::move(entry));
+  }
+
+  llvm::stable_sort(report.entries, [](const Entry& lhs, const Entry& rhs) {
+    const auto lhs_savings = std::max(lhs.merge_savings, lhs.narrowing_savings);
+    const auto rhs_savings = std::max(rhs.merge_savings, rhs.narrowing_savings);
+    return std::tie(rhs_savings, rhs.bits_wasted, lhs.record_name) <
+           std::tie(lhs_savings, lhs.bits_wasted, rhs.record_name);
+  });
+
+  if (options.max_entries != 0 && report.entries.size() > options.max_entries)
+    report.entries.resize(options.max_entries);
+
+  return report;
+}
+
+void PrintBitfieldReport(llvm::raw_ostream& os, const BitfieldReport& report) {
+  os << fmt::format("bitfield packing: {} records, {} runs, {} bits used, {} bits wasted\n",
+                    report.num_records, report.num_runs, report.total_bits_used,
+                    report.total_bits_wasted);
+
+  for (const Entry& entry : report.entries) {
+    os << fmt::format("\n  {} (size {:#x}): {} run{}, {} bits used, {} bits wasted{}\n",
+                      entry.record_name, entry.record_size, entry.runs.size(),
+                      entry.runs.size() == 1 ? "" : "s", entry.bits_used, entry.bits_wasted,
+                      entry.is_split ? " [split by other members]" : "");
+
+    for (const Run& run : entry.runs) {
+      os << fmt::format("    [{:#x}] unit {} storage {} used {:>3}/{:<3} bits  {}\n", run.offset,
+                        run.unit_size, run.storage_size, run.bits_used,
+                        run.storage_size * CharBit, llvm::join(run.members, ", "));
+    }
+
+    if (entry.merge_savings != 0)
+      os << fmt::format("    merging runs would save up to {} bytes\n", entry.merge_savings);
+    if (entry.narrowing_savings != 0) {
+      os << fmt::format("    narrowing declared types would save up to {} bytes\n",
+                        entry.narrowing_savings);
+    }
+  }
+}
+
+}  // namespace classgen
@@ -0,0 +1,256 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/Devirtualization.h"
+#include <map>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Support/raw_ostream.h>
+#include "classgen/VTableLayout.h"
+
+namespace classgen {
+
+namespace {
+
+class DevirtualizationAnalyzer {
+public:
+  DevirtualizationAnalyzer(const TypeIndex& index, const CountTable* call_counts,
+                           const DevirtualizationOptions& options)
+      : m_index(index), m_hierarchy(index), m_options(options) {
+    if (!call_counts)
+      return;
+
+    m_report.has_call_counts = true;
+    for (const CountTable::Entry& entry : call_counts->entries) {
+      m_calls[{entry.name, entry.member}] += entry.count;
+      m_report.total_calls += entry.count;
+    }
+  }
+
+  DevirtualizationReport Analyze() {
+    for (const Record& record : m_index.GetResult().records) {
+      if (!record.vtable)
+        continue;
+
+      FindNeverOverriddenFunctions(record);
+
+      const bool is_abstract = IsAbstract(record);
+      if (is_abstract)
+        FindSingleImplementation(record);
+
+      if (!is_abstract && m_hierarchy.GetDerivedRecords(record).empty())
+        m_report.final_candidates.push_back(record.name);
+    }
+
+    llvm::stable_sort(m_report.never_overridden, [](const auto& lhs, const auto& rhs) {
+      return std::tie(rhs.calls, lhs.record_name, lhs.repr) <
+             std::tie(lhs.calls, rhs.record_name, rhs.repr);
+    });
+    llvm::stable_sort(m_report.single_implementations, [](const auto& lhs, const auto& rhs) {
+      return std::tie(rhs.calls, lhs.record_name) < std::tie(lhs.calls, rhs.record_name);
+    });
+    llvm::sort(m_report.final_candidates);
+
+    return std::move(m_report);
+  }
+
+private:
+  const std::vector<VTableGroup>& GetGroups(const Record& record) {
+    auto it = m_groups.find(&record);
+    if (it == m_groups.end())
+      it = m_groups.emplace(&record, GetVTableGroups(*record.vtable)).first;
+    return it->second;
+  }
+
+  const VTableGroup* FindGroup(const Record& record, std::int64_t offset_to_top) {
+    if (!record.vtable)
+      return nullptr;
+    for (const VTableGroup& group : GetGroups(record)) {
+      if (group.offset_to_top == offset_to_top)
+        return &group;
+    }
+    return nullptr;
+  }
+
+  bool IsAbstract(const Record& record) {
+    return llvm::any_of(record.vtable->components, [](const VTableComponent& component) {
+      const auto* func = GetFunctionPointer(component);
+      return func && IsPureVirtual(*func);
+    });
+  }
+
+  std::uint64_t GetCalls(const std::string& record_name, const std::string& function_name) const {
+    const auto it = m_calls.find({record_name, function_name});
+    return it == m_calls.end() ? 0 : it->second;
+  }
+
+  bool IsHot(std::uint64_t calls) const {
+    return calls != 0 &&
+           double(calls) >= m_options.hot_call_fraction * double(m_report.total_calls);
+  }
+
+  /// Returns the number of primary vtable slots that are inherited from the primary base.
+  std::size_t GetNumInheritedSlots(const Record& record) {
+    for (const Field& field : record.fields) {
+      const auto* base = std::get_if<Field::Base>(&field.data);
+      if (!base || !base->is_primary)
+        continue;
+      const Record* base_record = m_index.FindRecord(base->type_name);
+      if (!base_record || !base_record->vtable)
+        return 0;
+      const auto& groups = GetGroups(*base_record);
+      return groups.empty() ? 0 : groups.front().functions.size();
+    }
+    return 0;
+  }
+
+  void FindNeverOverriddenFunctions(const Record& record) {
+    const auto& groups = GetGroups(record);
+    if (groups.empty())
+      return;
+
+    // Functions that override functions from secondary bases also get a slot in the primary
+    // vtable, so they must be ignored.
+    std::unordered_set<std::string_view> secondary_keys;
+    for (const VTableGroup& group : llvm::drop_begin(groups)) {
+      for (const VTableComponent* component : group.functions)
+        secondary_keys.insert(GetImplementationKey(*GetFunctionPointer(*component)));
+    }
+
+    // Slot index -> whether the slot has been overridden.
+    std::map<std::size_t, bool> slots;
+    const VTableGroup& primary = groups.front();
+    for (std::size_t i = GetNumInheritedSlots(record); i < primary.functions.size(); ++i) {
+      const VTableComponent& component = *primary.functions[i];
+      const auto& func = *GetFunctionPointer(component);
+      if (IsDestructor(component) || IsPureVirtual(func) ||
+          secondary_keys.contains(GetImplementationKey(func))) {
+        continue;
+      }
+      slots.emplace(i, false);
+    }
+
+    if (slots.empty())
+      return;
+
+    // Walk derived records and compare their entries with ours. Derived records are visited
+    // together with the offset to top of the vtable that corresponds to this record.
+    std::set<std::pair<const Record*, std::int64_t>> visited;
+    std::vector<std::pair<const Record*, std::int64_t>> stack{{&record, 0}};
+    while (!stack.empty()) {
+      const auto [current, offset_to_top] = stack.back();
+      stack.pop_back();
+
+      for (const ClassHierarchy::Derived& derived : m_hierarchy.GetDerivedRecords(*current)) {
+        const auto derived_offset_to_top =
+            offset_to_top - static_cast<std::int64_t>(derived.base_field->offset);
+        if (!visited.emplace(derived.record, derived_offset_to_top).second)
+          continue;
+
+        const VTableGroup* group = FindGroup(*derived.record, derived_offset_to_top);
+        if (!group)
+          continue;
+
+        for (auto& [i, overridden] : slots) {
+          if (overridden || i >= group->functions.size())
+            continue;
+          const auto& ours = *GetFunctionPointer(*primary.functions[i]);
+          const auto& theirs = *GetFunctionPointer(*group->functions[i]);
+          overridden = GetImplementationKey(ours) != GetImplementationKey(theirs);
+        }
+
+        // Offsets of virtual bases do not add up along a path. Records that derive from this
+        // one are visited directly from the virtual base, since every record lists all of its
+        // (direct and indirect) virtual bases.
+        if (std::get<Field::Base>(derived.base_field->data).is_virtual)
+          continue;
+
+        stack.emplace_back(derived.record, derived_offset_to_top);
+      }
+    }
+
+    for (const auto& [i, overridden] : slots) {
+      if (overridden)
+        continue;
+      const auto& func = *GetFunctionPointer(*primary.functions[i]);
+      DevirtualizationReport::Function& entry = m_report.never_overridden.emplace_back();
+      entry.record_name = record.name;
+      entry.function_name = func.function_name;
+      entry.repr = std::string(GetImplementationKey(func));
+      entry.calls = GetCalls(record.name, func.function_name);
+      entry.is_hot = IsHot(entry.calls);
+    }
+  }
+
+  void FindSingleImplementation(const Record& record) {
+    const Record* implementation = nullptr;
+    for (const Record* derived : m_hierarchy.GetAllDerivedRecords(record)) {
+      if (!derived->vtable || IsAbstract(*derived))
+        continue;
+      if (implementation)
+        return;
+      implementation = derived;
+    }
+
+    if (!implementation)
+      return;
+
+    DevirtualizationReport::SingleImplementation& entry =
+        m_report.single_implementations.emplace_back();
+    entry.record_name = record.name;
+    entry.implementation_name = implementation->name;
+
+    std::unordered_set<std::string_view> function_names;
+    for (const VTableComponent& component : record.vtable->components) {
+      const auto* func = GetFunctionPointer(component);
+      if (func && !IsDestructor(component) && function_names.insert(func->function_name).second)
+        entry.calls += GetCalls(record.name, func->function_name);
+    }
+    entry.is_hot = IsHot(entry.calls);
+  }
+
+  const TypeIndex& m_index;
+  ClassHierarchy m_hierarchy;
+  const DevirtualizationOptions& m_options;
+  DevirtualizationReport m_report;
+  std::map<std::pair<std::string, std::string>, std::uint64_t> m_calls;
+  std::unordered_map<const Record*, std::vector<VTableGroup>> m_groups;
+};
+
+std::string FormatCalls(const DevirtualizationReport& report, std::uint64_t calls, bool is_hot) {
+  if (!report.has_call_counts)
+    return "";
+  return fmt::format("{:>5} {:>14} calls  ", is_hot ? "[hot]" : "", calls);
+}
+
+}  // namespace
+
+DevirtualizationReport AnalyzeDevirtualization(const TypeIndex& index,
+                                               const CountTable* call_counts,
+                                               const DevirtualizationOptions& options) {
+  return DevirtualizationAnalyzer{index, call_counts, options}.Analyze();
+}
+
+void PrintDevirtualizationReport(llvm::raw_ostream& os, const DevirtualizationReport& report) {
+  os << fmt::format("virtual functions that are never overridden: {}\n",
+                    report.never_overridden.size());
+  for (const auto& entry : report.never_overridden)
+    os << fmt::format("  {}{}\n", FormatCalls(report, entry.calls, entry.is_hot), entry.repr);
+
+  os << fmt::format("\nabstract classes with a single concrete implementation: {}\n",
+                    report.single_implementations.size());
+  for (const auto& entry : report.single_implementations) {
+    os << fmt::format("  {}{} -> {}\n", FormatCalls(report, entry.calls, entry.is_hot),
+                      entry.record_name, entry.implementation_name);
+  }
+
+  os << fmt::format("\nclasses that could be marked final: {}\n", report.final_candidates.size());
+  for (const std::string& name : report.final_candidates)
+    os << "  " << name << '\n';
+}
+
+}  // namespace classgen
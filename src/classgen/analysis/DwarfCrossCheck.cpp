@@ -0,0 +1,173 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/DwarfCrossCheck.h"
+#include <fmt/format.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/raw_ostream.h>
+#include "classgen/VTableLayout.h"
+
+namespace classgen {
+
+namespace {
+
+using Mismatch = DwarfCrossCheckResult::Mismatch;
+
+std::size_t GetBitOffset(const Field& field) {
+  std::size_t offset = field.offset * 8;
+  if (const auto* member = std::get_if<Field::MemberVariable>(&field.data))
+    offset += member->bitfield_offset;
+  return offset;
+}
+
+std::size_t GetNumVTableSlots(const Record& record) {
+  if (!record.vtable)
+    return 0;
+  const auto groups = GetVTableGroups(*record.vtable);
+  return groups.empty() ? 0 : groups.front().functions.size();
+}
+
+class CrossChecker {
+public:
+  CrossChecker(const TypeIndex& source, const TypeIndex& dwarf)
+      : m_source(source), m_dwarf(dwarf) {}
+
+  DwarfCrossCheckResult Check() {
+    for (const Record& record : m_source.GetResult().records) {
+      if (record.is_anonymous)
+        continue;
+
+      const Record* dwarf_record = m_dwarf.FindRecord(record.name);
+      if (!dwarf_record) {
+        ++m_result.num_missing_records;
+        continue;
+      }
+
+      ++m_result.num_checked_records;
+      CheckRecord(record, *dwarf_record);
+    }
+    return std::move(m_result);
+  }
+
+private:
+  void CheckRecord(const Record& record, const Record& dwarf_record) {
+    if (record.size != dwarf_record.size)
+      AddMismatch(Mismatch::Kind::Size, record, {}, record.size, dwarf_record.size);
+
+    m_dwarf_members.clear();
+    m_dwarf_bases.clear();
+    for (const Field& field : dwarf_record.fields) {
+      if (const auto* member = std::get_if<Field::MemberVariable>(&field.data)) {
+        if (!member->name.empty())
+          m_dwarf_members.try_emplace(member->name, &field);
+      } else if (const auto* base = std::get_if<Field::Base>(&field.data)) {
+        if (!base->is_virtual)
+          m_dwarf_bases.try_emplace(base->type_name, &field);
+      }
+    }
+
+    for (const Field& field : record.fields) {
+      const Field* dwarf_field = nullptr;
+      Mismatch::Kind kind{};
+      std::string_view name;
+
+      if (const auto* member = std::get_if<Field::MemberVariable>(&field.data)) {
+        kind = Mismatch::Kind::FieldOffset;
+        name = member->name;
+        if (const auto it = m_dwarf_members.find(name); it != m_dwarf_members.end())
+          dwarf_field = it->second;
+      } else if (const auto* base = std::get_if<Field::Base>(&field.data)) {
+        if (base->is_virtual)
+          continue;
+        kind = Mismatch::Kind::BaseOffset;
+        name = base->type_name;
+        if (const auto it = m_dwarf_bases.find(name); it != m_dwarf_bases.end())
+          dwarf_field = it->second;
+      }
+
+      if (!dwarf_field)
+        continue;
+
+      const std::size_t offset = GetBitOffset(field);
+      const std::size_t dwarf_offset = GetBitOffset(*dwarf_field);
+      if (offset != dwarf_offset)
+        AddMismatch(kind, record, std::string(name), offset, dwarf_offset);
+    }
+
+    if (dwarf_record.vtable && dwarf_record.vtable->is_incomplete) {
+      ++m_result.num_incomplete_vtables;
+      return;
+    }
+
+    const std::size_t num_slots = GetNumVTableSlots(record);
+    const std::size_t dwarf_num_slots = GetNumVTableSlots(dwarf_record);
+    if (num_slots != dwarf_num_slots)
+      AddMismatch(Mismatch::Kind::VTableSlots, record, {}, num_slots, dwarf_num_slots);
+  }
+
+  void AddMismatch(Mismatch::Kind kind, const Record& record, std::string field_name,
+                   std::size_t source_value, std::size_t dwarf_value) {
+    Mismatch& mismatch = m_result.mismatches.emplace_back();
+    mismatch.kind = kind;
+    mismatch.record_name = record.name;
+    mismatch.field_name = std::move(field_name);
+    mismatch.source_value = source_value;
+    mismatch.dwarf_value = dwarf_value;
+  }
+
+  const TypeIndex& m_source;
+  const TypeIndex& m_dwarf;
+  DwarfCrossCheckResult m_result;
+  /// Fields of the record that is being checked, keyed by name (or type name for bases).
+  llvm::StringMap<const Field*> m_dwarf_members;
+  llvm::StringMap<const Field*> m_dwarf_bases;
+};
+
+std::string FormatBitOffset(std::size_t bit_offset) {
+  if (bit_offset % 8 == 0)
+    return fmt::format("{:#x}", bit_offset / 8);
+  return fmt::format("{:#x}:{}", bit_offset / 8, bit_offset % 8);
+}
+
+std::string FormatMismatch(const Mismatch& mismatch) {
+  switch (mismatch.kind) {
+  case Mismatch::Kind::Size:
+    return fmt::format("size {:#x} (DWARF: {:#x})", mismatch.source_value, mismatch.dwarf_value);
+  case Mismatch::Kind::FieldOffset:
+    return fmt::format("field {} at offset {} (DWARF: {})", mismatch.field_name,
+                       FormatBitOffset(mismatch.source_value),
+                       FormatBitOffset(mismatch.dwarf_value));
+  case Mismatch::Kind::BaseOffset:
+    return fmt::format("base {} at offset {} (DWARF: {})", mismatch.field_name,
+                       FormatBitOffset(mismatch.source_value),
+                       FormatBitOffset(mismatch.dwarf_value));
+  case Mismatch::Kind::VTableSlots:
+    return fmt::format("{} vtable slots (DWARF: {})", mismatch.source_value, mismatch.dwarf_value);
+  }
+  return {};
+}
+
+}  // namespace
+
+DwarfCrossCheckResult CrossCheckWithDwarf(const TypeIndex& source, const TypeIndex& dwarf) {
+  return CrossChecker(source, dwarf).Check();
+}
+
+void PrintDwarfCrossCheckResult(llvm::raw_ostream& os, const DwarfCrossCheckResult& result) {
+  const std::string skipped =
+      fmt::format("{} records not in debug info, {} incomplete vtables not checked",
+                  result.num_missing_records, result.num_incomplete_vtables);
+
+  if (result.mismatches.empty()) {
+    os << fmt::format("OK: checked {} records, no mismatches ({})\n", result.num_checked_records,
+                      skipped);
+    return;
+  }
+
+  os << fmt::format("FAILED: {} mismatches in {} checked records ({})\n",
+                    result.mismatches.size(), result.num_checked_records, skipped);
+  for (const Mismatch& mismatch : result.mismatches)
+    os << fmt::format("  {}: {}\n", mismatch.record_name, FormatMismatch(mismatch));
+}
+
+}  // namespace classgen
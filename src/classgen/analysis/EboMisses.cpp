@@ -0,0 +1,153 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/EboMisses.h"
+#include <algorithm>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace classgen {
+
+namespace {
+
+using Miss = EboMissReport::Miss;
+using Entry = EboMissReport::Entry;
+
+class EboMissAnalyzer {
+public:
+  EboMissAnalyzer(const TypeIndex& index, const EboMissOptions& options)
+      : m_index(index), m_options(options) {}
+
+  EboMissReport Analyze() {
+    EboMissReport report;
+    report.empty_records_inlined = m_index.GetResult().inline_empty_structs;
+
+    for (const Record& record : m_index.GetResult().records) {
+      auto entry = AnalyzeRecord(record);
+      if (!entry)
+        continue;
+      report.total_bytes_lost += entry->bytes_lost;
+      report.entries.emplace_back(std::move(*entry));
+    }
+
+    llvm::stable_sort(report.entries, [](const Entry& lhs, const Entry& rhs) {
+      return std::tie(rhs.bytes_lost, lhs.record_name) < std::tie(lhs.bytes_lost, rhs.record_name);
+    });
+
+    if (m_options.max_entries != 0 && report.entries.size() > m_options.max_entries)
+      report.entries.resize(m_options.max_entries);
+
+    return report;
+  }
+
+private:
+  bool IsEmpty(const Record& record) {
+    const auto it = m_is_empty.find(&record);
+    if (it != m_is_empty.end())
+      return it->second;
+    return m_is_empty[&record] = IsEmptyRecord(m_index, record);
+  }
+
+  std::optional<Entry> AnalyzeRecord(const Record& record) {
+    // Unions cannot have bases and their members always overlap.
+    if (record.kind == Record::Kind::Union || IsEmpty(record))
+      return std::nullopt;
+
+    std::vector<std::size_t> offsets;
+    offsets.reserve(record.fields.size());
+    for (const Field& field : record.fields)
+      offsets.push_back(field.offset);
+    llvm::sort(offsets);
+
+    Entry entry;
+    std::size_t total_occupied = 0;
+
+    for (const Field& field : record.fields) {
+      Miss miss;
+      if (const auto* base = std::get_if<Field::Base>(&field.data)) {
+        const Record* base_record = m_index.FindRecord(base->type_name);
+        if (field.offset == 0 || base->is_virtual || !base_record || !IsEmpty(*base_record))
+          continue;
+        miss.type_name = base->type_name;
+      } else if (const auto* member = std::get_if<Field::MemberVariable>(&field.data)) {
+        const EmbeddedRecord embedded = GetEmbeddedRecord(m_index, field);
+        if (!embedded.record || !IsEmpty(*embedded.record))
+          continue;
+        miss.is_member = true;
+        miss.name = member->name;
+        miss.type_name = member->type_name;
+        miss.count = embedded.count;
+      } else {
+        continue;
+      }
+
+      // Subobjects that share their offset with another field do not take up space
+      // (e.g. [[no_unique_address]] members).
+      if (llvm::count(offsets, field.offset) > 1)
+        continue;
+
+      const auto next = llvm::upper_bound(offsets, field.offset);
+      const std::size_t end = next == offsets.end() ? record.size : *next;
+      miss.offset = field.offset;
+      miss.occupied_bytes = end > field.offset ? end - field.offset : 0;
+      total_occupied += miss.occupied_bytes;
+      entry.misses.emplace_back(std::move(miss));
+    }
+
+    if (entry.misses.empty())
+      return std::nullopt;
+
+    // The record can only shrink by multiples of its alignment.
+    const std::size_t remaining = record.size > total_occupied ? record.size - total_occupied : 0;
+    const std::size_t new_size = llvm::alignTo(std::max<std::size_t>(remaining, 1),
+                                               std::max<std::size_t>(record.alignment, 1));
+    entry.bytes_lost = record.size > new_size ? record.size - new_size : 0;
+    if (entry.bytes_lost == 0)
+      return std::nullopt;
+
+    entry.record_name = record.name;
+    entry.size = record.size;
+    return entry;
+  }
+
+  const TypeIndex& m_index;
+  const EboMissOptions& m_options;
+  std::unordered_map<const Record*, bool> m_is_empty;
+};
+
+}  // namespace
+
+EboMissReport AnalyzeEboMisses(const TypeIndex& index, const EboMissOptions& options) {
+  return EboMissAnalyzer{index, options}.Analyze();
+}
+
+void PrintEboMissReport(llvm::raw_ostream& os, const EboMissReport& report) {
+  os << fmt::format("empty subobjects that take up space: {} bytes lost in {} records\n",
+                    report.total_bytes_lost, report.entries.size());
+  if (report.empty_records_inlined) {
+    os << "warning: the type dump was generated with inlined empty records (classgen-dump -i), "
+          "so empty subobjects cannot be detected\n";
+  }
+
+  for (const Entry& entry : report.entries) {
+    os << fmt::format("\n  {} (size {:#x}): {} bytes lost\n", entry.record_name, entry.size,
+                      entry.bytes_lost);
+    for (const Miss& miss : entry.misses) {
+      if (miss.is_member) {
+        os << fmt::format("    [{:#x}] member {} ({}): {} bytes{}\n", miss.offset, miss.name,
+                          miss.type_name, miss.occupied_bytes,
+                          miss.count == 1 ? "" : fmt::format(", {} elements", miss.count));
+      } else {
+        os << fmt::format("    [{:#x}] empty base {} not at offset 0: {} bytes\n", miss.offset,
+                          miss.type_name, miss.occupied_bytes);
+      }
+    }
+  }
+}
+
+}  // namespace classgen
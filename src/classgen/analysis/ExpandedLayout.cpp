@@ -0,0 +1,67 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/ExpandedLayout.h"
+#include <fmt/format.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace classgen {
+
+namespace {
+
+void PrintRecord(llvm::raw_ostream& os, LayoutExpander& expander, const Record& record) {
+  os << fmt::format("{} (size {:#x}, alignment {}):\n", record.name, record.size,
+                    record.alignment);
+
+  for (const ExpandedMember& member : expander.Expand(record)) {
+    std::string type_name;
+    std::string suffix;
+    if (const auto* variable = std::get_if<Field::MemberVariable>(&member.field->data)) {
+      type_name = variable->type_name;
+      if (variable->bitfield_width != 0)
+        suffix = fmt::format(" : {} (bit {})", variable->bitfield_width, variable->bitfield_offset);
+    } else if (std::holds_alternative<Field::Base>(member.field->data)) {
+      type_name = "(base)";
+    } else {
+      type_name = "(vtable pointer)";
+    }
+
+    os << fmt::format("  [{:#x}] {} {}{}{}\n", member.offset, type_name, member.path, suffix,
+                      member.in_virtual_base ? " [virtual base]" : "");
+  }
+}
+
+}  // namespace
+
+bool PrintExpandedLayouts(llvm::raw_ostream& os, const TypeIndex& index,
+                          const ExpandedLayoutOptions& options) {
+  LayoutExpander expander{index};
+  bool ok = true;
+  bool first = true;
+
+  const auto print = [&](const Record& record) {
+    if (!first)
+      os << '\n';
+    first = false;
+    PrintRecord(os, expander, record);
+  };
+
+  if (options.records.empty()) {
+    for (const Record& record : index.GetResult().records)
+      print(record);
+    return ok;
+  }
+
+  for (const std::string& name : options.records) {
+    if (const Record* record = index.FindRecord(name)) {
+      print(*record);
+    } else {
+      os << "unknown record: " << name << '\n';
+      ok = false;
+    }
+  }
+
+  return ok;
+}
+
+}  // namespace classgen
@@ -0,0 +1,291 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/HeapFootprint.h"
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace classgen {
+
+namespace {
+
+struct Item {
+  std::string label;
+  std::size_t offset{};
+  std::size_t size{};
+  EmbeddedRecord embedded;
+  bool is_base = false;
+  /// Virtual bases are only part of the complete object: when a record is a base subobject,
+  /// its virtual bases are placed (and accounted for) by the most derived record.
+  bool is_virtual_base = false;
+};
+
+struct Breakdown {
+  std::vector<Item> items;
+  std::size_t padding{};
+};
+
+std::size_t GetTailPaddingSize(const Record& record) {
+  return record.size > record.data_size ? record.size - record.data_size : 0;
+}
+
+class FootprintBuilder {
+public:
+  FootprintBuilder(const TypeIndex& index, const HeapFootprintOptions& options)
+      : m_index(index), m_options(options) {}
+
+  const Breakdown& GetBreakdown(const Record& record) {
+    if (auto it = m_breakdowns.find(&record); it != m_breakdowns.end())
+      return it->second;
+
+    Breakdown breakdown;
+    const auto extents = GetFieldExtents(m_index, record);
+    breakdown.padding = GetPaddingSize(record, extents);
+
+    for (const FieldExtent& extent : extents) {
+      const Field& field = record.fields[extent.field_idx];
+      Item& item = breakdown.items.emplace_back();
+      item.offset = extent.offset;
+      item.size = extent.size;
+
+      if (const auto* member = std::get_if<Field::MemberVariable>(&field.data)) {
+        item.label = fmt::format("{} ({})", member->name, member->type_name);
+        item.embedded = GetEmbeddedRecord(m_index, field);
+      } else if (const auto* base = std::get_if<Field::Base>(&field.data)) {
+        item.label = fmt::format("{}base {}", base->is_virtual ? "virtual " : "", base->type_name);
+        item.embedded = {m_index.FindRecord(base->type_name), 1};
+        item.is_base = true;
+        item.is_virtual_base = base->is_virtual;
+      } else {
+        item.label = "vtable pointer";
+      }
+    }
+
+    return m_breakdowns.emplace(&record, std::move(breakdown)).first->second;
+  }
+
+  /// Returns the number of padding bytes in a record, including embedded subobjects.
+  std::uint64_t GetRecursivePadding(const Record& record) {
+    const SubobjectPadding& padding = GetSubobjectPadding(record);
+    return GetBreakdown(record).padding + padding.non_virtual + padding.virtual_bases;
+  }
+
+  std::vector<HeapFootprintReport::Node> BuildNodes(const Record& record, std::uint64_t multiplier,
+                                                    std::size_t depth, bool is_base = false) {
+    std::vector<HeapFootprintReport::Node> nodes;
+    const Breakdown& breakdown = GetBreakdown(record);
+
+    for (const Item& item : breakdown.items) {
+      if (is_base && item.is_virtual_base)
+        continue;
+      HeapFootprintReport::Node& node = nodes.emplace_back();
+      node.label = item.label;
+      node.offset = item.offset;
+      node.bytes = multiplier * item.size;
+      if (item.embedded.record && depth + 1 < m_options.max_depth && depth < MaxNestingDepth) {
+        node.children = BuildNodes(*item.embedded.record, multiplier * item.embedded.count,
+                                   depth + 1, item.is_base);
+      }
+    }
+
+    const std::uint64_t padding = is_base ? GetInternalPadding(record) : breakdown.padding;
+    if (padding != 0) {
+      HeapFootprintReport::Node& node = nodes.emplace_back();
+      node.label = "padding";
+      node.is_padding = true;
+      node.bytes = multiplier * padding;
+    }
+
+    return nodes;
+  }
+
+  /// Attributes bytes to a record and (recursively) to all of its embedded subobjects.
+  void AddRecordTotals(const Record& record, std::uint64_t multiplier, std::size_t bytes,
+                       bool is_base, std::size_t depth) {
+    if (depth > MaxNestingDepth)
+      return;
+
+    const Breakdown& breakdown = GetBreakdown(record);
+    auto& entry = m_totals[&record];
+    entry.bytes += multiplier * bytes;
+    entry.padding_bytes += multiplier * (is_base ? GetInternalPadding(record) : breakdown.padding);
+
+    for (const Item& item : breakdown.items) {
+      if (!item.embedded.record || (is_base && item.is_virtual_base))
+        continue;
+      const std::size_t item_bytes = item.is_base ? item.size : item.embedded.record->size;
+      AddRecordTotals(*item.embedded.record, multiplier * item.embedded.count, item_bytes,
+                      item.is_base, depth + 1);
+    }
+  }
+
+  std::vector<HeapFootprintReport::RecordEntry> GetRecordTotals() const {
+    std::vector<HeapFootprintReport::RecordEntry> entries;
+    entries.reserve(m_totals.size());
+    for (const auto& [record, totals] : m_totals)
+      entries.push_back({record->name, totals.bytes, totals.padding_bytes});
+    return entries;
+  }
+
+private:
+  struct Totals {
+    std::uint64_t bytes{};
+    std::uint64_t padding_bytes{};
+  };
+
+  /// Padding bytes in the embedded subobjects of a record.
+  struct SubobjectPadding {
+    std::uint64_t non_virtual{};
+    std::uint64_t virtual_bases{};
+  };
+
+  const SubobjectPadding& GetSubobjectPadding(const Record& record) {
+    static const SubobjectPadding s_empty;
+
+    if (auto it = m_subobject_padding.find(&record); it != m_subobject_padding.end())
+      return it->second;
+
+    if (!m_in_progress.insert(&record).second)
+      return s_empty;
+
+    SubobjectPadding padding;
+    for (const Item& item : GetBreakdown(record).items) {
+      if (!item.embedded.record)
+        continue;
+      (item.is_virtual_base ? padding.virtual_bases : padding.non_virtual) +=
+          item.embedded.count * GetEmbeddedPadding(item);
+    }
+
+    m_in_progress.erase(&record);
+    return m_subobject_padding.emplace(&record, padding).first->second;
+  }
+
+  /// Padding of a record excluding tail padding, which is not part of base subobjects.
+  std::uint64_t GetInternalPadding(const Record& record) {
+    const std::size_t padding = GetBreakdown(record).padding;
+    const std::size_t tail_padding = GetTailPaddingSize(record);
+    return padding > tail_padding ? padding - tail_padding : 0;
+  }
+
+  std::uint64_t GetEmbeddedPadding(const Item& item) {
+    const Record& record = *item.embedded.record;
+    if (!item.is_base)
+      return GetRecursivePadding(record);
+    return GetInternalPadding(record) + GetSubobjectPadding(record).non_virtual;
+  }
+
+  const TypeIndex& m_index;
+  const HeapFootprintOptions& m_options;
+  std::unordered_map<const Record*, Breakdown> m_breakdowns;
+  std::unordered_map<const Record*, SubobjectPadding> m_subobject_padding;
+  std::unordered_set<const Record*> m_in_progress;
+  std::unordered_map<const Record*, Totals> m_totals;
+};
+
+template <typename T>
+void Truncate(std::vector<T>& entries, std::size_t max_entries) {
+  if (max_entries != 0 && entries.size() > max_entries)
+    entries.resize(max_entries);
+}
+
+double GetPercentage(std::uint64_t value, std::uint64_t total) {
+  return total == 0 ? 0.0 : 100.0 * double(value) / double(total);
+}
+
+void PrintNodes(llvm::raw_ostream& os, const std::vector<HeapFootprintReport::Node>& nodes,
+                std::uint64_t parent_bytes, std::size_t depth) {
+  for (const HeapFootprintReport::Node& node : nodes) {
+    const std::string indent(2 * depth + 4, ' ');
+    if (node.is_padding) {
+      os << fmt::format("{}{:>14} {:5.1f}%  padding\n", indent, node.bytes,
+                        GetPercentage(node.bytes, parent_bytes));
+    } else {
+      os << fmt::format("{}{:>14} {:5.1f}%  [{:#x}] {}\n", indent, node.bytes,
+                        GetPercentage(node.bytes, parent_bytes), node.offset, node.label);
+    }
+    PrintNodes(os, node.children, node.bytes, depth + 1);
+  }
+}
+
+}  // namespace
+
+HeapFootprintReport AnalyzeHeapFootprint(const TypeIndex& index, const CountTable& instances,
+                                         const HeapFootprintOptions& options) {
+  HeapFootprintReport report;
+  FootprintBuilder builder{index, options};
+
+  std::unordered_map<std::string_view, std::uint64_t> counts;
+  for (const CountTable::Entry& entry : instances.entries)
+    counts[entry.name] += entry.count;
+
+  for (const auto& [name, count] : counts) {
+    const Record* record = index.FindRecord(name);
+    if (!record) {
+      report.unmatched_types.emplace_back(name);
+      continue;
+    }
+
+    HeapFootprintReport::TypeEntry& entry = report.types.emplace_back();
+    entry.name = record->name;
+    entry.size = record->size;
+    entry.instances = count;
+    entry.bytes = count * record->size;
+    entry.padding_bytes = count * builder.GetRecursivePadding(*record);
+    entry.breakdown = builder.BuildNodes(*record, count, 0);
+
+    builder.AddRecordTotals(*record, count, record->size, false, 0);
+
+    report.total_bytes += entry.bytes;
+    report.total_padding_bytes += entry.padding_bytes;
+  }
+
+  report.records = builder.GetRecordTotals();
+
+  llvm::stable_sort(report.types, [](const auto& lhs, const auto& rhs) {
+    return std::tie(rhs.bytes, lhs.name) < std::tie(lhs.bytes, rhs.name);
+  });
+  llvm::stable_sort(report.records, [](const auto& lhs, const auto& rhs) {
+    return std::tie(rhs.padding_bytes, rhs.bytes, lhs.name) <
+           std::tie(lhs.padding_bytes, lhs.bytes, rhs.name);
+  });
+  llvm::sort(report.unmatched_types);
+
+  Truncate(report.types, options.max_entries);
+  Truncate(report.records, options.max_entries);
+
+  return report;
+}
+
+void PrintHeapFootprintReport(llvm::raw_ostream& os, const HeapFootprintReport& report) {
+  os << fmt::format("heap footprint: {} bytes, {} bytes of padding ({:.1f}%)\n",
+                    report.total_bytes, report.total_padding_bytes,
+                    GetPercentage(report.total_padding_bytes, report.total_bytes));
+
+  os << "\ntypes by total size:\n";
+  for (const HeapFootprintReport::TypeEntry& entry : report.types) {
+    os << fmt::format("\n  {}: {} x {:#x} = {} bytes ({:.1f}% of total), {} bytes of padding\n",
+                      entry.name, entry.instances, entry.size, entry.bytes,
+                      GetPercentage(entry.bytes, report.total_bytes), entry.padding_bytes);
+    PrintNodes(os, entry.breakdown, entry.bytes, 0);
+  }
+
+  os << "\nrecords by padding (including uses as bases and members):\n";
+  for (const HeapFootprintReport::RecordEntry& entry : report.records) {
+    if (entry.padding_bytes == 0)
+      break;
+    os << fmt::format("  {:>14} bytes of padding in {:>14} bytes  {}\n", entry.padding_bytes,
+                      entry.bytes, entry.name);
+  }
+
+  if (!report.unmatched_types.empty()) {
+    os << fmt::format("\nunknown types: {}\n", report.unmatched_types.size());
+    for (const std::string& name : report.unmatched_types)
+      os << "  " << name << '\n';
+  }
+}
+
+}  // namespace classgen
@@ -0,0 +1,320 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/HotColdSplit.h"
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace classgen {
+
+namespace {
+
+using Temperature = HotColdSuggestion::Temperature;
+using Unit = HotColdSuggestion::Unit;
+
+using FieldCounts = std::unordered_map<std::string, std::uint64_t>;
+
+struct PlacedUnit {
+  std::size_t offset{};
+  std::size_t size{};
+  /// Probability that this unit is touched by an access to the record.
+  double probability{};
+};
+
+/// Returns the expected number of distinct cache lines touched by an access.
+double EstimateLinesTouched(const std::vector<PlacedUnit>& units, std::size_t line_size) {
+  // Line index -> probability that the line is *not* touched.
+  std::map<std::size_t, double> untouched;
+  for (const PlacedUnit& unit : units) {
+    const std::size_t first = unit.offset / line_size;
+    const std::size_t last = (unit.offset + std::max<std::size_t>(unit.size, 1) - 1) / line_size;
+    for (std::size_t line = first; line <= last; ++line) {
+      auto [it, inserted] = untouched.try_emplace(line, 1.0);
+      it->second *= 1.0 - unit.probability;
+    }
+  }
+
+  double lines = 0;
+  for (const auto& [line, probability] : untouched)
+    lines += 1.0 - probability;
+  return lines;
+}
+
+/// Splits the member variables of a record into units that can be moved independently.
+/// Runs of adjacent bitfields are kept together.
+std::vector<Unit> BuildUnits(const Record& record) {
+  std::vector<Unit> units;
+  bool in_bitfield_run = false;
+
+  for (std::size_t i = 0; i < record.fields.size(); ++i) {
+    const Field& field = record.fields[i];
+    const auto* member = std::get_if<Field::MemberVariable>(&field.data);
+    if (!member) {
+      in_bitfield_run = false;
+      continue;
+    }
+
+    // Older dumps do not record member sizes: fall back to the distance to the next field.
+    std::size_t size = member->size;
+    if (size == 0) {
+      const std::size_t next_offset =
+          i + 1 < record.fields.size() ? record.fields[i + 1].offset : record.data_size;
+      size = next_offset > field.offset ? next_offset - field.offset : 0;
+    }
+
+    if (member->bitfield_width != 0 && in_bitfield_run) {
+      Unit& run = units.back();
+      run.name += ", " + member->name;
+      run.size = std::max(run.size, field.offset + size - run.offset);
+      run.alignment = std::max(run.alignment, std::max<std::size_t>(member->alignment, 1));
+      continue;
+    }
+
+    Unit& unit = units.emplace_back();
+    unit.name = member->name;
+    unit.offset = field.offset;
+    unit.size = size;
+    unit.alignment = std::max<std::size_t>(member->alignment, 1);
+    in_bitfield_run = member->bitfield_width != 0;
+  }
+
+  // A bitfield run cannot extend past the next unit.
+  for (std::size_t i = 0; i + 1 < units.size(); ++i) {
+    if (units[i].offset + units[i].size > units[i + 1].offset)
+      units[i].size = std::max<std::size_t>(units[i + 1].offset - units[i].offset, 1);
+  }
+
+  return units;
+}
+
+std::uint64_t GetUnitCount(const Unit& unit, const FieldCounts& counts) {
+  std::uint64_t count = 0;
+  // Bitfield runs have a comma-separated list of member names.
+  for (llvm::StringRef rest = unit.name; !rest.empty();) {
+    auto [name, next] = rest.split(", ");
+    if (auto it = counts.find(name.str()); it != counts.end())
+      count += it->second;
+    rest = next;
+  }
+  return count;
+}
+
+/// Lays out units sequentially, starting from the specified offset.
+/// Returns the offset past the last unit.
+std::size_t PackUnits(std::vector<Unit*>& units, std::size_t offset) {
+  for (Unit* unit : units) {
+    offset = llvm::alignTo(offset, unit->alignment);
+    unit->new_offset = offset;
+    offset += unit->size;
+  }
+  return offset;
+}
+
+void SortForPacking(std::vector<Unit*>& units) {
+  llvm::stable_sort(units, [](const Unit* lhs, const Unit* rhs) {
+    if (lhs->alignment != rhs->alignment)
+      return lhs->alignment > rhs->alignment;
+    return lhs->count > rhs->count;
+  });
+}
+
+std::optional<HotColdSuggestion> AnalyzeRecord(const Record& record, const FieldCounts& counts,
+                                               const HotColdOptions& options) {
+  if (record.kind == Record::Kind::Union)
+    return std::nullopt;
+
+  HotColdSuggestion suggestion;
+  suggestion.record_name = record.name;
+  suggestion.record_size = record.size;
+  suggestion.units = BuildUnits(record);
+  if (suggestion.units.size() < 2)
+    return std::nullopt;
+
+  std::uint64_t max_count = 0;
+  for (Unit& unit : suggestion.units) {
+    unit.count = GetUnitCount(unit, counts);
+    suggestion.total_accesses += unit.count;
+    max_count = std::max(max_count, unit.count);
+  }
+
+  if (suggestion.total_accesses == 0)
+    return std::nullopt;
+
+  const auto total = double(suggestion.total_accesses);
+  const auto probability = [&](const Unit& unit) { return double(unit.count) / double(max_count); };
+
+  // Classify units.
+  std::vector<Unit*> by_count;
+  for (Unit& unit : suggestion.units)
+    by_count.push_back(&unit);
+  llvm::stable_sort(by_count, [](const Unit* lhs, const Unit* rhs) {
+    return lhs->count > rhs->count;
+  });
+
+  std::uint64_t covered = 0;
+  std::vector<Unit*> hot, warm, cold;
+  for (Unit* unit : by_count) {
+    if (unit->count != 0 && double(covered) < options.hot_coverage * total) {
+      unit->temperature = Temperature::Hot;
+      covered += unit->count;
+      hot.push_back(unit);
+    } else if (double(unit->count) < options.cold_threshold * total) {
+      unit->temperature = Temperature::Cold;
+      cold.push_back(unit);
+    } else {
+      unit->temperature = Temperature::Warm;
+      warm.push_back(unit);
+    }
+  }
+
+  for (const Unit* unit : hot)
+    suggestion.hot_bytes += unit->size;
+  for (const Unit* unit : cold)
+    suggestion.cold_bytes += unit->size;
+
+  // Bases and the vtable pointer cannot be moved, so members are laid out after them.
+  const std::size_t start = suggestion.units.front().offset;
+
+  // Current layout.
+  std::vector<PlacedUnit> placed;
+  for (const Unit& unit : suggestion.units)
+    placed.push_back({unit.offset, unit.size, probability(unit)});
+  suggestion.lines_before = EstimateLinesTouched(placed, options.cache_line_size);
+
+  // Hot units come first (sorted to minimise padding), followed by warm and cold units.
+  SortForPacking(hot);
+  SortForPacking(warm);
+  SortForPacking(cold);
+
+  // Split layout: cold units are replaced with a pointer to a separate struct.
+  std::size_t offset = PackUnits(hot, start);
+  offset = PackUnits(warm, offset);
+  placed.clear();
+  for (const Unit* unit : llvm::concat<Unit*>(hot, warm))
+    placed.push_back({unit->new_offset, unit->size, probability(*unit)});
+  double cold_untouched = 1.0;
+  for (const Unit* unit : cold)
+    cold_untouched *= 1.0 - probability(*unit);
+  if (!cold.empty()) {
+    const std::size_t ptr_offset = llvm::alignTo(offset, options.pointer_size);
+    placed.push_back({ptr_offset, options.pointer_size, 1.0 - cold_untouched});
+
+    std::vector<PlacedUnit> cold_placed;
+    PackUnits(cold, 0);
+    for (const Unit* unit : cold)
+      cold_placed.push_back({unit->new_offset, unit->size, probability(*unit)});
+    suggestion.lines_split = EstimateLinesTouched(placed, options.cache_line_size) +
+                             EstimateLinesTouched(cold_placed, options.cache_line_size);
+  }
+
+  // Reordered layout: cold units stay in the record.
+  PackUnits(cold, offset);
+  placed.clear();
+  for (const Unit* unit : llvm::concat<Unit*>(hot, warm, cold))
+    placed.push_back({unit->new_offset, unit->size, probability(*unit)});
+  suggestion.lines_reordered = EstimateLinesTouched(placed, options.cache_line_size);
+  if (cold.empty())
+    suggestion.lines_split = suggestion.lines_reordered;
+
+  std::vector<Unit> ordered;
+  ordered.reserve(suggestion.units.size());
+  for (const Unit* unit : llvm::concat<Unit*>(hot, warm, cold))
+    ordered.push_back(*unit);
+  suggestion.units = std::move(ordered);
+
+  return suggestion;
+}
+
+double GetBestLines(const HotColdSuggestion& suggestion) {
+  return std::min(suggestion.lines_reordered, suggestion.lines_split);
+}
+
+double GetWeightedSavings(const HotColdSuggestion& suggestion) {
+  return (suggestion.lines_before - GetBestLines(suggestion)) * double(suggestion.total_accesses);
+}
+
+std::string_view GetTemperatureName(Temperature temperature) {
+  switch (temperature) {
+  case Temperature::Hot:
+    return "hot";
+  case Temperature::Warm:
+    return "warm";
+  case Temperature::Cold:
+    return "cold";
+  }
+  return "";
+}
+
+}  // namespace
+
+HotColdReport AnalyzeHotColdSplit(const ParseResult& result, const CountTable& profile,
+                                  const HotColdOptions& options) {
+  HotColdReport report;
+
+  std::unordered_map<std::string_view, const Record*> records;
+  for (const Record& record : result.records)
+    records.emplace(record.name, &record);
+
+  std::unordered_map<std::string, FieldCounts> counts_by_record;
+  for (const CountTable::Entry& entry : profile.entries) {
+    const auto it = records.find(entry.name);
+    const bool has_member =
+        it != records.end() && llvm::any_of(it->second->fields, [&](const Field& field) {
+          const auto* member = std::get_if<Field::MemberVariable>(&field.data);
+          return member && member->name == entry.member;
+        });
+    if (!has_member) {
+      report.unmatched_entries.emplace_back(fmt::format("{}::{}", entry.name, entry.member));
+      continue;
+    }
+    counts_by_record[entry.name][entry.member] += entry.count;
+  }
+
+  for (const auto& [name, counts] : counts_by_record) {
+    auto suggestion = AnalyzeRecord(*records.at(name), counts, options);
+    if (suggestion && GetBestLines(*suggestion) < suggestion->lines_before - 0.01)
+      report.suggestions.emplace_back(std::move(*suggestion));
+  }
+
+  llvm::stable_sort(report.suggestions, [](const auto& lhs, const auto& rhs) {
+    return GetWeightedSavings(lhs) > GetWeightedSavings(rhs);
+  });
+  llvm::sort(report.unmatched_entries);
+
+  return report;
+}
+
+void PrintHotColdReport(llvm::raw_ostream& os, const HotColdReport& report) {
+  os << fmt::format("hot/cold split suggestions: {} records\n", report.suggestions.size());
+
+  for (const HotColdSuggestion& suggestion : report.suggestions) {
+    os << fmt::format("\n{} (size {:#x}, {} accesses)\n", suggestion.record_name,
+                      suggestion.record_size, suggestion.total_accesses);
+    os << fmt::format("  cache lines touched per access: {:.2f} now, {:.2f} reordered, "
+                      "{:.2f} with hot/cold split\n",
+                      suggestion.lines_before, suggestion.lines_reordered, suggestion.lines_split);
+    os << fmt::format("  hot fields: {:#x} bytes, cold fields: {:#x} bytes\n",
+                      suggestion.hot_bytes, suggestion.cold_bytes);
+    os << "  suggested order:\n";
+    for (const Unit& unit : suggestion.units) {
+      const double share = 100.0 * double(unit.count) / double(suggestion.total_accesses);
+      os << fmt::format("    {:#06x} -> {:#06x}  {} [{}, {:.1f}%]\n", unit.offset, unit.new_offset,
+                        unit.name, GetTemperatureName(unit.temperature), share);
+    }
+  }
+
+  if (!report.unmatched_entries.empty()) {
+    os << fmt::format("\nunmatched profile entries: {}\n", report.unmatched_entries.size());
+    for (const std::string& entry : report.unmatched_entries)
+      os << "  " << entry << '\n';
+  }
+}
+
+}  // namespace classgen
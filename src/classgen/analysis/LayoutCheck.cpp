@@ -0,0 +1,278 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/LayoutCheck.h"
+#include <optional>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/GlobPattern.h>
+#include <llvm/Support/LineIterator.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace classgen {
+
+namespace {
+
+using Rule = LayoutPolicy::Rule;
+
+/// Parses `sizeof(pattern) <= N` or `alignof(pattern) <= N`.
+bool ParseLimitRule(llvm::StringRef line, Rule& rule) {
+  auto [lhs, rhs] = line.split("<=");
+  lhs = lhs.trim();
+  rhs = rhs.trim();
+
+  if (lhs.consume_front("sizeof("))
+    rule.kind = Rule::Kind::MaxSize;
+  else if (lhs.consume_front("alignof("))
+    rule.kind = Rule::Kind::MaxAlignment;
+  else
+    return false;
+
+  if (!lhs.consume_back(")") || rhs.getAsInteger(0, rule.limit))
+    return false;
+
+  rule.pattern = lhs.trim().str();
+  return !rule.pattern.empty();
+}
+
+bool ParseRule(llvm::StringRef line, Rule& rule) {
+  if (line.startswith("sizeof(") || line.startswith("alignof("))
+    return ParseLimitRule(line, rule);
+
+  auto [keyword, pattern] = line.split(' ');
+  pattern = pattern.trim();
+  if (pattern.empty())
+    return false;
+
+  if (keyword == "no-grow")
+    rule.kind = Rule::Kind::NoGrow;
+  else if (keyword == "no-alignment-growth")
+    rule.kind = Rule::Kind::NoAlignmentGrowth;
+  else if (keyword == "no-padding-growth")
+    rule.kind = Rule::Kind::NoPaddingGrowth;
+  else if (keyword == "no-new-cache-lines")
+    rule.kind = Rule::Kind::NoNewCacheLines;
+  else
+    return false;
+
+  rule.pattern = pattern.str();
+  return true;
+}
+
+bool HasWildcards(llvm::StringRef pattern) {
+  return pattern.find_first_of("*?[\\") != llvm::StringRef::npos;
+}
+
+/// A rule with a compiled pattern.
+struct CompiledRule {
+  const Rule* rule = nullptr;
+  /// Only set if the pattern has wildcards; otherwise the pattern is matched exactly.
+  std::optional<llvm::GlobPattern> glob;
+
+  bool Matches(llvm::StringRef name) const {
+    return glob ? glob->match(name) : name == rule->pattern;
+  }
+};
+
+std::size_t GetCacheLineCount(std::size_t size, std::size_t line_size) {
+  return (size + line_size - 1) / line_size;
+}
+
+class Checker {
+public:
+  Checker(const TypeIndex* baseline, const TypeIndex& current, const LayoutCheckOptions& options,
+          LayoutCheckResult& result)
+      : m_baseline(baseline), m_current(current), m_options(options), m_result(result) {}
+
+  void Check(const Record& record, const std::vector<const CompiledRule*>& rules) {
+    const Record* old_record = m_baseline ? m_baseline->FindRecord(record.name) : nullptr;
+
+    for (const CompiledRule* compiled : rules) {
+      const Rule& rule = *compiled->rule;
+      switch (rule.kind) {
+      case Rule::Kind::NoGrow:
+        if (old_record && record.size > old_record->size) {
+          AddViolation(record, rule,
+                       fmt::format("size grew from {:#x} to {:#x}", old_record->size, record.size));
+        }
+        break;
+
+      case Rule::Kind::NoAlignmentGrowth:
+        if (old_record && record.alignment > old_record->alignment) {
+          AddViolation(record, rule,
+                       fmt::format("alignment grew from {} to {}", old_record->alignment,
+                                   record.alignment));
+        }
+        break;
+
+      case Rule::Kind::NoPaddingGrowth:
+        if (old_record) {
+          const std::size_t old_padding = GetPadding(*m_baseline, *old_record);
+          const std::size_t new_padding = GetPadding(m_current, record);
+          if (new_padding > old_padding) {
+            AddViolation(record, rule,
+                         fmt::format("padding grew from {:#x} to {:#x} bytes", old_padding,
+                                     new_padding));
+          }
+        }
+        break;
+
+      case Rule::Kind::NoNewCacheLines:
+        if (old_record) {
+          const auto old_lines = GetCacheLineCount(old_record->size, m_options.cache_line_size);
+          const auto new_lines = GetCacheLineCount(record.size, m_options.cache_line_size);
+          if (new_lines > old_lines) {
+            AddViolation(record, rule,
+                         fmt::format("now spans {} cache lines instead of {} (size {:#x} -> {:#x})",
+                                     new_lines, old_lines, old_record->size, record.size));
+          }
+        }
+        break;
+
+      case Rule::Kind::MaxSize:
+        if (record.size > rule.limit) {
+          AddViolation(record, rule,
+                       fmt::format("size is {:#x}, limit is {:#x}", record.size, rule.limit));
+        }
+        break;
+
+      case Rule::Kind::MaxAlignment:
+        if (record.alignment > rule.limit) {
+          AddViolation(record, rule,
+                       fmt::format("alignment is {}, limit is {}", record.alignment, rule.limit));
+        }
+        break;
+      }
+    }
+  }
+
+private:
+  static std::size_t GetPadding(const TypeIndex& index, const Record& record) {
+    return GetPaddingSize(record, GetFieldExtents(index, record));
+  }
+
+  void AddViolation(const Record& record, const Rule& rule, std::string message) {
+    m_result.violations.push_back({record.name, std::move(message), rule.location});
+  }
+
+  const TypeIndex* m_baseline;
+  const TypeIndex& m_current;
+  const LayoutCheckOptions& m_options;
+  LayoutCheckResult& m_result;
+};
+
+}  // namespace
+
+LayoutPolicy LayoutPolicy::Default() {
+  LayoutPolicy policy;
+  policy.rules.push_back({Rule::Kind::NoGrow, "*", 0, "default policy"});
+  policy.rules.push_back({Rule::Kind::NoAlignmentGrowth, "*", 0, "default policy"});
+  policy.rules.push_back({Rule::Kind::NoPaddingGrowth, "*", 0, "default policy"});
+  return policy;
+}
+
+bool LayoutPolicy::HasBaselineRules() const {
+  return llvm::any_of(rules, [](const Rule& rule) {
+    switch (rule.kind) {
+    case Rule::Kind::NoGrow:
+    case Rule::Kind::NoAlignmentGrowth:
+    case Rule::Kind::NoPaddingGrowth:
+    case Rule::Kind::NoNewCacheLines:
+      return true;
+    case Rule::Kind::MaxSize:
+    case Rule::Kind::MaxAlignment:
+      return false;
+    }
+    return false;
+  });
+}
+
+LayoutPolicy ReadLayoutPolicy(const std::string& path) {
+  LayoutPolicy policy;
+
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    policy.error = fmt::format("failed to read {}: {}", path, buffer.getError().message());
+    return policy;
+  }
+
+  for (llvm::line_iterator it(**buffer, /*SkipBlanks=*/true, '#'); !it.is_at_end(); ++it) {
+    const llvm::StringRef line = it->trim();
+    if (line.empty())
+      continue;
+
+    Rule rule;
+    rule.location = fmt::format("{}:{}", path, it.line_number());
+    if (!ParseRule(line, rule)) {
+      policy.error = fmt::format("{}: invalid rule: {}", rule.location, line.str());
+      policy.rules.clear();
+      return policy;
+    }
+    policy.rules.emplace_back(std::move(rule));
+  }
+
+  return policy;
+}
+
+LayoutCheckResult CheckLayouts(const TypeIndex* baseline, const TypeIndex& current,
+                               const LayoutPolicy& policy, const LayoutCheckOptions& options) {
+  LayoutCheckResult result;
+
+  std::vector<CompiledRule> compiled_rules;
+  compiled_rules.reserve(policy.rules.size());
+  for (const Rule& rule : policy.rules) {
+    CompiledRule& compiled = compiled_rules.emplace_back();
+    compiled.rule = &rule;
+    if (!HasWildcards(rule.pattern))
+      continue;
+
+    auto glob = llvm::GlobPattern::create(rule.pattern);
+    if (!glob) {
+      result.error = fmt::format("{}: invalid pattern: {}", rule.location,
+                                 llvm::toString(glob.takeError()));
+      return result;
+    }
+    compiled.glob = std::move(*glob);
+  }
+
+  Checker checker{baseline, current, options, result};
+  std::vector<const CompiledRule*> matching_rules;
+  for (const Record& record : current.GetResult().records) {
+    matching_rules.clear();
+    for (const CompiledRule& rule : compiled_rules) {
+      if (rule.Matches(record.name))
+        matching_rules.push_back(&rule);
+    }
+
+    if (matching_rules.empty())
+      continue;
+
+    ++result.num_checked_records;
+    checker.Check(record, matching_rules);
+  }
+
+  return result;
+}
+
+void PrintLayoutCheckResult(llvm::raw_ostream& os, const LayoutCheckResult& result) {
+  if (!result.error.empty()) {
+    os << "error: " << result.error << '\n';
+    return;
+  }
+
+  if (result.violations.empty()) {
+    os << fmt::format("OK: checked {} records, no violations\n", result.num_checked_records);
+    return;
+  }
+
+  os << fmt::format("FAILED: {} violations in {} checked records\n", result.violations.size(),
+                    result.num_checked_records);
+  for (const LayoutCheckResult::Violation& violation : result.violations) {
+    os << fmt::format("  {}: {} [{}]\n", violation.record_name, violation.message,
+                      violation.rule_location);
+  }
+}
+
+}  // namespace classgen
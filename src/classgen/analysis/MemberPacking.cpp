@@ -0,0 +1,209 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/MemberPacking.h"
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/raw_ostream.h>
+#include "classgen/ComplexType.h"
+
+namespace classgen {
+
+namespace {
+
+using Member = MemberPackingReport::Member;
+using Entry = MemberPackingReport::Entry;
+
+/// Returns the number of bits that are required to represent all enumerator values,
+/// or std::nullopt if a value could not be parsed.
+std::optional<std::size_t> GetEnumBits(const Enum& enum_def) {
+  std::int64_t min = 0;
+  std::uint64_t max = 0;
+
+  for (const Enum::Enumerator& enumerator : enum_def.enumerators) {
+    const llvm::StringRef value = enumerator.value;
+    if (value.startswith("-")) {
+      std::int64_t signed_value;
+      if (value.getAsInteger(10, signed_value))
+        return std::nullopt;
+      min = std::min(min, signed_value);
+    } else {
+      std::uint64_t unsigned_value;
+      if (value.getAsInteger(10, unsigned_value))
+        return std::nullopt;
+      max = std::max(max, unsigned_value);
+    }
+  }
+
+  const auto get_active_bits = [](std::uint64_t value) {
+    return std::size_t(std::numeric_limits<std::uint64_t>::digits - llvm::countLeadingZeros(value));
+  };
+
+  if (min >= 0)
+    return std::max<std::size_t>(get_active_bits(max), 1);
+
+  // Negative values need a sign bit. ~min is the magnitude of min minus one.
+  return 1 + std::max(get_active_bits(~static_cast<std::uint64_t>(min)), get_active_bits(max));
+}
+
+class MemberPackingAnalyzer {
+public:
+  MemberPackingAnalyzer(const TypeIndex& index, const CountTable* instances,
+                        const MemberPackingOptions& options)
+      : m_index(index), m_options(options) {
+    if (!instances)
+      return;
+
+    m_report.has_instance_counts = true;
+    for (const CountTable::Entry& entry : instances->entries)
+      m_instances[entry.name] += entry.count;
+  }
+
+  MemberPackingReport Analyze() {
+    for (const Record& record : m_index.GetResult().records) {
+      if (record.kind == Record::Kind::Union)
+        continue;
+
+      auto entry = ComputeEntry(record);
+      if (!entry)
+        continue;
+
+      m_report.total_savings += std::max(entry->narrowing_savings, entry->bitpacking_savings);
+      m_report.total_weighted_savings += entry->weighted_savings;
+      m_report.entries.emplace_back(std::move(*entry));
+    }
+
+    llvm::stable_sort(m_report.entries, [](const Entry& lhs, const Entry& rhs) {
+      const auto lhs_savings = std::max(lhs.narrowing_savings, lhs.bitpacking_savings);
+      const auto rhs_savings = std::max(rhs.narrowing_savings, rhs.bitpacking_savings);
+      return std::tie(rhs.weighted_savings, rhs_savings, lhs.record_name) <
+             std::tie(lhs.weighted_savings, lhs_savings, rhs.record_name);
+    });
+
+    if (m_options.max_entries != 0 && m_report.entries.size() > m_options.max_entries)
+      m_report.entries.resize(m_options.max_entries);
+
+    return std::move(m_report);
+  }
+
+private:
+  const Enum* FindEnum(const ComplexType& type) const {
+    if (type.GetKind() != ComplexType::Kind::TypeName)
+      return nullptr;
+    return m_index.FindEnum(static_cast<const ComplexTypeName&>(type).name);
+  }
+
+  std::optional<Entry> ComputeEntry(const Record& record) const {
+    Entry entry;
+
+    for (const Field& field : record.fields) {
+      const auto* member = std::get_if<Field::MemberVariable>(&field.data);
+      // Bitfields are already packed.
+      if (!member || member->bitfield_width != 0 || !member->type)
+        continue;
+
+      if (member->type->GetKind() == ComplexType::Kind::TypeName &&
+          static_cast<const ComplexTypeName&>(*member->type).name == "bool") {
+        entry.bools.push_back({member->name, member->type_name, member->size, 1, 1});
+        continue;
+      }
+
+      const Enum* enum_def = FindEnum(*member->type);
+      if (!enum_def || enum_def->enumerators.empty())
+        continue;
+
+      const auto bits = GetEnumBits(*enum_def);
+      if (!bits)
+        continue;
+
+      entry.enums.push_back(
+          {member->name, member->type_name, member->size, *bits, GetSizeForBits(*bits)});
+    }
+
+    std::size_t total_size = 0;
+    std::size_t total_bits = 0;
+    for (const Member& member : entry.bools) {
+      total_size += member.size;
+      total_bits += member.bits;
+    }
+    for (const Member& member : entry.enums) {
+      total_size += member.size;
+      total_bits += member.bits;
+      if (member.size > member.narrowed_size)
+        entry.narrowing_savings += member.size - member.narrowed_size;
+    }
+
+    if (entry.bools.size() + entry.enums.size() > 1) {
+      const std::size_t packed_size = llvm::divideCeil(total_bits, CharBit);
+      entry.bitpacking_savings = total_size > packed_size ? total_size - packed_size : 0;
+    }
+
+    if (entry.narrowing_savings == 0 && entry.bitpacking_savings == 0)
+      return std::nullopt;
+
+    entry.record_name = record.name;
+    entry.record_size = record.size;
+    if (const auto it = m_instances.find(record.name); it != m_instances.end())
+      entry.instances = it->second;
+    entry.weighted_savings =
+        entry.instances * std::max(entry.narrowing_savings, entry.bitpacking_savings);
+    return entry;
+  }
+
+  const TypeIndex& m_index;
+  const MemberPackingOptions& m_options;
+  MemberPackingReport m_report;
+  std::unordered_map<std::string, std::uint64_t> m_instances;
+};
+
+}  // namespace
+
+MemberPackingReport AnalyzeMemberPacking(const TypeIndex& index, const CountTable* instances,
+                                         const MemberPackingOptions& options) {
+  return MemberPackingAnalyzer{index, instances, options}.Analyze();
+}
+
+void PrintMemberPackingReport(llvm::raw_ostream& os, const MemberPackingReport& report) {
+  os << fmt::format("bool and enum packing: up to {} bytes per instance across {} records",
+                    report.total_savings, report.entries.size());
+  if (report.has_instance_counts)
+    os << fmt::format(", up to {} bytes across live instances", report.total_weighted_savings);
+  os << '\n';
+
+  for (const Entry& entry : report.entries) {
+    os << fmt::format("\n  {} (size {:#x}): {} bools, {} enums", entry.record_name,
+                      entry.record_size, entry.bools.size(), entry.enums.size());
+    if (report.has_instance_counts)
+      os << fmt::format(", {} instances", entry.instances);
+    os << '\n';
+
+    for (const Member& member : entry.enums) {
+      os << fmt::format("    {} ({}): {} bytes, values fit in {} bits ({} bytes)\n", member.name,
+                        member.type_name, member.size, member.bits, member.narrowed_size);
+    }
+
+    if (entry.narrowing_savings != 0) {
+      os << fmt::format("    narrowing enum underlying types would save up to {} bytes",
+                        entry.narrowing_savings);
+      if (report.has_instance_counts)
+        os << fmt::format(" ({} bytes total)", entry.instances * entry.narrowing_savings);
+      os << '\n';
+    }
+    if (entry.bitpacking_savings != 0) {
+      os << fmt::format("    packing bools and enums into bitfields would save up to {} bytes",
+                        entry.bitpacking_savings);
+      if (report.has_instance_counts)
+        os << fmt::format(" ({} bytes total)", entry.instances * entry.bitpacking_savings);
+      os << '\n';
+    }
+  }
+}
+
+}  // namespace classgen
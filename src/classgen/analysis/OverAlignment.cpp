@@ -0,0 +1,312 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/OverAlignment.h"
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace classgen {
+
+namespace {
+
+using Entry = OverAlignmentReport::Entry;
+using Embedding = OverAlignmentReport::Embedding;
+
+struct NaturalLayout {
+  std::size_t size{};
+  /// Size without tail padding.
+  std::size_t data_size{};
+  std::size_t alignment = 1;
+  /// False if the alignment of a member (possibly in a nested record) is missing from the dump.
+  bool has_member_alignments = true;
+};
+
+/// Returns the alignment of a scalar member without any alignas.
+/// Scalar types are assumed to be aligned to their size, unless the ABI aligns them less.
+std::size_t GetNaturalScalarAlignment(const Field::MemberVariable& member) {
+  const std::uint64_t count = GetArrayElementType(member.type.get()).count;
+  if (member.alignment == 0 || count == 0 || member.size == 0)
+    return std::max<std::size_t>(member.alignment, 1);
+
+  const std::uint64_t element_size = member.size / count;
+  const std::uint64_t size_alignment = element_size == 0 ? 1 : element_size & -element_size;
+  return std::min<std::size_t>(member.alignment, size_alignment);
+}
+
+class OverAlignmentAnalyzer {
+public:
+  OverAlignmentAnalyzer(const TypeIndex& index, const OverAlignmentOptions& options)
+      : m_index(index), m_options(options) {}
+
+  OverAlignmentReport Analyze() {
+    OverAlignmentReport report;
+    const auto embeddings = CollectEmbeddings();
+
+    for (const Record& record : m_index.GetResult().records) {
+      const NaturalLayout& natural = GetNaturalLayout(record, 0);
+      // Type dumps from older versions do not store member alignments: natural alignments
+      // cannot be computed.
+      if (!natural.has_member_alignments) {
+        ++report.num_records_without_member_alignments;
+        continue;
+      }
+
+      if (!IsOverAligned(record, natural))
+        continue;
+
+      Entry entry;
+      entry.record_name = record.name;
+      entry.size = record.size;
+      entry.alignment = record.alignment;
+      entry.natural_size = natural.size;
+      entry.natural_alignment = natural.alignment;
+      entry.tail_padding = record.size > record.data_size ? record.size - record.data_size : 0;
+      const std::size_t padding = GetPaddingSize(record, GetFieldExtents(m_index, record));
+      entry.internal_padding = padding > entry.tail_padding ? padding - entry.tail_padding : 0;
+      entry.wasted_bytes = record.size > natural.size ? record.size - natural.size : 0;
+      FindCauses(record, entry);
+      // Differences that are not caused by alignment (e.g. mismatches between the dump and
+      // the simplified layout algorithm) are not worth reporting.
+      if (entry.over_aligned_fields.empty() && !entry.is_explicitly_aligned)
+        continue;
+
+      if (const auto it = embeddings.find(&record); it != embeddings.end()) {
+        entry.embeddings = it->second;
+        for (Embedding& embedding : entry.embeddings)
+          embedding.wasted_bytes = embedding.count * entry.wasted_bytes;
+        llvm::stable_sort(entry.embeddings, [](const Embedding& lhs, const Embedding& rhs) {
+          return std::tie(rhs.wasted_bytes, lhs.record_name) <
+                 std::tie(lhs.wasted_bytes, rhs.record_name);
+        });
+      }
+      report.entries.push_back(std::move(entry));
+    }
+
+    llvm::stable_sort(report.entries, [](const Entry& lhs, const Entry& rhs) {
+      const std::size_t lhs_growth = lhs.alignment / lhs.natural_alignment;
+      const std::size_t rhs_growth = rhs.alignment / rhs.natural_alignment;
+      return std::tie(rhs.wasted_bytes, rhs_growth, lhs.record_name) <
+             std::tie(lhs.wasted_bytes, lhs_growth, rhs.record_name);
+    });
+
+    if (m_options.max_entries != 0 && report.entries.size() > m_options.max_entries)
+      report.entries.resize(m_options.max_entries);
+
+    return report;
+  }
+
+private:
+  static bool IsOverAligned(const Record& record, const NaturalLayout& natural) {
+    return record.size > natural.size || record.alignment > natural.alignment;
+  }
+
+  std::unordered_map<const Record*, std::vector<Embedding>> CollectEmbeddings() const {
+    std::unordered_map<const Record*, std::vector<Embedding>> embeddings;
+    for (const Record& record : m_index.GetResult().records) {
+      for (const Field& field : record.fields) {
+        if (const auto* base = std::get_if<Field::Base>(&field.data)) {
+          if (const Record* base_record = m_index.FindRecord(base->type_name))
+            embeddings[base_record].push_back({record.name, base->type_name, 1, 0});
+          continue;
+        }
+
+        const EmbeddedRecord embedded = GetEmbeddedRecord(m_index, field);
+        if (embedded.record) {
+          const auto& member = std::get<Field::MemberVariable>(field.data);
+          embeddings[embedded.record].push_back({record.name, member.name, embedded.count, 0});
+        }
+      }
+    }
+    return embeddings;
+  }
+
+  /// Returns the alignment of a field in the actual layout and without any over-alignment.
+  std::pair<std::size_t, std::size_t> GetFieldAlignments(const Field& field,
+                                                         std::size_t depth) {
+    if (const auto* member = std::get_if<Field::MemberVariable>(&field.data)) {
+      const std::size_t alignment = std::max<std::size_t>(member->alignment, 1);
+      if (const EmbeddedRecord embedded = GetEmbeddedRecord(m_index, field); embedded.record)
+        return {alignment, GetNaturalLayout(*embedded.record, depth + 1).alignment};
+      return {alignment, GetNaturalScalarAlignment(*member)};
+    }
+
+    if (const auto* base = std::get_if<Field::Base>(&field.data)) {
+      const Record* base_record = m_index.FindRecord(base->type_name);
+      if (!base_record)
+        return {1, 1};
+      return {std::max<std::size_t>(base_record->alignment, 1),
+              GetNaturalLayout(*base_record, depth + 1).alignment};
+    }
+
+    if (std::holds_alternative<Field::VTablePointer>(field.data))
+      return {m_options.pointer_size, m_options.pointer_size};
+
+    return {1, 1};
+  }
+
+  void FindCauses(const Record& record, Entry& entry) {
+    std::size_t max_field_alignment = 1;
+    for (const Field& field : record.fields) {
+      const auto [alignment, natural_alignment] = GetFieldAlignments(field, 0);
+      max_field_alignment = std::max(max_field_alignment, alignment);
+      if (alignment <= natural_alignment)
+        continue;
+
+      std::string label;
+      if (const auto* member = std::get_if<Field::MemberVariable>(&field.data))
+        label = fmt::format("{} ({})", member->name, member->type_name);
+      else if (const auto* base = std::get_if<Field::Base>(&field.data))
+        label = "base " + base->type_name;
+      entry.over_aligned_fields.push_back(
+          fmt::format("{}: alignment {} instead of {}", label, alignment, natural_alignment));
+    }
+
+    entry.is_explicitly_aligned = record.alignment > max_field_alignment;
+  }
+
+  const NaturalLayout& GetNaturalLayout(const Record& record, std::size_t depth) {
+    if (const auto it = m_layouts.find(&record); it != m_layouts.end())
+      return it->second;
+
+    // Insert a placeholder first to break cycles in broken dumps.
+    NaturalLayout& placeholder = m_layouts[&record];
+    placeholder = {record.size, record.data_size, std::max<std::size_t>(record.alignment, 1)};
+    if (depth > MaxNestingDepth)
+      return placeholder;
+
+    NaturalLayout layout = ComputeNaturalLayout(record, depth);
+    return m_layouts[&record] = layout;
+  }
+
+  /// Lays out fields in offset order with their natural alignment.
+  NaturalLayout ComputeNaturalLayout(const Record& record, std::size_t depth) {
+    NaturalLayout layout;
+    if (record.fields.empty()) {
+      // Empty records have a size of 1.
+      layout.size = 1;
+      return layout;
+    }
+
+    const auto extents = GetFieldExtents(m_index, record);
+    std::vector<std::size_t> order(extents.size());
+    std::iota(order.begin(), order.end(), 0);
+    llvm::stable_sort(order, [&](std::size_t lhs, std::size_t rhs) {
+      return extents[lhs].offset < extents[rhs].offset;
+    });
+
+    const bool is_union = record.kind == Record::Kind::Union;
+    std::size_t offset = 0;
+    std::size_t end = 0;
+    // Original and new start offsets of the current bitfield run.
+    std::size_t run_offset = 0;
+    std::size_t run_new_offset = 0;
+    bool in_run = false;
+
+    for (const std::size_t i : order) {
+      const FieldExtent& extent = extents[i];
+      const Field& field = record.fields[extent.field_idx];
+      const auto [alignment, natural_alignment] = GetFieldAlignments(field, depth);
+      layout.alignment = std::max(layout.alignment, natural_alignment);
+
+      std::size_t size = extent.size;
+      const auto* member = std::get_if<Field::MemberVariable>(&field.data);
+      if (const auto* base = std::get_if<Field::Base>(&field.data)) {
+        if (const Record* base_record = m_index.FindRecord(base->type_name)) {
+          const NaturalLayout& base_layout = GetNaturalLayout(*base_record, depth + 1);
+          // The ABI does not reuse the tail padding of POD bases, so the data size of a base
+          // can be larger than its natural data size. A base that keeps its layout keeps its
+          // data size; an over-aligned base without reusable tail padding keeps its full size.
+          if (!IsOverAligned(*base_record, base_layout))
+            size = base_record->data_size;
+          else if (base_record->data_size == base_record->size)
+            size = base_layout.size;
+          else
+            size = base_layout.data_size;
+          layout.has_member_alignments &= base_layout.has_member_alignments;
+        }
+      } else if (const EmbeddedRecord embedded = GetEmbeddedRecord(m_index, field);
+                 embedded.record) {
+        const NaturalLayout& member_layout = GetNaturalLayout(*embedded.record, depth + 1);
+        size = embedded.count * member_layout.size;
+        layout.has_member_alignments &= member_layout.has_member_alignments;
+      } else if (member && member->alignment == 0) {
+        layout.has_member_alignments = false;
+      }
+
+      // Bitfields that share storage keep their relative position.
+      if (member && member->bitfield_width != 0 && in_run && !is_union) {
+        end = std::max(end, run_new_offset + (extent.offset - run_offset) + size);
+        offset = end;
+        continue;
+      }
+
+      const std::size_t new_offset = is_union ? 0 : llvm::alignTo(offset, natural_alignment);
+      end = std::max(end, new_offset + size);
+      offset = end;
+
+      in_run = member && member->bitfield_width != 0;
+      run_offset = extent.offset;
+      run_new_offset = new_offset;
+    }
+
+    layout.data_size = end;
+    layout.size = std::max<std::size_t>(llvm::alignTo(end, layout.alignment), 1);
+    return layout;
+  }
+
+  const TypeIndex& m_index;
+  const OverAlignmentOptions& m_options;
+  std::unordered_map<const Record*, NaturalLayout> m_layouts;
+};
+
+double GetPercentage(std::uint64_t value, std::uint64_t total) {
+  return total == 0 ? 0.0 : 100.0 * double(value) / double(total);
+}
+
+}  // namespace
+
+OverAlignmentReport AnalyzeOverAlignment(const TypeIndex& index,
+                                         const OverAlignmentOptions& options) {
+  return OverAlignmentAnalyzer{index, options}.Analyze();
+}
+
+void PrintOverAlignmentReport(llvm::raw_ostream& os, const OverAlignmentReport& report) {
+  os << fmt::format("over-aligned records: {}\n", report.entries.size());
+  if (report.num_records_without_member_alignments != 0) {
+    os << fmt::format("warning: skipped {} records because the type dump does not contain "
+                      "member alignments (regenerate it with a newer classgen-dump)\n",
+                      report.num_records_without_member_alignments);
+  }
+
+  for (const Entry& entry : report.entries) {
+    os << fmt::format("\n  {} (size {:#x}, alignment {}; natural size {:#x}, alignment {})\n",
+                      entry.record_name, entry.size, entry.alignment, entry.natural_size,
+                      entry.natural_alignment);
+    os << fmt::format("    {} bytes wasted ({:.1f}%), {} bytes of internal padding, "
+                      "{} bytes of tail padding\n",
+                      entry.wasted_bytes, GetPercentage(entry.wasted_bytes, entry.size),
+                      entry.internal_padding, entry.tail_padding);
+
+    if (entry.is_explicitly_aligned)
+      os << "    cause: record is declared with alignas\n";
+    for (const std::string& field : entry.over_aligned_fields)
+      os << "    cause: " << field << '\n';
+
+    for (const Embedding& embedding : entry.embeddings) {
+      os << fmt::format("    embedded in {}::{}", embedding.record_name, embedding.field_name);
+      if (embedding.count != 1)
+        os << fmt::format(" (x{})", embedding.count);
+      if (embedding.wasted_bytes != 0)
+        os << fmt::format(": {} bytes wasted per instance", embedding.wasted_bytes);
+      os << '\n';
+    }
+  }
+}
+
+}  // namespace classgen
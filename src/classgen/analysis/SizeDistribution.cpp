@@ -0,0 +1,186 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/SizeDistribution.h"
+#include <algorithm>
+#include <string_view>
+#include <utility>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace classgen {
+
+namespace {
+
+using Group = SizeDistributionReport::Group;
+
+std::string_view GetScope(std::string_view name) {
+  const std::size_t separator = FindLastScopeSeparator(name);
+  if (separator == std::string_view::npos || separator == 0)
+    return "::";
+  return name.substr(0, separator);
+}
+
+std::string GetDirectory(const Record& record, llvm::StringRef source_root) {
+  if (record.source_file.empty())
+    return "(unknown)";
+
+  llvm::StringRef path = record.source_file;
+  if (!source_root.empty() && path.consume_front(source_root))
+    path = path.ltrim("/\\");
+
+  llvm::StringRef directory = llvm::sys::path::parent_path(path);
+  return directory.empty() ? "." : directory.str();
+}
+
+void AddRecord(Group& group, const Record& record) {
+  const auto num_fields = llvm::count_if(record.fields, [](const Field& field) {
+    return std::holds_alternative<Field::MemberVariable>(field.data);
+  });
+
+  ++group.num_records;
+  group.total_size += record.size;
+  group.max_size = std::max(group.max_size, record.size);
+  group.total_fields += num_fields;
+  group.sizes.Add(record.size);
+  group.field_counts.Add(num_fields);
+
+  if (record.vtable) {
+    ++group.num_dynamic_records;
+    group.vtable_lengths.Add(record.vtable->components.size());
+  }
+}
+
+void MergeHistogram(SizeHistogram& histogram, const SizeHistogram& other) {
+  if (histogram.buckets.size() < other.buckets.size())
+    histogram.buckets.resize(other.buckets.size());
+  for (std::size_t i = 0; i < other.buckets.size(); ++i)
+    histogram.buckets[i] += other.buckets[i];
+}
+
+void MergeGroup(Group& group, const Group& other) {
+  group.num_records += other.num_records;
+  group.num_dynamic_records += other.num_dynamic_records;
+  group.total_size += other.total_size;
+  group.max_size = std::max(group.max_size, other.max_size);
+  group.total_fields += other.total_fields;
+  MergeHistogram(group.sizes, other.sizes);
+  MergeHistogram(group.field_counts, other.field_counts);
+  MergeHistogram(group.vtable_lengths, other.vtable_lengths);
+}
+
+void WriteHistogram(llvm::json::OStream& out, const SizeHistogram& histogram) {
+  out.array([&] {
+    for (std::size_t i = 0; i < histogram.buckets.size(); ++i) {
+      if (histogram.buckets[i] == 0)
+        continue;
+      out.object([&] {
+        out.attribute("min", SizeHistogram::GetBucketMin(i));
+        out.attribute("max", SizeHistogram::GetBucketMax(i));
+        out.attribute("count", histogram.buckets[i]);
+      });
+    }
+  });
+}
+
+void WriteGroup(llvm::json::OStream& out, const Group& group) {
+  out.object([&] {
+    out.attribute("num_records", std::uint64_t(group.num_records));
+    out.attribute("num_dynamic_records", std::uint64_t(group.num_dynamic_records));
+    out.attribute("total_size", group.total_size);
+    out.attribute("max_size", std::uint64_t(group.max_size));
+    out.attribute("total_fields", group.total_fields);
+    out.attributeBegin("sizes");
+    WriteHistogram(out, group.sizes);
+    out.attributeEnd();
+    out.attributeBegin("field_counts");
+    WriteHistogram(out, group.field_counts);
+    out.attributeEnd();
+    out.attributeBegin("vtable_lengths");
+    WriteHistogram(out, group.vtable_lengths);
+    out.attributeEnd();
+  });
+}
+
+void WriteGroups(llvm::json::OStream& out, const std::map<std::string, Group>& groups) {
+  out.object([&] {
+    for (const auto& [name, group] : groups) {
+      out.attributeBegin(name);
+      WriteGroup(out, group);
+      out.attributeEnd();
+    }
+  });
+}
+
+}  // namespace
+
+void SizeHistogram::Add(std::uint64_t value) {
+  const std::size_t bucket = value == 0 ? 0 : llvm::Log2_64(value) + 1;
+  if (buckets.size() <= bucket)
+    buckets.resize(bucket + 1);
+  ++buckets[bucket];
+}
+
+std::uint64_t SizeHistogram::GetBucketMin(std::size_t bucket) {
+  return bucket == 0 ? 0 : std::uint64_t(1) << (bucket - 1);
+}
+
+std::uint64_t SizeHistogram::GetBucketMax(std::size_t bucket) {
+  return bucket == 0 ? 0 : (std::uint64_t(1) << bucket) - 1;
+}
+
+SizeDistributionBuilder::SizeDistributionBuilder(SizeDistributionOptions options)
+    : m_options(std::move(options)) {
+  m_report.label = m_options.label;
+}
+
+void SizeDistributionBuilder::AddRecord(const Record& record) {
+  m_record_names.insert(record.name);
+  classgen::AddRecord(m_report.total, record);
+  classgen::AddRecord(m_scopes[std::string(GetScope(record.name))], record);
+  classgen::AddRecord(m_report.directories[GetDirectory(record, m_options.source_root)], record);
+}
+
+SizeDistributionReport SizeDistributionBuilder::Finish() {
+  for (const auto& [scope_name, group] : m_scopes) {
+    // Strip the last component as long as the scope names a record (nested records).
+    std::string_view scope = scope_name;
+    while (scope != "::" && m_record_names.contains(scope))
+      scope = GetScope(scope);
+    MergeGroup(m_report.namespaces[std::string(scope)], group);
+  }
+  m_scopes.clear();
+  return std::move(m_report);
+}
+
+SizeDistributionReport AnalyzeSizeDistribution(const TypeIndex& index,
+                                               const SizeDistributionOptions& options) {
+  SizeDistributionBuilder builder{options};
+  for (const Record& record : index.GetResult().records)
+    builder.AddRecord(record);
+  return builder.Finish();
+}
+
+void PrintSizeDistributionReport(llvm::raw_ostream& os, const SizeDistributionReport& report) {
+  llvm::json::OStream out(os, 2);
+  out.object([&] {
+    if (!report.label.empty())
+      out.attribute("label", report.label);
+    out.attributeBegin("total");
+    WriteGroup(out, report.total);
+    out.attributeEnd();
+    out.attributeBegin("namespaces");
+    WriteGroups(out, report.namespaces);
+    out.attributeEnd();
+    out.attributeBegin("directories");
+    WriteGroups(out, report.directories);
+    out.attributeEnd();
+  });
+  os << '\n';
+}
+
+}  // namespace classgen
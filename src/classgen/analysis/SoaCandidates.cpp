@@ -0,0 +1,177 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/SoaCandidates.h"
+#include <tuple>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+#include "classgen/ComplexType.h"
+
+namespace classgen {
+
+namespace {
+
+using Entry = SoaCandidateReport::Entry;
+
+/// Splits a template specialization name into the template name and its top-level arguments.
+/// Returns false if the name is not a template specialization.
+bool SplitTemplateName(llvm::StringRef name, llvm::StringRef& template_name,
+                       std::vector<llvm::StringRef>& args) {
+  const std::size_t open = name.find('<');
+  if (open == llvm::StringRef::npos || !name.endswith(">"))
+    return false;
+
+  template_name = name.take_front(open).rtrim();
+  const llvm::StringRef list = name.slice(open + 1, name.size() - 1);
+
+  int depth = 0;
+  std::size_t arg_begin = 0;
+  for (std::size_t i = 0; i < list.size(); ++i) {
+    const char c = list[i];
+    if (c == '<' || c == '(' || c == '[') {
+      ++depth;
+    } else if (c == '>' || c == ')' || c == ']') {
+      --depth;
+    } else if (c == ',' && depth == 0) {
+      args.push_back(list.slice(arg_begin, i).trim());
+      arg_begin = i + 1;
+    }
+  }
+  args.push_back(list.drop_front(arg_begin).trim());
+  return true;
+}
+
+std::size_t GetNumMemberVariables(const Record& record) {
+  return llvm::count_if(record.fields, [](const Field& field) {
+    return std::holds_alternative<Field::MemberVariable>(field.data);
+  });
+}
+
+class SoaCandidateFinder {
+public:
+  SoaCandidateFinder(const TypeIndex& index, const SoaCandidateOptions& options)
+      : m_index(index), m_options(options) {}
+
+  SoaCandidateReport Find() {
+    for (const Record& record : m_index.GetResult().records) {
+      // The storage of a container (e.g. std::array::_M_elems) is already reported for the
+      // members that use the container.
+      llvm::StringRef template_name;
+      std::vector<llvm::StringRef> args;
+      if (SplitTemplateName(record.name, template_name, args) && IsContainer(template_name))
+        continue;
+
+      for (const Field& field : record.fields) {
+        const auto* member = std::get_if<Field::MemberVariable>(&field.data);
+        if (member)
+          CheckMember(record, *member);
+      }
+    }
+
+    llvm::stable_sort(m_report.entries, [](const Entry& lhs, const Entry& rhs) {
+      return std::tie(rhs.wasted_bytes, rhs.padding_per_element, lhs.record_name,
+                      lhs.field_name) < std::tie(lhs.wasted_bytes, lhs.padding_per_element,
+                                                 rhs.record_name, rhs.field_name);
+    });
+
+    if (m_options.max_entries != 0 && m_report.entries.size() > m_options.max_entries)
+      m_report.entries.resize(m_options.max_entries);
+
+    return std::move(m_report);
+  }
+
+private:
+  void CheckMember(const Record& record, const Field::MemberVariable& member) {
+    std::uint64_t array_count = 1;
+    const ComplexType* type = member.type.get();
+    while (type && type->GetKind() == ComplexType::Kind::Array) {
+      const auto* array = static_cast<const ComplexTypeArray*>(type);
+      array_count *= array->size;
+      type = array->element_type.get();
+    }
+
+    if (!type || type->GetKind() != ComplexType::Kind::TypeName)
+      return;
+
+    const std::string& type_name = static_cast<const ComplexTypeName*>(type)->name;
+
+    // Fixed arrays of records.
+    if (type != member.type.get()) {
+      if (const Record* element = m_index.FindRecord(type_name))
+        AddCandidate(record, member, "", *element, array_count);
+      return;
+    }
+
+    // Containers.
+    llvm::StringRef template_name;
+    std::vector<llvm::StringRef> args;
+    if (!SplitTemplateName(type_name, template_name, args))
+      return;
+
+    if (!IsContainer(template_name))
+      return;
+
+    const Record* element = m_index.FindRecord(args.front());
+    if (!element)
+      return;
+
+    std::uint64_t count = 0;
+    if (template_name == "std::array" && args.size() >= 2 && args[1].getAsInteger(10, count))
+      count = 0;
+    AddCandidate(record, member, template_name.str(), *element, count);
+  }
+
+  bool IsContainer(llvm::StringRef template_name) const {
+    return llvm::is_contained(m_options.container_templates, template_name);
+  }
+
+  void AddCandidate(const Record& record, const Field::MemberVariable& member,
+                    std::string container, const Record& element, std::uint64_t count) {
+    const std::size_t num_fields = GetNumMemberVariables(element);
+    if (num_fields < m_options.min_fields)
+      return;
+
+    const std::size_t padding = GetPaddingSize(element, GetFieldExtents(m_index, element));
+    if (padding < m_options.min_padding)
+      return;
+
+    Entry& entry = m_report.entries.emplace_back();
+    entry.record_name = record.name;
+    entry.field_name = member.name;
+    entry.container = std::move(container);
+    entry.element_name = element.name;
+    entry.count = count;
+    entry.element_size = element.size;
+    entry.element_fields = num_fields;
+    entry.padding_per_element = padding;
+    entry.wasted_bytes = padding * std::max<std::uint64_t>(count, 1);
+  }
+
+  const TypeIndex& m_index;
+  const SoaCandidateOptions& m_options;
+  SoaCandidateReport m_report;
+};
+
+}  // namespace
+
+SoaCandidateReport FindSoaCandidates(const TypeIndex& index, const SoaCandidateOptions& options) {
+  return SoaCandidateFinder{index, options}.Find();
+}
+
+void PrintSoaCandidateReport(llvm::raw_ostream& os, const SoaCandidateReport& report) {
+  os << fmt::format("structure of arrays candidates: {}\n", report.entries.size());
+
+  for (const Entry& entry : report.entries) {
+    const std::string count = entry.count == 0 ? "n" : std::to_string(entry.count);
+    os << fmt::format("\n  {}::{}: {} of {} x {} (size {:#x}, {} fields)\n", entry.record_name,
+                      entry.field_name, entry.container.empty() ? "array" : entry.container,
+                      count, entry.element_name, entry.element_size, entry.element_fields);
+    os << fmt::format("    {} bytes of padding per element, {} bytes wasted{}\n",
+                      entry.padding_per_element, entry.wasted_bytes,
+                      entry.count == 0 ? " per element" : "");
+  }
+}
+
+}  // namespace classgen
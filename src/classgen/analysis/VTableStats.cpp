@@ -0,0 +1,116 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/VTableStats.h"
+#include <string_view>
+#include <tuple>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Support/raw_ostream.h>
+#include "classgen/VTableLayout.h"
+
+namespace classgen {
+
+namespace {
+
+using Entry = VTableStatsReport::Entry;
+
+Entry ComputeEntry(const Record& record, const VTableStatsOptions& options) {
+  Entry entry;
+  entry.record_name = record.name;
+
+  const auto groups = GetVTableGroups(*record.vtable);
+  entry.num_vtables = groups.size();
+  entry.num_secondary_vptrs = groups.empty() ? 0 : groups.size() - 1;
+  entry.secondary_vptr_bytes = entry.num_secondary_vptrs * options.pointer_size;
+  entry.vtable_bytes = record.vtable->components.size() * options.pointer_size;
+
+  for (const VTableGroup& group : groups) {
+    entry.num_vbase_offsets += group.num_vbase_offsets;
+    entry.num_vcall_offsets += group.num_vcall_offsets;
+  }
+
+  for (const VTableComponent& component : record.vtable->components) {
+    const auto* func = GetFunctionPointer(component);
+    if (!func)
+      continue;
+
+    ++entry.num_functions;
+    if (!func->is_thunk)
+      continue;
+
+    ++entry.num_thunks;
+    if (func->this_adjustment_vcall_offset_offset != 0)
+      ++entry.num_virtual_this_adjusting_thunks;
+    else if (func->this_adjustment != 0)
+      ++entry.num_this_adjusting_thunks;
+    if (func->return_adjustment != 0 || func->return_adjustment_vbase_offset_offset != 0)
+      ++entry.num_return_adjusting_thunks;
+  }
+
+  return entry;
+}
+
+void Accumulate(Entry& totals, const Entry& entry) {
+  totals.num_vtables += entry.num_vtables;
+  totals.num_secondary_vptrs += entry.num_secondary_vptrs;
+  totals.secondary_vptr_bytes += entry.secondary_vptr_bytes;
+  totals.vtable_bytes += entry.vtable_bytes;
+  totals.num_functions += entry.num_functions;
+  totals.num_thunks += entry.num_thunks;
+  totals.num_this_adjusting_thunks += entry.num_this_adjusting_thunks;
+  totals.num_virtual_this_adjusting_thunks += entry.num_virtual_this_adjusting_thunks;
+  totals.num_return_adjusting_thunks += entry.num_return_adjusting_thunks;
+  totals.num_vbase_offsets += entry.num_vbase_offsets;
+  totals.num_vcall_offsets += entry.num_vcall_offsets;
+}
+
+constexpr std::string_view RowFormat =
+    "  {:>7} {:>10} {:>10} {:>9} {:>7} {:>8} {:>9} {:>7} {:>6} {:>6}  {}\n";
+
+void PrintRow(llvm::raw_ostream& os, const Entry& entry) {
+  os << fmt::format(RowFormat, entry.num_vtables, entry.secondary_vptr_bytes, entry.vtable_bytes,
+                    entry.num_functions, entry.num_thunks, entry.num_this_adjusting_thunks,
+                    entry.num_virtual_this_adjusting_thunks, entry.num_return_adjusting_thunks,
+                    entry.num_vbase_offsets, entry.num_vcall_offsets, entry.record_name);
+}
+
+}  // namespace
+
+VTableStatsReport AnalyzeVTableStats(const ParseResult& result,
+                                     const VTableStatsOptions& options) {
+  VTableStatsReport report;
+  report.totals.record_name = "(total)";
+
+  for (const Record& record : result.records) {
+    if (!record.vtable)
+      continue;
+
+    ++report.num_dynamic_records;
+    Entry entry = ComputeEntry(record, options);
+    Accumulate(report.totals, entry);
+    report.entries.emplace_back(std::move(entry));
+  }
+
+  llvm::stable_sort(report.entries, [](const Entry& lhs, const Entry& rhs) {
+    return std::tie(rhs.secondary_vptr_bytes, rhs.num_thunks, rhs.vtable_bytes, lhs.record_name) <
+           std::tie(lhs.secondary_vptr_bytes, lhs.num_thunks, lhs.vtable_bytes, rhs.record_name);
+  });
+
+  if (options.max_entries != 0 && report.entries.size() > options.max_entries)
+    report.entries.resize(options.max_entries);
+
+  return report;
+}
+
+void PrintVTableStatsReport(llvm::raw_ostream& os, const VTableStatsReport& report) {
+  os << fmt::format("vtable statistics: {} dynamic classes\n\n", report.num_dynamic_records);
+  os << fmt::format(RowFormat, "vtables", "vptr bytes", "vtbl bytes", "functions", "thunks",
+                    "this-adj", "vcall-adj", "ret-adj", "vbase", "vcall", "record");
+  PrintRow(os, report.totals);
+  os << '\n';
+  for (const Entry& entry : report.entries)
+    PrintRow(os, entry);
+}
+
+}  // namespace classgen
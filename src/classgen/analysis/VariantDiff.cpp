@@ -0,0 +1,132 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/VariantDiff.h"
+#include <map>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Support/raw_ostream.h>
+#include "classgen/Layout.h"
+
+namespace classgen {
+
+namespace {
+
+using RecordDiff = VariantDiffReport::RecordDiff;
+
+/// Returns a label that identifies a field across variants, mapped to its offset.
+/// Unnamed members (anonymous structs and unions) are identified by their position.
+std::map<std::string, std::size_t> GetFieldOffsets(const Record& record) {
+  std::map<std::string, std::size_t> offsets;
+  std::size_t num_vptrs = 0;
+  std::size_t num_unnamed_members = 0;
+
+  for (const Field& field : record.fields) {
+    std::string label;
+    if (const auto* member = std::get_if<Field::MemberVariable>(&field.data))
+      label = member->name.empty() ? fmt::format("unnamed member #{}", num_unnamed_members++)
+                                   : member->name;
+    else if (const auto* base = std::get_if<Field::Base>(&field.data))
+      label = "base " + base->type_name;
+    else if (std::holds_alternative<Field::VTablePointer>(field.data))
+      label = fmt::format("vptr #{}", num_vptrs++);
+    else
+      continue;
+
+    offsets.emplace(std::move(label), field.offset);
+  }
+
+  return offsets;
+}
+
+std::vector<std::string> GetFieldChanges(const Record& main, const Record& variant) {
+  const auto main_offsets = GetFieldOffsets(main);
+  const auto variant_offsets = GetFieldOffsets(variant);
+  std::vector<std::string> changes;
+
+  for (const auto& [label, offset] : main_offsets) {
+    const auto it = variant_offsets.find(label);
+    if (it == variant_offsets.end())
+      changes.push_back(fmt::format("{}: removed (was at {:#x})", label, offset));
+    else if (it->second != offset)
+      changes.push_back(fmt::format("{}: {:#x} -> {:#x}", label, offset, it->second));
+  }
+
+  for (const auto& [label, offset] : variant_offsets) {
+    if (!main_offsets.contains(label))
+      changes.push_back(fmt::format("{}: added at {:#x}", label, offset));
+  }
+
+  return changes;
+}
+
+}  // namespace
+
+VariantDiffReport DiffVariants(const ParseResult& result) {
+  VariantDiffReport report;
+  report.main_variant = result.variant_name;
+
+  const TypeIndex main_index{result};
+
+  for (const ParseVariantResult& variant : result.variants) {
+    VariantDiffReport::VariantSummary& summary = report.variants.emplace_back();
+    summary.name = variant.name;
+    summary.num_missing_records = variant.missing_records.size();
+
+    for (const Record& record : variant.records) {
+      const Record* main_record = main_index.FindRecord(record.name);
+      if (!main_record) {
+        ++summary.num_added_records;
+        continue;
+      }
+
+      auto field_changes = GetFieldChanges(*main_record, record);
+      if (main_record->size == record.size && main_record->alignment == record.alignment &&
+          field_changes.empty()) {
+        ++summary.num_other_changes;
+        continue;
+      }
+
+      RecordDiff& diff = report.differences.emplace_back();
+      diff.record_name = record.name;
+      diff.variant = variant.name;
+      diff.main_size = main_record->size;
+      diff.variant_size = record.size;
+      diff.main_alignment = main_record->alignment;
+      diff.variant_alignment = record.alignment;
+      diff.field_changes = std::move(field_changes);
+    }
+  }
+
+  llvm::stable_sort(report.differences, [](const RecordDiff& lhs, const RecordDiff& rhs) {
+    return lhs.record_name < rhs.record_name;
+  });
+
+  return report;
+}
+
+void PrintVariantDiffReport(llvm::raw_ostream& os, const VariantDiffReport& report) {
+  if (report.variants.empty()) {
+    os << "layout differences between variants: the dump only contains one variant\n";
+    return;
+  }
+
+  os << fmt::format("layout differences between variants (compared to {}): {}\n",
+                    report.main_variant, report.differences.size());
+  for (const auto& summary : report.variants) {
+    os << fmt::format("  {}: {} records only in this variant, {} records missing, "
+                      "{} records with other differences\n",
+                      summary.name, summary.num_added_records, summary.num_missing_records,
+                      summary.num_other_changes);
+  }
+
+  for (const RecordDiff& diff : report.differences) {
+    os << fmt::format("\n  {} [{}]: size {:#x} -> {:#x}, alignment {} -> {}\n", diff.record_name,
+                      diff.variant, diff.main_size, diff.variant_size, diff.main_alignment,
+                      diff.variant_alignment);
+    for (const std::string& change : diff.field_changes)
+      os << "    " << change << '\n';
+  }
+}
+
+}  // namespace classgen
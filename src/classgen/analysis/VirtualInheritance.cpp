@@ -0,0 +1,182 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include "classgen/analysis/VirtualInheritance.h"
+#include <algorithm>
+#include <tuple>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/raw_ostream.h>
+#include "classgen/VTableLayout.h"
+
+namespace classgen {
+
+namespace {
+
+using VirtualBase = VirtualInheritanceReport::VirtualBase;
+using Entry = VirtualInheritanceReport::Entry;
+
+/// Returns whether any vtable slot of a record points to a virtual function. Records that
+/// have a vtable without any slot only need a vtable pointer because of their virtual bases.
+bool HasVirtualFunctions(const Record& record) {
+  return record.vtable && llvm::any_of(record.vtable->components, [](const auto& component) {
+           return GetFunctionPointer(component) != nullptr;
+         });
+}
+
+bool IsBitfield(const ExpandedMember& member) {
+  const auto* variable = std::get_if<Field::MemberVariable>(&member.field->data);
+  return variable && variable->bitfield_width != 0;
+}
+
+class VirtualInheritanceAnalyzer {
+public:
+  VirtualInheritanceAnalyzer(const TypeIndex& index, const VirtualInheritanceOptions& options)
+      : m_index(index), m_options(options), m_expander(index, false) {}
+
+  VirtualInheritanceReport Analyze() {
+    VirtualInheritanceReport report;
+
+    for (const Record& record : m_index.GetResult().records) {
+      Entry entry;
+      if (!AnalyzeRecord(record, entry))
+        continue;
+      ++report.num_records;
+      report.total_vbase_offsets += entry.num_vbase_offsets;
+      report.total_vcall_offsets += entry.num_vcall_offsets;
+      report.total_extra_vptrs += entry.num_extra_vptrs;
+      report.entries.emplace_back(std::move(entry));
+    }
+
+    llvm::stable_sort(report.entries, [](const Entry& lhs, const Entry& rhs) {
+      return std::tie(rhs.size_overhead, rhs.num_extra_vptrs, lhs.record_name) <
+             std::tie(lhs.size_overhead, lhs.num_extra_vptrs, rhs.record_name);
+    });
+
+    if (m_options.max_entries != 0 && report.entries.size() > m_options.max_entries)
+      report.entries.resize(m_options.max_entries);
+
+    return report;
+  }
+
+private:
+  bool AnalyzeRecord(const Record& record, Entry& entry) {
+    for (const Field& field : record.fields) {
+      const auto* base = std::get_if<Field::Base>(&field.data);
+      if (!base || !base->is_virtual)
+        continue;
+
+      VirtualBase& vbase = entry.virtual_bases.emplace_back();
+      vbase.type_name = base->type_name;
+      vbase.offset = field.offset;
+      if (const Record* base_record = m_index.FindRecord(base->type_name))
+        vbase.size = base_record->data_size;
+    }
+
+    if (entry.virtual_bases.empty())
+      return false;
+
+    entry.record_name = record.name;
+    entry.size = record.size;
+
+    if (record.vtable) {
+      for (const VTableComponent& component : record.vtable->components) {
+        if (std::holds_alternative<VTableComponent::VBaseOffset>(component.data))
+          ++entry.num_vbase_offsets;
+        else if (std::holds_alternative<VTableComponent::VCallOffset>(component.data))
+          ++entry.num_vcall_offsets;
+      }
+    }
+
+    entry.vtable_offset_bytes =
+        (entry.num_vbase_offsets + entry.num_vcall_offsets) * m_options.pointer_size;
+    entry.non_virtual_size = ComputeNonVirtualSize(record, entry);
+    entry.size_overhead =
+        record.size > entry.non_virtual_size ? record.size - entry.non_virtual_size : 0;
+    return true;
+  }
+
+  /// Lays out the members of all subobjects again in the same order with natural alignment,
+  /// leaving out the vtable pointers of virtual bases (and all vtable pointers if there are no
+  /// virtual functions). Record members are not expanded so that they keep their own size,
+  /// alignment and tail padding.
+  std::size_t ComputeNonVirtualSize(const Record& record, Entry& entry) {
+    const std::vector<ExpandedMember>& members = m_expander.Expand(record);
+    const bool has_virtual_functions = HasVirtualFunctions(record);
+
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < members.size(); ++i) {
+      const ExpandedMember& member = members[i];
+
+      if (std::holds_alternative<Field::VTablePointer>(member.field->data)) {
+        ++entry.num_vptrs;
+        if (member.in_virtual_base || !has_virtual_functions) {
+          ++entry.num_extra_vptrs;
+          continue;
+        }
+        size = llvm::alignTo(size, m_options.pointer_size) + m_options.pointer_size;
+        continue;
+      }
+
+      const auto* variable = std::get_if<Field::MemberVariable>(&member.field->data);
+      // Bases that could not be expanded are unknown records.
+      if (!variable)
+        continue;
+
+      if (!IsBitfield(member)) {
+        size = llvm::alignTo(size, std::max<std::size_t>(variable->alignment, 1)) + variable->size;
+        continue;
+      }
+
+      // A run of bitfields keeps the storage it occupies in the actual layout.
+      if (i != 0 && IsBitfield(members[i - 1]))
+        continue;
+      std::size_t end = record.data_size;
+      for (std::size_t j = i + 1; j < members.size(); ++j) {
+        if (!IsBitfield(members[j])) {
+          end = members[j].offset;
+          break;
+        }
+      }
+      size += end > member.offset ? end - member.offset : variable->size;
+    }
+
+    return llvm::alignTo(size, std::max<std::size_t>(record.alignment, 1));
+  }
+
+  const TypeIndex& m_index;
+  const VirtualInheritanceOptions& m_options;
+  LayoutExpander m_expander;
+};
+
+}  // namespace
+
+VirtualInheritanceReport AnalyzeVirtualInheritance(const TypeIndex& index,
+                                                   const VirtualInheritanceOptions& options) {
+  return VirtualInheritanceAnalyzer{index, options}.Analyze();
+}
+
+void PrintVirtualInheritanceReport(llvm::raw_ostream& os, const VirtualInheritanceReport& report) {
+  os << fmt::format("records with virtual bases: {}, {} vbase offsets, {} vcall offsets, "
+                    "{} extra vtable pointers\n",
+                    report.num_records, report.total_vbase_offsets, report.total_vcall_offsets,
+                    report.total_extra_vptrs);
+
+  for (const Entry& entry : report.entries) {
+    os << fmt::format("\n  {} (size {:#x}, {:#x} without virtual inheritance): "
+                      "{} bytes overhead per instance\n",
+                      entry.record_name, entry.size, entry.non_virtual_size, entry.size_overhead);
+    os << fmt::format("    {} vtable pointers ({} extra), {} vbase offsets and {} vcall offsets "
+                      "({} vtable bytes)\n",
+                      entry.num_vptrs, entry.num_extra_vptrs, entry.num_vbase_offsets,
+                      entry.num_vcall_offsets, entry.vtable_offset_bytes);
+
+    for (const VirtualBase& vbase : entry.virtual_bases) {
+      os << fmt::format("    [{:#x}] virtual base {} (data size {:#x})\n", vbase.offset,
+                        vbase.type_name, vbase.size);
+    }
+  }
+}
+
+}  // namespace classgen
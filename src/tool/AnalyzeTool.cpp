@@ -0,0 +1,313 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/raw_ostream.h>
+#include "classgen/CountTable.h"
+#include "classgen/Json.h"
+#include "classgen/Layout.h"
+#include "classgen/Record.h"
+#include "classgen/analysis/Bitfields.h"
+#include "classgen/analysis/Devirtualization.h"
+#include "classgen/analysis/EboMisses.h"
+#include "classgen/analysis/ExpandedLayout.h"
+#include "classgen/analysis/HeapFootprint.h"
+#include "classgen/analysis/HotColdSplit.h"
+#include "classgen/analysis/MemberPacking.h"
+#include "classgen/analysis/OverAlignment.h"
+#include "classgen/analysis/SizeDistribution.h"
+#include "classgen/analysis/SoaCandidates.h"
+#include "classgen/analysis/VariantDiff.h"
+#include "classgen/analysis/VirtualInheritance.h"
+#include "classgen/analysis/VTableStats.h"
+#include "OptionParsers.h"
+
+namespace cl = llvm::cl;
+
+enum class Report {
+  HotColdSplit,
+  HeapFootprint,
+  Devirtualization,
+  VTableStats,
+  Bitfields,
+  MemberPacking,
+  OverAlignment,
+  SoaCandidates,
+  VariantDiff,
+  EboMisses,
+  SizeDistribution,
+  ExpandedLayout,
+  VirtualInheritance,
+};
+
+static cl::OptionCategory MyToolCategory("classgen-analyze options");
+static cl::opt<std::string> OptInput{cl::Positional, cl::desc("<type dump>"), cl::Required,
+                                     cl::cat(MyToolCategory)};
+static cl::list<Report> OptReports{
+    "report", cl::desc("report to generate (can be specified several times)"),
+    cl::values(clEnumValN(Report::HotColdSplit, "hot-cold",
+                          "hot/cold split and hot field clustering suggestions "
+                          "(requires --field-profile)"),
+               clEnumValN(Report::HeapFootprint, "heap",
+                          "heap footprint per type (requires --instance-counts)"),
+               clEnumValN(Report::Devirtualization, "devirt",
+                          "devirtualization opportunities (optionally uses --call-counts)"),
+               clEnumValN(Report::VTableStats, "vtables",
+                          "vtable, thunk and secondary vtable pointer overhead"),
+               clEnumValN(Report::Bitfields, "bitfields", "bitfield packing efficiency"),
+               clEnumValN(Report::MemberPacking, "packing",
+                          "bool and enum packing suggestions (optionally uses --instance-counts)"),
+               clEnumValN(Report::OverAlignment, "alignment",
+                          "over-aligned records and the padding they cause"),
+               clEnumValN(Report::SoaCandidates, "soa",
+                          "array of structs to structure of arrays candidates"),
+               clEnumValN(Report::VariantDiff, "variants",
+                          "layout differences between targets or configurations"),
+               clEnumValN(Report::EboMisses, "ebo",
+                          "empty members and empty bases that take up space"),
+               clEnumValN(Report::SizeDistribution, "size-distribution",
+                          "record size, field count and vtable length histograms (JSON)"),
+               clEnumValN(Report::ExpandedLayout, "expand",
+                          "leaf members with absolute offsets and access paths "
+                          "(optionally uses --record)"),
+               clEnumValN(Report::VirtualInheritance, "virtual-bases",
+                          "virtual inheritance cost (offset entries, vtable pointers, size)")),
+    cl::OneOrMore, cl::cat(MyToolCategory)};
+static cl::opt<std::string> OptFieldProfile{
+    "field-profile",
+    cl::desc("field access profile (CSV: record,field,count or record::field,count)"),
+    cl::value_desc("path"), cl::cat(MyToolCategory)};
+static cl::opt<std::string> OptInstanceCounts{
+    "instance-counts", cl::desc("live instance counts (CSV: type,count)"), cl::value_desc("path"),
+    cl::cat(MyToolCategory)};
+static cl::opt<std::string> OptCallCounts{
+    "call-counts",
+    cl::desc("virtual call counts (CSV: class,function,count or class::function,count)"),
+    cl::value_desc("path"), cl::cat(MyToolCategory)};
+static cl::opt<unsigned> OptMaxDepth{"max-depth",
+                                     cl::desc("maximum expansion depth for nested subobjects"),
+                                     cl::init(2), cl::cat(MyToolCategory)};
+static cl::opt<unsigned> OptMaxEntries{"max-entries",
+                                       cl::desc("maximum number of entries per list (0 = all)"),
+                                       cl::init(50), cl::cat(MyToolCategory)};
+static cl::opt<unsigned> OptPointerSize{"pointer-size",
+                                        cl::desc("size of a pointer on the target in bytes"),
+                                        cl::init(8), cl::cat(MyToolCategory)};
+static cl::opt<unsigned, false, CacheLineSizeParser> OptCacheLineSize{
+    "cache-line-size", cl::desc("cache line size in bytes (must be a power of two)"),
+    cl::init(64), cl::cat(MyToolCategory)};
+static cl::list<std::string> OptContainerTemplates{
+    "container-templates",
+    cl::desc("container templates to consider for the soa report "
+             "(default: std::array, std::deque, std::vector)"),
+    cl::CommaSeparated, cl::value_desc("names"), cl::cat(MyToolCategory)};
+static cl::opt<std::string> OptSourceRoot{
+    "source-root",
+    cl::desc("prefix to strip from source file paths in the size-distribution report"),
+    cl::value_desc("path"), cl::cat(MyToolCategory)};
+static cl::list<std::string> OptRecords{
+    "record", cl::desc("record to print in the expand report (can be specified several times)"),
+    cl::value_desc("name"), cl::cat(MyToolCategory)};
+static cl::opt<std::string> OptLabel{
+    "label", cl::desc("label for the size-distribution report (e.g. a commit hash)"),
+    cl::value_desc("label"), cl::cat(MyToolCategory)};
+
+static bool LoadCountTable(const std::string& path, bool has_member_column,
+                           std::string_view option_name, classgen::CountTable& table) {
+  if (path.empty()) {
+    llvm::errs() << "this report requires --" << option_name << '\n';
+    return false;
+  }
+
+  table = classgen::ReadCountTable(path, has_member_column);
+  if (!table) {
+    llvm::errs() << table.error << '\n';
+    return false;
+  }
+
+  return true;
+}
+
+static bool RunHotColdSplit(const classgen::ParseResult& result) {
+  classgen::CountTable profile;
+  if (!LoadCountTable(OptFieldProfile, true, "field-profile", profile))
+    return false;
+
+  classgen::HotColdOptions options;
+  options.cache_line_size = OptCacheLineSize;
+  options.pointer_size = OptPointerSize;
+  classgen::PrintHotColdReport(llvm::outs(),
+                               classgen::AnalyzeHotColdSplit(result, profile, options));
+  return true;
+}
+
+static bool RunHeapFootprint(const classgen::TypeIndex& index) {
+  classgen::CountTable instances;
+  if (!LoadCountTable(OptInstanceCounts, false, "instance-counts", instances))
+    return false;
+
+  classgen::HeapFootprintOptions options;
+  options.max_depth = OptMaxDepth;
+  options.max_entries = OptMaxEntries;
+  classgen::PrintHeapFootprintReport(llvm::outs(),
+                                     classgen::AnalyzeHeapFootprint(index, instances, options));
+  return true;
+}
+
+static bool RunDevirtualization(const classgen::TypeIndex& index) {
+  classgen::CountTable call_counts;
+  if (!OptCallCounts.empty() && !LoadCountTable(OptCallCounts, true, "call-counts", call_counts))
+    return false;
+
+  classgen::PrintDevirtualizationReport(
+      llvm::outs(),
+      classgen::AnalyzeDevirtualization(index, OptCallCounts.empty() ? nullptr : &call_counts));
+  return true;
+}
+
+static bool RunVTableStats(const classgen::ParseResult& result) {
+  classgen::VTableStatsOptions options;
+  options.pointer_size = OptPointerSize;
+  options.max_entries = OptMaxEntries;
+  classgen::PrintVTableStatsReport(llvm::outs(), classgen::AnalyzeVTableStats(result, options));
+  return true;
+}
+
+static bool RunBitfields(const classgen::ParseResult& result) {
+  classgen::BitfieldOptions options;
+  options.max_entries = OptMaxEntries;
+  classgen::PrintBitfieldReport(llvm::outs(), classgen::AnalyzeBitfields(result, options));
+  return true;
+}
+
+static bool RunMemberPacking(const classgen::TypeIndex& index) {
+  classgen::CountTable instances;
+  if (!OptInstanceCounts.empty() &&
+      !LoadCountTable(OptInstanceCounts, false, "instance-counts", instances)) {
+    return false;
+  }
+
+  classgen::MemberPackingOptions options;
+  options.max_entries = OptMaxEntries;
+  classgen::PrintMemberPackingReport(
+      llvm::outs(), classgen::AnalyzeMemberPacking(
+                        index, OptInstanceCounts.empty() ? nullptr : &instances, options));
+  return true;
+}
+
+static bool RunOverAlignment(const classgen::TypeIndex& index) {
+  classgen::OverAlignmentOptions options;
+  options.pointer_size = OptPointerSize;
+  options.max_entries = OptMaxEntries;
+  classgen::PrintOverAlignmentReport(llvm::outs(),
+                                     classgen::AnalyzeOverAlignment(index, options));
+  return true;
+}
+
+static bool RunSoaCandidates(const classgen::TypeIndex& index) {
+  classgen::SoaCandidateOptions options;
+  if (!OptContainerTemplates.empty())
+    options.container_templates.assign(OptContainerTemplates.begin(), OptContainerTemplates.end());
+  options.max_entries = OptMaxEntries;
+  classgen::PrintSoaCandidateReport(llvm::outs(), classgen::FindSoaCandidates(index, options));
+  return true;
+}
+
+static bool RunVariantDiff(const classgen::ParseResult& result) {
+  classgen::PrintVariantDiffReport(llvm::outs(), classgen::DiffVariants(result));
+  return true;
+}
+
+static bool RunEboMisses(const classgen::TypeIndex& index) {
+  classgen::EboMissOptions options;
+  options.max_entries = OptMaxEntries;
+  classgen::PrintEboMissReport(llvm::outs(), classgen::AnalyzeEboMisses(index, options));
+  return true;
+}
+
+static bool RunSizeDistribution(const classgen::TypeIndex& index) {
+  classgen::SizeDistributionOptions options;
+  options.source_root = OptSourceRoot;
+  options.label = OptLabel;
+  classgen::PrintSizeDistributionReport(llvm::outs(),
+                                        classgen::AnalyzeSizeDistribution(index, options));
+  return true;
+}
+
+static bool RunExpandedLayout(const classgen::TypeIndex& index) {
+  classgen::ExpandedLayoutOptions options;
+  options.records.assign(OptRecords.begin(), OptRecords.end());
+  return classgen::PrintExpandedLayouts(llvm::outs(), index, options);
+}
+
+static bool RunVirtualInheritance(const classgen::TypeIndex& index) {
+  classgen::VirtualInheritanceOptions options;
+  options.pointer_size = OptPointerSize;
+  options.max_entries = OptMaxEntries;
+  classgen::PrintVirtualInheritanceReport(llvm::outs(),
+                                          classgen::AnalyzeVirtualInheritance(index, options));
+  return true;
+}
+
+int main(int argc, const char** argv) {
+  cl::HideUnrelatedOptions(MyToolCategory);
+  cl::ParseCommandLineOptions(argc, argv, "classgen type dump analyzer\n");
+
+  const auto result = classgen::ReadJsonFile(OptInput);
+  if (!result) {
+    llvm::errs() << result.error << '\n';
+    return 1;
+  }
+
+  const classgen::TypeIndex index{result};
+
+  bool ok = true;
+  for (std::size_t i = 0; i < OptReports.size(); ++i) {
+    if (i != 0)
+      llvm::outs() << '\n';
+
+    switch (OptReports[i]) {
+    case Report::HotColdSplit:
+      ok &= RunHotColdSplit(result);
+      break;
+    case Report::HeapFootprint:
+      ok &= RunHeapFootprint(index);
+      break;
+    case Report::Devirtualization:
+      ok &= RunDevirtualization(index);
+      break;
+    case Report::VTableStats:
+      ok &= RunVTableStats(result);
+      break;
+    case Report::Bitfields:
+      ok &= RunBitfields(result);
+      break;
+    case Report::MemberPacking:
+      ok &= RunMemberPacking(index);
+      break;
+    case Report::OverAlignment:
+      ok &= RunOverAlignment(index);
+      break;
+    case Report::SoaCandidates:
+      ok &= RunSoaCandidates(index);
+      break;
+    case Report::VariantDiff:
+      ok &= RunVariantDiff(result);
+      break;
+    case Report::EboMisses:
+      ok &= RunEboMisses(index);
+      break;
+    case Report::SizeDistribution:
+      ok &= RunSizeDistribution(index);
+      break;
+    case Report::ExpandedLayout:
+      ok &= RunExpandedLayout(index);
+      break;
+    case Report::VirtualInheritance:
+      ok &= RunVirtualInheritance(index);
+      break;
+    }
+  }
+
+  return ok ? 0 : 1;
+}
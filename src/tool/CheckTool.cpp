@@ -0,0 +1,88 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include <optional>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/raw_ostream.h>
+#include "classgen/Json.h"
+#include "classgen/Layout.h"
+#include "classgen/Record.h"
+#include "classgen/analysis/LayoutCheck.h"
+#include "OptionParsers.h"
+
+namespace cl = llvm::cl;
+
+// Exit codes.
+constexpr int ExitOk = 0;
+constexpr int ExitViolations = 1;
+constexpr int ExitError = 2;
+
+static cl::OptionCategory MyToolCategory("classgen-check options");
+static cl::opt<std::string> OptInput{cl::Positional, cl::desc("<type dump>"), cl::Required,
+                                     cl::cat(MyToolCategory)};
+static cl::opt<std::string> OptBaseline{
+    "baseline", cl::desc("baseline type dump to compare against"), cl::value_desc("path"),
+    cl::cat(MyToolCategory)};
+static cl::opt<std::string> OptPolicy{
+    "policy",
+    cl::desc("layout policy file (default: sizes, alignments and padding must not grow)"),
+    cl::value_desc("path"), cl::cat(MyToolCategory)};
+static cl::opt<unsigned, false, CacheLineSizeParser> OptCacheLineSize{
+    "cache-line-size", cl::desc("cache line size in bytes (must be a power of two)"),
+    cl::init(64), cl::cat(MyToolCategory)};
+
+int main(int argc, const char** argv) {
+  cl::HideUnrelatedOptions(MyToolCategory);
+  if (!cl::ParseCommandLineOptions(argc, argv,
+                                   "classgen layout checker\n\n"
+                                   "Exits with status 1 if the policy is violated and 2 on "
+                                   "errors.\n",
+                                   &llvm::errs())) {
+    return ExitError;
+  }
+
+  const auto policy = OptPolicy.empty() ? classgen::LayoutPolicy::Default()
+                                        : classgen::ReadLayoutPolicy(OptPolicy);
+  if (!policy) {
+    llvm::errs() << policy.error << '\n';
+    return ExitError;
+  }
+
+  // Otherwise every baseline rule would be skipped and the check would always pass.
+  if (OptBaseline.empty() && policy.HasBaselineRules()) {
+    llvm::errs() << (OptPolicy.empty() ? "the default policy" : "the policy")
+                 << " compares against a baseline: --baseline must be specified\n";
+    return ExitError;
+  }
+
+  std::optional<classgen::ParseResult> baseline;
+  if (!OptBaseline.empty()) {
+    baseline = classgen::ReadJsonFile(OptBaseline);
+    if (!*baseline) {
+      llvm::errs() << baseline->error << '\n';
+      return ExitError;
+    }
+  }
+
+  const auto current = classgen::ReadJsonFile(OptInput);
+  if (!current) {
+    llvm::errs() << current.error << '\n';
+    return ExitError;
+  }
+
+  std::optional<classgen::TypeIndex> baseline_index;
+  if (baseline)
+    baseline_index.emplace(*baseline);
+  const classgen::TypeIndex current_index{current};
+
+  classgen::LayoutCheckOptions options;
+  options.cache_line_size = OptCacheLineSize;
+  const auto result = classgen::CheckLayouts(baseline_index ? &*baseline_index : nullptr,
+                                             current_index, policy, options);
+
+  classgen::PrintLayoutCheckResult(llvm::outs(), result);
+
+  if (!result.error.empty())
+    return ExitError;
+  return result.violations.empty() ? ExitOk : ExitViolations;
+}
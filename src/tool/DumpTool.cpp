@@ -1,268 +1,618 @@
 // Copyright (c) 2021 leoetlino
 // SPDX-License-Identifier: MIT
 
+#include <chrono>
+#include <deque>
 #include <clang/Frontend/FrontendActions.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
 #include <clang/Tooling/CommonOptionsParser.h>
+#include <clang/Tooling/CompilationDatabase.h>
 #include <clang/Tooling/Tooling.h>
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSet.h>
 #include <llvm/Support/CommandLine.h>
-#include <llvm/Support/JSON.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/raw_ostream.h>
+#include "classgen/CompilationDatabase.h"
+#include "classgen/Json.h"
+#include "classgen/Layout.h"
+#include "classgen/LayoutAsserts.h"
 #include "classgen/Record.h"
+#include "classgen/analysis/SizeDistribution.h"
+#include "classgen/analysis/VariantDiff.h"
 
 namespace cl = llvm::cl;
 
+enum class OutputFormat {
+  Json,
+  LayoutAsserts,
+};
+
 static cl::OptionCategory MyToolCategory("classgen options");
 static cl::extrahelp CommonHelp(clang::tooling::CommonOptionsParser::HelpMessage);
+// Same options as clang::tooling::CommonOptionsParser, which cannot be used because it always
+// loads the entire compilation database.
+static cl::opt<std::string> OptBuildPath{"p", cl::desc("Build path"), cl::Optional,
+                                         cl::cat(MyToolCategory)};
+static cl::list<std::string> OptSourcePaths{cl::Positional, cl::desc("<source0> [... <sourceN>]"),
+                                            cl::OneOrMore, cl::cat(MyToolCategory)};
+static cl::list<std::string> OptExtraArgs{
+    "extra-arg", cl::desc("Additional argument to append to the compiler command line"),
+    cl::cat(MyToolCategory)};
+static cl::list<std::string> OptExtraArgsBefore{
+    "extra-arg-before", cl::desc("Additional argument to prepend to the compiler command line"),
+    cl::cat(MyToolCategory)};
 static cl::opt<bool> OptInlineEmptyStructs{"i", cl::desc("inline empty structs"),
                                            cl::cat(MyToolCategory)};
+static cl::list<std::string> OptTargets{
+    "target",
+    cl::desc("target triple to extract layouts for (can be specified several times; "
+             "the first target provides the main layouts)"),
+    cl::value_desc("triple"), cl::cat(MyToolCategory)};
+static cl::list<std::string> OptDefineSets{
+    "define-set",
+    cl::desc("named set of macro definitions to extract layouts for, e.g. "
+             "debug:DEBUG,LOG_LEVEL=2 (can be specified several times; "
+             "the first set provides the main layouts)"),
+    cl::value_desc("name:defines"), cl::cat(MyToolCategory)};
+static cl::opt<bool> OptCheckLayoutConflicts{
+    "check-layout-conflicts",
+    cl::desc("report types that have different layouts in different translation units"),
+    cl::cat(MyToolCategory)};
+static cl::opt<bool> OptNoSharedPreambles{
+    "no-shared-preambles",
+    cl::desc("do not share precompiled preambles between translation units that have the same "
+             "flags and leading #includes, and process translation units in the given order"),
+    cl::cat(MyToolCategory)};
+static cl::list<std::string> OptRetryWith{
+    "retry-with",
+    cl::desc("space-separated compiler arguments to retry failed translation units with "
+             "(can be specified several times; retries are attempted in order)"),
+    cl::value_desc("args"), cl::cat(MyToolCategory)};
+static cl::opt<unsigned> OptTuTimeout{
+    "tu-timeout",
+    cl::desc("maximum time to spend on a translation unit, in seconds (0 = no limit); "
+             "translation units are parsed in separate processes if a limit is set"),
+    cl::value_desc("seconds"), cl::init(0), cl::cat(MyToolCategory)};
+static cl::opt<unsigned> OptTuMemoryLimit{
+    "tu-memory-limit",
+    cl::desc("maximum amount of memory that a translation unit may use, in MiB (0 = no limit); "
+             "translation units are parsed in separate processes if a limit is set"),
+    cl::value_desc("MiB"), cl::init(0), cl::cat(MyToolCategory)};
+static cl::opt<std::string> OptWorkerOutput{
+    "worker-output", cl::desc("parse translation units and write a JSON type dump to a file"),
+    cl::value_desc("path"), cl::Hidden, cl::cat(MyToolCategory)};
+static cl::opt<std::string> OptSizeDistribution{
+    "size-distribution",
+    cl::desc("also write the size-distribution report for the dumped records to a file "
+             "(same as classgen-analyze --report=size-distribution)"),
+    cl::value_desc("path"), cl::cat(MyToolCategory)};
+static cl::opt<std::string> OptSourceRoot{
+    "source-root",
+    cl::desc("prefix to strip from source file paths in the size-distribution report"),
+    cl::value_desc("path"), cl::cat(MyToolCategory)};
+static cl::opt<std::string> OptLabel{
+    "label", cl::desc("label for the size-distribution report (e.g. a commit hash)"),
+    cl::value_desc("label"), cl::cat(MyToolCategory)};
+static cl::opt<OutputFormat> OptFormat{
+    "format", cl::desc("output format"),
+    cl::values(clEnumValN(OutputFormat::Json, "json", "JSON type dump"),
+               clEnumValN(OutputFormat::LayoutAsserts, "layout-asserts",
+                          "C++ header with sizeof, alignof and offsetof static_asserts")),
+    cl::init(OutputFormat::Json), cl::cat(MyToolCategory)};
+static cl::list<std::string> OptAssertRecords{
+    "assert-record",
+    cl::desc("record to generate layout checks for (can be specified several times; "
+             "default: all records)"),
+    cl::value_desc("name"), cl::cat(MyToolCategory)};
+static cl::opt<bool> OptNoOffsetAsserts{
+    "no-offset-asserts", cl::desc("only check sizes and alignments in layout-asserts output"),
+    cl::cat(MyToolCategory)};
+
+/// Builds one variant per combination of target and define set. Returns false on error.
+static bool BuildVariants(std::vector<classgen::ParseVariant>& variants) {
+  std::vector<classgen::ParseVariant> define_sets;
+  for (llvm::StringRef define_set : OptDefineSets) {
+    const auto [name, defines] = define_set.split(':');
+    if (name.empty()) {
+      llvm::errs() << "invalid define set (expected name:defines): " << define_set << '\n';
+      return false;
+    }
 
-// must be called inside an object block
-static void DumpComplexType(llvm::json::OStream& out, const classgen::ComplexType& type) {
-  const auto write_common = [&](llvm::StringRef kind) { out.attribute("kind", kind); };
-
-  switch (type.GetKind()) {
-  case classgen::ComplexType::Kind::TypeName: {
-    const auto& name = static_cast<const classgen::ComplexTypeName&>(type);
-    write_common("type_name");
-    out.attribute("name", name.name);
-    out.attribute("is_const", name.is_const);
-    out.attribute("is_volatile", name.is_volatile);
-    break;
+    classgen::ParseVariant& variant = define_sets.emplace_back();
+    variant.name = name.str();
+    llvm::SmallVector<llvm::StringRef, 8> macros;
+    defines.split(macros, ',', -1, false);
+    for (llvm::StringRef macro : macros)
+      variant.args.push_back("-D" + macro.trim().str());
   }
 
-  case classgen::ComplexType::Kind::Pointer: {
-    const auto& ptr = static_cast<const classgen::ComplexTypePointer&>(type);
-    write_common("pointer");
-    out.attributeObject("pointee_type", [&] { DumpComplexType(out, *ptr.pointee_type); });
-    break;
+  std::vector<classgen::ParseVariant> targets;
+  for (const std::string& target : OptTargets)
+    targets.push_back({target, {"--target=" + target}});
+
+  if (targets.empty() || define_sets.empty()) {
+    variants = targets.empty() ? std::move(define_sets) : std::move(targets);
+    return true;
   }
 
-  case classgen::ComplexType::Kind::Array: {
-    const auto& array = static_cast<const classgen::ComplexTypeArray&>(type);
-    write_common("array");
-    out.attributeObject("element_type", [&] { DumpComplexType(out, *array.element_type); });
-    out.attribute("size", array.size);
-    break;
+  for (const classgen::ParseVariant& target : targets) {
+    for (const classgen::ParseVariant& define_set : define_sets) {
+      classgen::ParseVariant& variant = variants.emplace_back();
+      variant.name = target.name + "/" + define_set.name;
+      variant.args = target.args;
+      llvm::append_range(variant.args, define_set.args);
+    }
   }
 
-  case classgen::ComplexType::Kind::Function: {
-    const auto& fn = static_cast<const classgen::ComplexTypeFunction&>(type);
-    write_common("function");
+  return true;
+}
 
-    out.attributeArray("param_types", [&] {
-      for (const auto& param_type : fn.param_types)
-        out.object([&] { DumpComplexType(out, *param_type); });
-    });
+/// Loads a compilation database from a directory. JSON databases are loaded through an index.
+static std::unique_ptr<clang::tooling::CompilationDatabase>
+LoadCompilationsFromDirectory(llvm::StringRef directory, std::string& error) {
+  llvm::SmallString<256> json_path{directory};
+  llvm::sys::path::append(json_path, "compile_commands.json");
+  if (llvm::sys::fs::exists(json_path)) {
+    if (auto compilations = classgen::LoadIndexedCompilationDatabase(directory.str(), error))
+      return compilations;
+  }
+  // Not a JSON compilation database (e.g. compile_flags.txt).
+  return clang::tooling::CompilationDatabase::autoDetectFromDirectory(directory, error);
+}
 
-    out.attributeObject("return_type", [&] { DumpComplexType(out, *fn.return_type); });
-    break;
+/// Same lookup as CompilationDatabase::autoDetectFromSource (the closest parent directory of
+/// the source file that contains a compilation database), but with indexed JSON databases.
+static std::unique_ptr<clang::tooling::CompilationDatabase>
+AutoDetectCompilations(llvm::StringRef source, std::string& error) {
+  llvm::SmallString<256> path{source};
+  llvm::sys::fs::make_absolute(path);
+  llvm::sys::path::remove_dots(path, true);
+
+  for (llvm::StringRef directory = llvm::sys::path::parent_path(path); !directory.empty();
+       directory = llvm::sys::path::parent_path(directory)) {
+    std::string directory_error;
+    if (auto compilations = LoadCompilationsFromDirectory(directory, directory_error))
+      return compilations;
   }
 
-  case classgen::ComplexType::Kind::MemberPointer: {
-    const auto& ptr = static_cast<const classgen::ComplexTypeMemberPointer&>(type);
-    write_common("member_pointer");
-    out.attributeObject("class_type", [&] { DumpComplexType(out, *ptr.class_type); });
-    out.attributeObject("pointee_type", [&] { DumpComplexType(out, *ptr.pointee_type); });
-    out.attribute("repr", ptr.repr);
-    break;
+  error = fmt::format("no compilation database found for {} or in any parent directory",
+                      source.str());
+  return nullptr;
+}
+
+/// Loads the compilation database from the build path, from the arguments after `--`,
+/// or from a parent directory of the first source file.
+static std::unique_ptr<clang::tooling::CompilationDatabase> LoadCompilations(int& argc,
+                                                                             const char** argv) {
+  std::string error;
+  std::unique_ptr<clang::tooling::CompilationDatabase> compilations =
+      clang::tooling::FixedCompilationDatabase::loadFromCommandLine(argc, argv, error);
+  if (!error.empty()) {
+    llvm::errs() << error << '\n';
+    return nullptr;
   }
 
-  case classgen::ComplexType::Kind::Atomic: {
-    const auto& ptr = static_cast<const classgen::ComplexTypeAtomic&>(type);
-    write_common("atomic");
-    out.attributeObject("value_type", [&] { DumpComplexType(out, *ptr.value_type); });
-    break;
+  cl::HideUnrelatedOptions(MyToolCategory);
+  if (!cl::ParseCommandLineOptions(argc, argv))
+    return nullptr;
+
+  if (!compilations) {
+    if (!OptBuildPath.empty())
+      compilations = LoadCompilationsFromDirectory(OptBuildPath, error);
+    else
+      compilations = AutoDetectCompilations(OptSourcePaths.front(), error);
+
+    if (!compilations) {
+      llvm::errs() << "failed to load compilation database: " << error << '\n';
+      return nullptr;
+    }
   }
+
+  auto adjusting_compilations =
+      std::make_unique<clang::tooling::ArgumentsAdjustingCompilations>(std::move(compilations));
+  adjusting_compilations->appendArgumentsAdjuster(clang::tooling::getInsertArgumentAdjuster(
+      clang::tooling::CommandLineArguments(OptExtraArgsBefore.begin(), OptExtraArgsBefore.end()),
+      clang::tooling::ArgumentInsertPosition::BEGIN));
+  adjusting_compilations->appendArgumentsAdjuster(clang::tooling::getInsertArgumentAdjuster(
+      clang::tooling::CommandLineArguments(OptExtraArgs.begin(), OptExtraArgs.end()),
+      clang::tooling::ArgumentInsertPosition::END));
+  return adjusting_compilations;
+}
+
+/// Returns the command line of a worker process that parses a single translation unit.
+static std::vector<std::string> GetWorkerArgs(const std::string& program, const std::string& file,
+                                              const std::string& output,
+                                              llvm::ArrayRef<std::string> fixed_args) {
+  std::vector<std::string> args{program};
+  if (!OptBuildPath.empty())
+    args.push_back("-p=" + OptBuildPath);
+  for (const std::string& arg : OptExtraArgs)
+    args.push_back("--extra-arg=" + arg);
+  for (const std::string& arg : OptExtraArgsBefore)
+    args.push_back("--extra-arg-before=" + arg);
+  if (OptInlineEmptyStructs)
+    args.push_back("-i");
+  for (const std::string& target : OptTargets)
+    args.push_back("--target=" + target);
+  for (const std::string& define_set : OptDefineSets)
+    args.push_back("--define-set=" + define_set);
+  if (OptCheckLayoutConflicts)
+    args.push_back("--check-layout-conflicts");
+  if (OptNoSharedPreambles)
+    args.push_back("--no-shared-preambles");
+  for (const std::string& retry : OptRetryWith)
+    args.push_back("--retry-with=" + retry);
+  args.push_back("--worker-output=" + output);
+  args.push_back(file);
+  if (!fixed_args.empty()) {
+    args.push_back("--");
+    llvm::append_range(args, fixed_args);
   }
+  return args;
 }
 
-// must be called inside an object block
-static void DumpEnum(llvm::json::OStream& out, const classgen::Enum& enum_def) {
-  out.attribute("is_scoped", enum_def.is_scoped);
-  out.attribute("is_anonymous", enum_def.is_anonymous);
-  out.attribute("name", enum_def.name);
-  out.attribute("underlying_type_name", enum_def.underlying_type_name);
-  out.attribute("underlying_type_size", enum_def.underlying_type_size);
-
-  out.attributeArray("enumerators", [&] {
-    for (const classgen::Enum::Enumerator& entry : enum_def.enumerators) {
-      out.object([&] {
-        out.attribute("identifier", entry.identifier);
-        out.attribute("value", entry.value);
-      });
+/// Parses source files for a parent process. Unlike ParseRecords, the variants section of
+/// the result holds every type of each variant (not only the differences from the main
+/// result), because differences can only be computed once all workers are done.
+static classgen::ParseResult
+ParseRecordsForWorker(const clang::tooling::CompilationDatabase& compilations,
+                      const std::vector<std::string>& source_paths,
+                      const std::vector<classgen::ParseVariant>& variants,
+                      const classgen::ParseConfig& config) {
+  if (variants.empty())
+    return classgen::ParseRecords(compilations, source_paths, {}, config);
+
+  classgen::ParseResult result;
+  std::vector<std::string> errors;
+  for (std::size_t i = 0; i < variants.size(); ++i) {
+    auto variant_result =
+        classgen::ParseRecords(compilations, source_paths, {&variants[i], 1}, config);
+    if (!variant_result)
+      errors.push_back(std::move(variant_result.error));
+    llvm::append_range(result.layout_conflicts, std::move(variant_result.layout_conflicts));
+    llvm::append_range(result.translation_units, std::move(variant_result.translation_units));
+
+    if (i == 0) {
+      result.enums = std::move(variant_result.enums);
+      result.records = std::move(variant_result.records);
+      result.variant_name = variants[i].name;
+    } else {
+      classgen::ParseVariantResult& variant = result.variants.emplace_back();
+      variant.name = variants[i].name;
+      variant.enums = std::move(variant_result.enums);
+      variant.records = std::move(variant_result.records);
     }
-  });
+  }
+  result.error = llvm::join(errors, "; ");
+  return result;
 }
 
-// must be called inside an object block
-static void DumpVTableFunction(llvm::json::OStream& out,
-                               const classgen::VTableComponent::FunctionPointer& func) {
-  out.attribute("is_thunk", func.is_thunk);
-  out.attribute("is_const", func.is_const);
+/// Combines the results of worker processes. As in a single process, the first definition
+/// of a type wins and variants are compared with the main result once everything has been
+/// merged. Workers only detect layout conflicts inside their own translation unit, so records
+/// are compared again across workers.
+class WorkerResultMerger {
+public:
+  explicit WorkerResultMerger(bool check_layout_conflicts)
+      : m_check_layout_conflicts(check_layout_conflicts) {}
+
+  void Merge(classgen::ParseResult&& other, const std::string& translation_unit) {
+    MergeTypes(m_result, m_main_types, other.enums, other.records, translation_unit, {});
+
+    if (!other.variant_name.empty())
+      m_result.variant_name = std::move(other.variant_name);
+
+    for (classgen::ParseVariantResult& variant : other.variants) {
+      auto it = llvm::find_if(m_variants,
+                              [&](const RawVariant& raw) { return raw.name == variant.name; });
+      if (it == m_variants.end()) {
+        m_variants.emplace_back().name = variant.name;
+        it = std::prev(m_variants.end());
+      }
+      MergeTypes(it->result, it->types, variant.enums, variant.records, translation_unit,
+                 variant.name);
+    }
 
-  if (func.is_thunk) {
-    out.attribute("return_adjustment", func.return_adjustment);
-    out.attribute("return_adjustment_vbase_offset_offset",
-                  func.return_adjustment_vbase_offset_offset);
+    llvm::append_range(m_result.layout_conflicts, std::move(other.layout_conflicts));
+    m_result.inline_empty_structs |= other.inline_empty_structs;
+    for (classgen::TranslationUnitStatus& status : other.translation_units)
+      m_result.translation_units.emplace_back(std::move(status));
+  }
 
-    out.attribute("this_adjustment", func.this_adjustment);
-    out.attribute("this_adjustment_vcall_offset_offset", func.this_adjustment_vcall_offset_offset);
+  void AddStatus(classgen::TranslationUnitStatus status) {
+    m_result.translation_units.emplace_back(std::move(status));
   }
 
-  out.attribute("repr", func.repr);
-  out.attribute("function_name", func.function_name);
-  out.attributeObject("type", [&] { DumpComplexType(out, *func.type); });
-}
+  classgen::ParseResult Finish() {
+    for (RawVariant& variant : m_variants) {
+      m_result.variants.emplace_back(
+          classgen::MakeVariantResult(variant.name, m_result, std::move(variant.result)));
+    }
+    m_variants.clear();
+    return std::move(m_result);
+  }
 
-// must be called inside an object block
-static void DumpRecord(llvm::json::OStream& out, const classgen::Record& record) {
-  out.attribute("is_anonymous", record.is_anonymous);
-  out.attribute("kind", int(record.kind));
-  out.attribute("name", record.name);
-  out.attribute("size", record.size);
-  out.attribute("data_size", record.data_size);
-  out.attribute("alignment", record.alignment);
-
-  out.attributeArray("fields", [&] {
-    for (const classgen::Field& field : record.fields) {
-      // must be called inside an object block
-      const auto write_common = [&](llvm::StringRef kind) {
-        out.attribute("offset", field.offset);
-        out.attribute("kind", kind);
-      };
-
-      if (auto* member = std::get_if<classgen::Field::MemberVariable>(&field.data)) {
-        out.object([&] {
-          write_common("member");
-          if (member->bitfield_width != 0)
-            out.attribute("bitfield_width", member->bitfield_width);
-          out.attributeObject("type", [&] { DumpComplexType(out, *member->type); });
-          out.attribute("type_name", member->type_name);
-          out.attribute("name", member->name);
-        });
-        continue;
+private:
+  struct MergedRecord {
+    std::size_t record_idx;
+    std::string translation_unit;
+    /// Descriptions of the conflicting layouts that have already been reported.
+    std::vector<std::string> reported_layouts;
+  };
+
+  struct TypeNames {
+    llvm::StringSet<> enums;
+    llvm::StringMap<MergedRecord> records;
+  };
+
+  /// All types of a variant, merged from every worker.
+  struct RawVariant {
+    std::string name;
+    classgen::ParseResult result;
+    TypeNames types;
+  };
+
+  void MergeTypes(classgen::ParseResult& result, TypeNames& names,
+                  std::vector<classgen::Enum>& enums, std::vector<classgen::Record>& records,
+                  const std::string& translation_unit, llvm::StringRef variant_name) {
+    for (classgen::Enum& enum_def : enums) {
+      if (names.enums.insert(enum_def.name).second)
+        result.enums.emplace_back(std::move(enum_def));
+    }
+    for (classgen::Record& record : records) {
+      const auto [it, inserted] =
+          names.records.try_emplace(record.name, MergedRecord{result.records.size(), {}, {}});
+      if (inserted) {
+        it->second.translation_unit = translation_unit;
+        result.records.emplace_back(std::move(record));
+      } else if (m_check_layout_conflicts) {
+        CheckLayoutConflict(result.records[it->second.record_idx], it->second, record,
+                            translation_unit, variant_name);
       }
+    }
+  }
 
-      if (auto* base = std::get_if<classgen::Field::Base>(&field.data)) {
-        out.object([&] {
-          write_common("base");
-          out.attribute("is_primary", base->is_primary);
-          out.attribute("is_virtual", base->is_virtual);
-          out.attribute("type_name", base->type_name);
-        });
-        continue;
-      }
+  void CheckLayoutConflict(const classgen::Record& first, MergedRecord& merged,
+                           const classgen::Record& second, const std::string& translation_unit,
+                           llvm::StringRef variant_name) {
+    if (classgen::HaveSameLayout(first, second))
+      return;
+
+    std::string description = classgen::DescribeLayout(second);
+    if (llvm::is_contained(merged.reported_layouts, description))
+      return;
+    merged.reported_layouts.push_back(description);
+
+    classgen::LayoutConflict& conflict = m_result.layout_conflicts.emplace_back();
+    conflict.name = variant_name.empty() ? first.name
+                                         : fmt::format("{} [{}]", first.name, variant_name.str());
+    conflict.first.translation_unit = merged.translation_unit;
+    conflict.first.description = classgen::DescribeLayout(first);
+    conflict.second.translation_unit = translation_unit;
+    conflict.second.description = std::move(description);
+  }
 
-      if (auto* vtable_ptr = std::get_if<classgen::Field::VTablePointer>(&field.data)) {
-        out.object([&] {
-          write_common("vtable_ptr");
-          // No other attributes.
-        });
+  bool m_check_layout_conflicts;
+  classgen::ParseResult m_result;
+  TypeNames m_main_types;
+  /// Not a vector: StringSet and StringMap are not nothrow movable, so vector would try to copy
+  /// elements.
+  std::deque<RawVariant> m_variants;
+};
+
+/// Parses every translation unit in a separate process, so that time and memory limits
+/// can be enforced without affecting the other translation units.
+static classgen::ParseResult ParseInWorkers(const char* argv0,
+                                            const std::vector<std::string>& source_paths,
+                                            llvm::ArrayRef<std::string> fixed_args) {
+  static int StaticSymbol;
+  const std::string program = llvm::sys::fs::getMainExecutable(argv0, &StaticSymbol);
+
+  WorkerResultMerger merger{OptCheckLayoutConflicts};
+  std::size_t num_parsed = 0;
+  for (const std::string& file : source_paths) {
+    llvm::SmallString<128> output;
+    if (const auto ec = llvm::sys::fs::createTemporaryFile("classgen-worker", "json", output))
+      return classgen::ParseResult::Fail("failed to create temporary file: " + ec.message());
+
+    const std::vector<std::string> args =
+        GetWorkerArgs(program, file, std::string(output), fixed_args);
+    const std::vector<llvm::StringRef> arg_refs{args.begin(), args.end()};
+
+    std::string error;
+    bool execution_failed = false;
+    const auto start = std::chrono::steady_clock::now();
+    const int ret = llvm::sys::ExecuteAndWait(program, arg_refs, llvm::None, {}, OptTuTimeout,
+                                              OptTuMemoryLimit, &error, &execution_failed);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    if (execution_failed) {
+      llvm::sys::fs::remove(output);
+      return classgen::ParseResult::Fail("failed to start worker process: " + error);
+    }
+
+    auto worker_result =
+        ret == 0 ? classgen::ReadJsonFile(std::string(output)) : classgen::ParseResult();
+    llvm::sys::fs::remove(output);
+
+    if (ret == 0 && worker_result) {
+      // Workers only report translation units that failed or had to be retried.
+      const auto& statuses = worker_result.translation_units;
+      if (statuses.empty())
+        merger.AddStatus({.file = file});
+      if (statuses.empty() || llvm::any_of(statuses, [](const auto& status) {
+            return status.status == classgen::TranslationUnitStatus::Kind::Ok;
+          })) {
+        ++num_parsed;
       }
+      merger.Merge(std::move(worker_result), file);
+      continue;
     }
-  });
-
-  if (record.vtable) {
-    out.attributeArray("vtable", [&] {
-      for (const classgen::VTableComponent& component : record.vtable->components) {
-        // must be called inside an object block
-        const auto write_common = [&](llvm::StringRef kind) { out.attribute("kind", kind); };
-
-        if (auto* vcallo = std::get_if<classgen::VTableComponent::VCallOffset>(&component.data)) {
-          out.object([&] {
-            write_common("vcall_offset");
-            out.attribute("offset", vcallo->offset);
-          });
-          continue;
-        }
-
-        if (auto* vbaseo = std::get_if<classgen::VTableComponent::VBaseOffset>(&component.data)) {
-          out.object([&] {
-            write_common("vbase_offset");
-            out.attribute("offset", vbaseo->offset);
-          });
-          continue;
-        }
-
-        if (auto* offset = std::get_if<classgen::VTableComponent::OffsetToTop>(&component.data)) {
-          out.object([&] {
-            write_common("offset_to_top");
-            out.attribute("offset", offset->offset);
-          });
-          continue;
-        }
-
-        if (auto* rtti = std::get_if<classgen::VTableComponent::RTTI>(&component.data)) {
-          out.object([&] {
-            write_common("rtti");
-            out.attribute("class_name", rtti->class_name);
-          });
-          continue;
-        }
-
-        if (auto* func = std::get_if<classgen::VTableComponent::FunctionPointer>(&component.data)) {
-          out.object([&] {
-            write_common("func");
-            DumpVTableFunction(out, *func);
-          });
-          continue;
-        }
-
-        if (auto* complete_dtor =
-                std::get_if<classgen::VTableComponent::CompleteDtorPointer>(&component.data)) {
-          out.object([&] {
-            write_common("complete_dtor");
-            DumpVTableFunction(out, *complete_dtor);
-          });
-          continue;
-        }
-
-        if (auto* deleting_dtor =
-                std::get_if<classgen::VTableComponent::DeletingDtorPointer>(&component.data)) {
-          out.object([&] {
-            write_common("deleting_dtor");
-            DumpVTableFunction(out, *deleting_dtor);
-          });
-          continue;
-        }
+
+    classgen::TranslationUnitStatus status;
+    status.file = file;
+    if (ret == 0) {
+      status.status = classgen::TranslationUnitStatus::Kind::Crashed;
+      status.diagnostics.push_back("failed to read worker output: " + worker_result.error);
+    } else if (OptTuTimeout != 0 && elapsed >= std::chrono::seconds(OptTuTimeout)) {
+      status.status = classgen::TranslationUnitStatus::Kind::TimedOut;
+      status.diagnostics.push_back(fmt::format("timed out after {} seconds", OptTuTimeout));
+    } else {
+      status.status = classgen::TranslationUnitStatus::Kind::Crashed;
+      status.diagnostics.push_back(
+          error.empty() ? fmt::format("worker process exited with status {}", ret) : error);
+      if (OptTuMemoryLimit != 0) {
+        status.diagnostics.push_back(
+            fmt::format("the memory limit ({} MiB) might have been exceeded", OptTuMemoryLimit));
       }
-    });
-  } else {
-    out.attribute("vtable", nullptr);
+    }
+    merger.AddStatus(std::move(status));
   }
+
+  classgen::ParseResult result = merger.Finish();
+  if (!source_paths.empty() && num_parsed == 0)
+    result.AddErrorContext("no translation unit could be parsed");
+  return result;
 }
 
-int main(int argc, const char** argv) {
-  auto MaybeOptionsParser = clang::tooling::CommonOptionsParser::create(argc, argv, MyToolCategory);
-  if (!MaybeOptionsParser)
-    return 1;
+static const char* GetStatusDescription(classgen::TranslationUnitStatus::Kind status) {
+  switch (status) {
+  case classgen::TranslationUnitStatus::Kind::Ok:
+    return "ok";
+  case classgen::TranslationUnitStatus::Kind::Failed:
+    return "compile errors";
+  case classgen::TranslationUnitStatus::Kind::TimedOut:
+    return "timed out";
+  case classgen::TranslationUnitStatus::Kind::Crashed:
+    return "crashed or ran out of memory";
+  case classgen::TranslationUnitStatus::Kind::Cancelled:
+    return "cancelled";
+  }
+  return "unknown";
+}
 
-  auto& OptionsParser = MaybeOptionsParser.get();
+/// Computes the size distribution of the dumped records without going through a JSON dump.
+static bool WriteSizeDistribution(const classgen::ParseResult& result) {
+  classgen::SizeDistributionOptions options;
+  options.source_root = OptSourceRoot;
+  options.label = OptLabel;
+  classgen::SizeDistributionBuilder builder{std::move(options)};
+  for (const classgen::Record& record : result.records)
+    builder.AddRecord(record);
+
+  std::error_code ec;
+  llvm::raw_fd_ostream os{OptSizeDistribution, ec};
+  if (ec) {
+    llvm::errs() << "failed to open " << OptSizeDistribution << ": " << ec.message() << '\n';
+    return false;
+  }
+  classgen::PrintSizeDistributionReport(os, builder.Finish());
+  return true;
+}
+
+int main(int argc, const char** argv) {
+  // Arguments after `--` are forwarded to worker processes.
+  std::vector<std::string> fixed_args;
+  for (int i = 1; i < argc; ++i) {
+    if (llvm::StringRef(argv[i]) == "--") {
+      fixed_args.assign(argv + i + 1, argv + argc);
+      break;
+    }
+  }
 
-  clang::tooling::ClangTool Tool(OptionsParser.getCompilations(),
-                                 OptionsParser.getSourcePathList());
+  const auto compilations = LoadCompilations(argc, argv);
+  if (!compilations)
+    return 1;
 
   classgen::ParseConfig config;
   config.inline_empty_structs = OptInlineEmptyStructs.getValue();
+  config.check_layout_conflicts = OptCheckLayoutConflicts.getValue();
+  config.share_preambles = !OptNoSharedPreambles;
+  for (llvm::StringRef retry : OptRetryWith) {
+    llvm::SmallVector<llvm::StringRef, 8> args;
+    retry.split(args, ' ', -1, false);
+    config.retry_args.emplace_back(args.begin(), args.end());
+  }
 
-  const auto result = classgen::ParseRecords(Tool, config);
+  std::vector<classgen::ParseVariant> variants;
+  if (!BuildVariants(variants))
+    return 1;
+
+  const std::vector<std::string> source_paths{OptSourcePaths.begin(), OptSourcePaths.end()};
+  if (!OptWorkerOutput.empty()) {
+    const auto result = ParseRecordsForWorker(*compilations, source_paths, variants, config);
+    if (!result.error.empty())
+      llvm::errs() << result.error << '\n';
+
+    std::error_code ec;
+    llvm::raw_fd_ostream os{OptWorkerOutput, ec};
+    if (ec) {
+      llvm::errs() << "failed to open " << OptWorkerOutput << ": " << ec.message() << '\n';
+      return 1;
+    }
+    classgen::WriteJson(os, result);
+    return 0;
+  }
+
+  const bool use_workers = OptTuTimeout != 0 || OptTuMemoryLimit != 0;
+  const auto result =
+      use_workers ? ParseInWorkers(argv[0], source_paths, fixed_args)
+                  : classgen::ParseRecords(*compilations, source_paths, variants, config);
 
   if (!result.error.empty()) {
     llvm::errs() << result.error << '\n';
   }
 
-  llvm::json::OStream out(llvm::outs());
+  for (const classgen::TranslationUnitStatus& status : result.translation_units) {
+    const auto variant = status.variant.empty() ? "" : " [" + status.variant + "]";
+    if (status.status != classgen::TranslationUnitStatus::Kind::Ok) {
+      llvm::errs() << "failed to parse " << status.file << variant << " ("
+                   << GetStatusDescription(status.status)
+                   << "; types from this file are missing from the output)\n";
+    } else if (!status.retry_args.empty()) {
+      llvm::errs() << "parsed " << status.file << variant << " after retrying with: "
+                   << llvm::join(status.retry_args, " ") << '\n';
+    }
+  }
+
+  for (const classgen::LayoutConflict& conflict : result.layout_conflicts) {
+    llvm::errs() << "layout conflict for " << conflict.name << ":\n"
+                 << "  " << conflict.first.translation_unit << ": " << conflict.first.description
+                 << "\n  " << conflict.second.translation_unit << ": "
+                 << conflict.second.description << '\n';
+  }
+
+  if (!result.variants.empty())
+    classgen::PrintVariantDiffReport(llvm::errs(), classgen::DiffVariants(result));
 
-  out.object([&] {
-    out.attributeArray("enums", [&] {
-      for (const classgen::Enum& enum_def : result.enums)
-        out.object([&] { DumpEnum(out, enum_def); });
-    });
+  if (!OptSizeDistribution.empty() && !WriteSizeDistribution(result))
+    return 1;
 
-    out.attributeArray("records", [&] {
-      for (const classgen::Record& record : result.records)
-        out.object([&] { DumpRecord(out, record); });
-    });
-  });
+  switch (OptFormat) {
+  case OutputFormat::Json:
+    classgen::WriteJson(llvm::outs(), result);
+    break;
+  case OutputFormat::LayoutAsserts: {
+    classgen::LayoutAssertOptions options;
+    options.records.assign(OptAssertRecords.begin(), OptAssertRecords.end());
+    options.check_offsets = !OptNoOffsetAsserts;
+    std::string error;
+    if (!classgen::WriteLayoutAsserts(llvm::outs(), result, options, error)) {
+      llvm::errs() << error << '\n';
+      return 1;
+    }
+    break;
+  }
+  }
 
   return 0;
 }
@@ -0,0 +1,59 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/raw_ostream.h>
+#include "classgen/Dwarf.h"
+#include "classgen/Json.h"
+#include "classgen/Layout.h"
+#include "classgen/Record.h"
+#include "classgen/analysis/DwarfCrossCheck.h"
+
+namespace cl = llvm::cl;
+
+// Exit codes.
+constexpr int ExitOk = 0;
+constexpr int ExitMismatches = 1;
+constexpr int ExitError = 2;
+
+static cl::OptionCategory MyToolCategory("classgen-dwarf options");
+static cl::list<std::string> OptInputs{cl::Positional,
+                                       cl::desc("<object files, executables or libraries>"),
+                                       cl::OneOrMore, cl::cat(MyToolCategory)};
+static cl::opt<std::string> OptCrossCheck{
+    "cross-check",
+    cl::desc("instead of writing a type dump, compare the layouts in a source-extracted type "
+             "dump against the debug info"),
+    cl::value_desc("type dump"), cl::cat(MyToolCategory)};
+
+int main(int argc, const char** argv) {
+  cl::HideUnrelatedOptions(MyToolCategory);
+  cl::ParseCommandLineOptions(argc, argv,
+                              "classgen DWARF type extractor\n\n"
+                              "With --cross-check, exits with status 1 if layouts differ.\n"
+                              "Exits with status 2 on errors.\n");
+
+  const std::vector<std::string> inputs{OptInputs.begin(), OptInputs.end()};
+  const auto result = classgen::ParseRecordsFromDwarf(inputs);
+  if (!result) {
+    llvm::errs() << result.error << '\n';
+    return ExitError;
+  }
+
+  if (OptCrossCheck.empty()) {
+    classgen::WriteJson(llvm::outs(), result);
+    return ExitOk;
+  }
+
+  const auto source = classgen::ReadJsonFile(OptCrossCheck);
+  if (!source) {
+    llvm::errs() << source.error << '\n';
+    return ExitError;
+  }
+
+  const classgen::TypeIndex source_index{source};
+  const classgen::TypeIndex dwarf_index{result};
+  const auto check_result = classgen::CrossCheckWithDwarf(source_index, dwarf_index);
+  classgen::PrintDwarfCrossCheckResult(llvm::outs(), check_result);
+  return check_result ? ExitOk : ExitMismatches;
+}
@@ -0,0 +1,22 @@
+// Copyright (c) 2021 leoetlino
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/MathExtras.h>
+
+/// Rejects cache line sizes that are zero or not a power of two.
+class CacheLineSizeParser : public llvm::cl::parser<unsigned> {
+public:
+  using llvm::cl::parser<unsigned>::parser;
+
+  bool parse(llvm::cl::Option& option, llvm::StringRef arg_name, llvm::StringRef arg,
+             unsigned& value) {
+    if (llvm::cl::parser<unsigned>::parse(option, arg_name, arg, value))
+      return true;
+    if (!llvm::isPowerOf2_32(value))
+      return option.error("'" + arg + "' is not a power of two");
+    return false;
+  }
+};